@@ -0,0 +1,472 @@
+///////////////////////////////////////////////////////////////////////////////
+// clusteredlights.cpp
+// ============
+// assign many point lights to view frustum clusters for forward shading
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ClusteredLights.h"
+#include "ShaderVariants.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+// declaration of global variables
+namespace
+{
+	// sampler uniforms of the buffers, in BUFFER order
+	const char* const g_SamplerNames[ClusteredLights::TEXTURE_UNIT_COUNT] =
+	{
+		"clusterLightData", "clusterLightGrid", "clusterLightIndices"
+	};
+	// uniforms of the compute shader
+	const char* g_ComputeViewName = "view";
+	const char* g_ComputeInverseProjectionName = "inverseProjection";
+	const char* g_ComputeDepthRangeName = "depthRange";
+	const char* g_ComputeLightCountName = "lightCount";
+	// invocations in one compute shader work group
+	const int g_ComputeGroupSize = 64;
+
+	/***********************************************************
+	 *  CompileComputeProgram()
+	 *
+	 *  Read, compile and link a compute shader, 0 on failure.
+	 ***********************************************************/
+	GLuint CompileComputeProgram(const char* filename)
+	{
+		std::string source;
+		if (ShaderVariants::ReadSource(filename, source) == false)
+		{
+			return(0);
+		}
+		GLuint shaderID = ShaderVariants::CompileShader(GL_COMPUTE_SHADER, source, filename);
+		return(ShaderVariants::LinkProgram(&shaderID, 1, filename));
+	}
+
+	/***********************************************************
+	 *  GetPointAtDepth()
+	 *
+	 *  View space point at a distance in front of the camera
+	 *  on the line through a normalized device x and y.
+	 ***********************************************************/
+	glm::vec3 GetPointAtDepth(const glm::mat4& inverseProjection, float ndcX, float ndcY, float depth)
+	{
+		glm::vec4 nearPoint = inverseProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+		glm::vec4 farPoint = inverseProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+		glm::vec3 a = glm::vec3(nearPoint) / nearPoint.w;
+		glm::vec3 b = glm::vec3(farPoint) / farPoint.w;
+		float t = (-depth - a.z) / (b.z - a.z);
+		return(a + (b - a) * t);
+	}
+}
+
+/***********************************************************
+ *  ClusteredLights()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ClusteredLights::ClusteredLights()
+{
+	m_bLightsDirty = true;
+	m_boundsProjection = glm::mat4(0.0f);
+	m_nearPlane = 0.1f;
+	m_farPlane = 100.0f;
+	m_assignedCount = 0;
+	for (int i = 0; i < BUFFER_COUNT; i++)
+	{
+		m_bufferIDs[i] = 0;
+		m_textureIDs[i] = 0;
+	}
+	m_firstUnit = 0;
+	m_computeProgram = 0;
+	m_assignment = ASSIGNMENT_CPU;
+	m_viewLocation = -1;
+	m_inverseProjectionLocation = -1;
+	m_depthRangeLocation = -1;
+	m_lightCountLocation = -1;
+	m_lightDataLocation = -1;
+	m_tileSize = glm::vec2(1.0f);
+	m_depthParams = glm::vec2(0.0f);
+}
+
+/***********************************************************
+ *  ~ClusteredLights()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ClusteredLights::~ClusteredLights()
+{
+	m_lights.clear();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the texture buffers.
+ *  The compute shader needs image load/store and compute
+ *  shaders, which are core in OpenGL 4.3; on older
+ *  contexts, or if it does not compile, the lists are
+ *  built on the CPU.
+ ***********************************************************/
+bool ClusteredLights::Initialize(const char* computeShaderFilename)
+{
+	Destroy();
+
+	glGenBuffers(BUFFER_COUNT, m_bufferIDs);
+	glGenTextures(BUFFER_COUNT, m_textureIDs);
+	const GLenum formats[BUFFER_COUNT] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	for (int i = 0; i < BUFFER_COUNT; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, m_bufferIDs[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, m_textureIDs[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], m_bufferIDs[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	m_assignment = ASSIGNMENT_CPU;
+	if ((NULL != computeShaderFilename) && GLEW_VERSION_4_3)
+	{
+		m_computeProgram = CompileComputeProgram(computeShaderFilename);
+	}
+	if (m_computeProgram != 0)
+	{
+		// the compute shader writes fixed length lists
+		glBindBuffer(GL_TEXTURE_BUFFER, m_bufferIDs[BUFFER_GRID]);
+		glBufferData(GL_TEXTURE_BUFFER, CLUSTER_COUNT * 2 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_TEXTURE_BUFFER, m_bufferIDs[BUFFER_INDICES]);
+		glBufferData(GL_TEXTURE_BUFFER, CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+		m_assignment = ASSIGNMENT_COMPUTE;
+
+		m_viewLocation = glGetUniformLocation(m_computeProgram, g_ComputeViewName);
+		m_inverseProjectionLocation = glGetUniformLocation(m_computeProgram, g_ComputeInverseProjectionName);
+		m_depthRangeLocation = glGetUniformLocation(m_computeProgram, g_ComputeDepthRangeName);
+		m_lightCountLocation = glGetUniformLocation(m_computeProgram, g_ComputeLightCountName);
+		m_lightDataLocation = glGetUniformLocation(m_computeProgram, g_SamplerNames[BUFFER_LIGHTS]);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	m_grid.assign(CLUSTER_COUNT * 2, 0);
+	m_bLightsDirty = true;
+	std::cout << "Clustered lights: " << GRID_X << "x" << GRID_Y << "x" << GRID_Z << " clusters, assigned on the "
+		<< ((m_assignment == ASSIGNMENT_COMPUTE) ? "GPU" : "CPU") << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  AddLight()
+ *
+ *  This method is used for adding a point light.
+ ***********************************************************/
+int ClusteredLights::AddLight(const glm::vec3& position, const glm::vec3& color, float range)
+{
+	LIGHT_DATA light;
+	light.positionRange = glm::vec4(position, std::max(range, 0.001f));
+	light.color = glm::vec4(color, 0.0f);
+	m_lights.push_back(light);
+	m_bLightsDirty = true;
+	return((int)m_lights.size() - 1);
+}
+
+/***********************************************************
+ *  SetLightPosition()
+ *
+ *  This method is used for moving a light.
+ ***********************************************************/
+void ClusteredLights::SetLightPosition(int index, const glm::vec3& position)
+{
+	if ((index < 0) || (index >= (int)m_lights.size()))
+	{
+		return;
+	}
+	m_lights[index].positionRange = glm::vec4(position, m_lights[index].positionRange.w);
+	m_bLightsDirty = true;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every light.
+ ***********************************************************/
+void ClusteredLights::Clear()
+{
+	m_lights.clear();
+	m_bLightsDirty = true;
+}
+
+/***********************************************************
+ *  SetSamplerUnits()
+ *
+ *  This method is used for pointing the buffer samplers at
+ *  their own texture units.  It is needed even when the
+ *  clusters are not used, because samplers of different
+ *  types cannot share a texture unit.
+ ***********************************************************/
+void ClusteredLights::SetSamplerUnits(GLuint programID, int firstUnit)
+{
+	for (int i = 0; i < TEXTURE_UNIT_COUNT; i++)
+	{
+		GLint location = glGetUniformLocation(programID, g_SamplerNames[i]);
+		if (location >= 0)
+		{
+			glUniform1i(location, firstUnit + i);
+		}
+	}
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for binding the texture buffers to
+ *  their texture units.
+ ***********************************************************/
+void ClusteredLights::Bind(int firstUnit)
+{
+	m_firstUnit = firstUnit;
+	for (int i = 0; i < BUFFER_COUNT; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+		glBindTexture(GL_TEXTURE_BUFFER, m_textureIDs[i]);
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for building the light lists of the
+ *  clusters for the current view.  The lights are uploaded
+ *  when they changed, the lists every frame.
+ ***********************************************************/
+void ClusteredLights::Update(const glm::mat4& view, const glm::mat4& projection, int viewportWidth, int viewportHeight)
+{
+	if (IsInitialized() == false)
+	{
+		return;
+	}
+
+	if (m_bLightsDirty)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, m_bufferIDs[BUFFER_LIGHTS]);
+		glBufferData(GL_TEXTURE_BUFFER, std::max(m_lights.size(), (size_t)1) * sizeof(LIGHT_DATA),
+			(m_lights.size() > 0) ? m_lights.data() : NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		m_bLightsDirty = false;
+	}
+	if (projection != m_boundsProjection)
+	{
+		BuildClusterBounds(projection);
+	}
+
+	if (m_assignment == ASSIGNMENT_COMPUTE)
+	{
+		AssignWithCompute(view, projection);
+	}
+	else
+	{
+		AssignOnCPU(view);
+	}
+
+	// the slice of a depth is log(depth) * scale + bias
+	float depthScale = (float)GRID_Z / std::log(m_farPlane / m_nearPlane);
+	float depthBias = -std::log(m_nearPlane) * depthScale;
+	m_tileSize = glm::vec2((float)std::max(viewportWidth, 1) / GRID_X, (float)std::max(viewportHeight, 1) / GRID_Y);
+	m_depthParams = glm::vec2(depthScale, depthBias);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the buffers and the
+ *  compute shader.
+ ***********************************************************/
+void ClusteredLights::Destroy()
+{
+	if (m_textureIDs[0] != 0)
+	{
+		glDeleteTextures(BUFFER_COUNT, m_textureIDs);
+		glDeleteBuffers(BUFFER_COUNT, m_bufferIDs);
+	}
+	for (int i = 0; i < BUFFER_COUNT; i++)
+	{
+		m_bufferIDs[i] = 0;
+		m_textureIDs[i] = 0;
+	}
+	if (m_computeProgram != 0)
+	{
+		glDeleteProgram(m_computeProgram);
+		m_computeProgram = 0;
+	}
+	m_assignment = ASSIGNMENT_CPU;
+	m_boundsProjection = glm::mat4(0.0f);
+	m_bLightsDirty = true;
+}
+
+/***********************************************************
+ *  BuildClusterBounds()
+ *
+ *  This method is used for computing the view space box
+ *  around each cluster.  It only runs again when the
+ *  projection changes.
+ ***********************************************************/
+void ClusteredLights::BuildClusterBounds(const glm::mat4& projection)
+{
+	m_boundsProjection = projection;
+	GetDepthRange(projection, m_nearPlane, m_farPlane);
+	glm::mat4 inverseProjection = glm::inverse(projection);
+
+	m_clusterBounds.resize(CLUSTER_COUNT);
+	for (int z = 0; z < GRID_Z; z++)
+	{
+		float sliceNear = m_nearPlane * std::pow(m_farPlane / m_nearPlane, (float)z / GRID_Z);
+		float sliceFar = m_nearPlane * std::pow(m_farPlane / m_nearPlane, (float)(z + 1) / GRID_Z);
+		for (int y = 0; y < GRID_Y; y++)
+		{
+			for (int x = 0; x < GRID_X; x++)
+			{
+				CLUSTER_BOUNDS& bounds = m_clusterBounds[x + GRID_X * (y + GRID_Y * z)];
+				bounds.minimum = glm::vec3(FLT_MAX);
+				bounds.maximum = glm::vec3(-FLT_MAX);
+				for (int corner = 0; corner < 8; corner++)
+				{
+					float ndcX = -1.0f + 2.0f * (float)(x + (corner & 1)) / GRID_X;
+					float ndcY = -1.0f + 2.0f * (float)(y + ((corner >> 1) & 1)) / GRID_Y;
+					float depth = (corner & 4) ? sliceFar : sliceNear;
+					glm::vec3 point = GetPointAtDepth(inverseProjection, ndcX, ndcY, depth);
+					bounds.minimum = glm::min(bounds.minimum, point);
+					bounds.maximum = glm::max(bounds.maximum, point);
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  AssignOnCPU()
+ *
+ *  This method is used for building the light lists on
+ *  the CPU.  Each light is only tested against the clusters
+ *  of the depth slices its range covers, and the lists are
+ *  packed with a counting sort so they fill one buffer.
+ ***********************************************************/
+void ClusteredLights::AssignOnCPU(const glm::mat4& view)
+{
+	std::fill(m_grid.begin(), m_grid.end(), 0);
+	m_assignments.clear();
+
+	for (size_t light = 0; light < m_lights.size(); light++)
+	{
+		glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(m_lights[light].positionRange), 1.0f));
+		float range = m_lights[light].positionRange.w;
+		float depth = -center.z;
+		if ((depth + range < m_nearPlane) || (depth - range > m_farPlane))
+		{
+			continue;
+		}
+		int firstSlice = GetSlice(std::max(depth - range, m_nearPlane));
+		int lastSlice = GetSlice(std::min(depth + range, m_farPlane));
+		for (int z = firstSlice; z <= lastSlice; z++)
+		{
+			for (int tile = 0; tile < GRID_X * GRID_Y; tile++)
+			{
+				int cluster = tile + GRID_X * GRID_Y * z;
+				const CLUSTER_BOUNDS& bounds = m_clusterBounds[cluster];
+				// distance from the light to the closest point of the box
+				glm::vec3 closest = glm::clamp(center, bounds.minimum, bounds.maximum);
+				glm::vec3 offset = closest - center;
+				if (glm::dot(offset, offset) <= range * range)
+				{
+					m_grid[cluster * 2 + 1]++;
+					m_assignments.push_back((GLuint)cluster);
+					m_assignments.push_back((GLuint)light);
+				}
+			}
+		}
+	}
+
+	// offsets of the lists, then the indices in cluster order
+	GLuint offset = 0;
+	for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+	{
+		m_grid[cluster * 2] = offset;
+		offset += m_grid[cluster * 2 + 1];
+	}
+	m_assignedCount = (int)offset;
+	m_lightIndices.resize(std::max(m_assignedCount, 1));
+	std::vector<GLuint> fill(CLUSTER_COUNT, 0);
+	for (size_t i = 0; i < m_assignments.size(); i += 2)
+	{
+		GLuint cluster = m_assignments[i];
+		m_lightIndices[m_grid[cluster * 2] + fill[cluster]++] = m_assignments[i + 1];
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, m_bufferIDs[BUFFER_GRID]);
+	glBufferData(GL_TEXTURE_BUFFER, m_grid.size() * sizeof(GLuint), m_grid.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_bufferIDs[BUFFER_INDICES]);
+	glBufferData(GL_TEXTURE_BUFFER, m_lightIndices.size() * sizeof(GLuint), m_lightIndices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  AssignWithCompute()
+ *
+ *  This method is used for building the light lists with
+ *  the compute shader, one invocation per cluster.  The
+ *  lists have a fixed length, lights past it are dropped.
+ ***********************************************************/
+void ClusteredLights::AssignWithCompute(const glm::mat4& view, const glm::mat4& projection)
+{
+	glUseProgram(m_computeProgram);
+
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	glUniformMatrix4fv(m_viewLocation, 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(m_inverseProjectionLocation, 1, GL_FALSE, glm::value_ptr(inverseProjection));
+	glUniform2f(m_depthRangeLocation, m_nearPlane, m_farPlane);
+	glUniform1i(m_lightCountLocation, (GLint)m_lights.size());
+	glUniform1i(m_lightDataLocation, m_firstUnit + BUFFER_LIGHTS);
+
+	glBindImageTexture(0, m_textureIDs[BUFFER_GRID], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32UI);
+	glBindImageTexture(1, m_textureIDs[BUFFER_INDICES], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+	glDispatchCompute((CLUSTER_COUNT + g_ComputeGroupSize - 1) / g_ComputeGroupSize, 1, 1);
+	// the fragment shader reads the lists with texelFetch()
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	m_assignedCount = -1;
+}
+
+/***********************************************************
+ *  GetSlice()
+ *
+ *  Depth slice holding a view space distance.
+ ***********************************************************/
+int ClusteredLights::GetSlice(float depth) const
+{
+	float slice = std::log(depth / m_nearPlane) / std::log(m_farPlane / m_nearPlane) * GRID_Z;
+	return(std::min(std::max((int)slice, 0), GRID_Z - 1));
+}
+
+/***********************************************************
+ *  GetDepthRange()
+ *
+ *  Read the near and far plane distances back from a
+ *  perspective or orthographic projection matrix.
+ ***********************************************************/
+void ClusteredLights::GetDepthRange(const glm::mat4& projection, float& nearPlane, float& farPlane)
+{
+	if (projection[2][3] == 0.0f)
+	{
+		// orthographic
+		nearPlane = (projection[3][2] + 1.0f) / projection[2][2];
+		farPlane = (projection[3][2] - 1.0f) / projection[2][2];
+	}
+	else
+	{
+		nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+		farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	}
+	// the slices are logarithmic, so the near plane must be in front
+	nearPlane = std::max(nearPlane, 0.001f);
+	farPlane = std::max(farPlane, nearPlane * 2.0f);
+}
@@ -0,0 +1,163 @@
+///////////////////////////////////////////////////////////////////////////////
+// clusteredlights.h
+// ============
+// assign many point lights to view frustum clusters for forward shading
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  ClusteredLights
+ *
+ *  This class divides the view frustum into a grid of
+ *  clusters - screen tiles split into depth slices that
+ *  grow with the distance - and lists the point lights
+ *  whose range reaches each cluster.  A fragment finds its
+ *  cluster from its window position and depth, and only
+ *  shades the lights in that cluster's list, so its cost
+ *  follows the lights near it instead of the scene total.
+ *
+ *  The lights, the cluster lists and the light indices are
+ *  stored in texture buffers, which the OpenGL 3.3 fragment
+ *  shader reads with texelFetch().  The lists are built on
+ *  the CPU, or by a compute shader on OpenGL 4.3 and later.
+ ***********************************************************/
+class ClusteredLights
+{
+public:
+	// size of the cluster grid, must match CLUSTER_GRID_X/Y/Z
+	// in the fragment shader and the compute shader
+	static const int GRID_X = 16;
+	static const int GRID_Y = 9;
+	static const int GRID_Z = 24;
+	static const int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+	// longest light list of a cluster built by the compute
+	// shader, must match MAX_LIGHTS_PER_CLUSTER there
+	static const int MAX_LIGHTS_PER_CLUSTER = 128;
+	// texture units used by the light, grid and index buffers
+	static const int TEXTURE_UNIT_COUNT = 3;
+
+	// where the light lists are built
+	enum ASSIGNMENT
+	{
+		ASSIGNMENT_CPU = 0,
+		ASSIGNMENT_COMPUTE
+	};
+
+	// constructor
+	ClusteredLights();
+	// destructor
+	~ClusteredLights();
+
+	// create the buffers, and the compute shader when one is given
+	// and OpenGL 4.3 is available
+	bool Initialize(const char* computeShaderFilename);
+	bool IsInitialized() const { return(m_bufferIDs[BUFFER_LIGHTS] != 0); }
+	ASSIGNMENT GetAssignment() const { return(m_assignment); }
+
+	// add a point light, the light does not reach past its range,
+	// returns the index of the light
+	int AddLight(const glm::vec3& position, const glm::vec3& color, float range);
+	// move a light
+	void SetLightPosition(int index, const glm::vec3& position);
+	int GetLightCount() const { return((int)m_lights.size()); }
+	// remove every light
+	void Clear();
+
+	// point the sampler uniforms of the program in use at the
+	// texture units [firstUnit, firstUnit + TEXTURE_UNIT_COUNT)
+	static void SetSamplerUnits(GLuint programID, int firstUnit);
+	// bind the buffers to the texture units given to SetSamplerUnits()
+	void Bind(int firstUnit);
+	// build the light lists for the view, the compute shader is
+	// left in use when it built them
+	void Update(const glm::mat4& view, const glm::mat4& projection, int viewportWidth, int viewportHeight);
+	// window pixels covered by one cluster, for the last Update()
+	const glm::vec2& GetTileSize() const { return(m_tileSize); }
+	// scale and bias turning log(view depth) into a depth slice,
+	// for the last Update()
+	const glm::vec2& GetDepthParams() const { return(m_depthParams); }
+	// total length of the light lists built by the last Update(),
+	// -1 when the compute shader built them
+	int GetAssignedCount() const { return(m_assignedCount); }
+	// free the buffers and the compute shader
+	void Destroy();
+
+private:
+	// one light as stored in the light buffer, two texels
+	struct LIGHT_DATA
+	{
+		// position in xyz, range in w
+		glm::vec4 positionRange;
+		// color, w unused
+		glm::vec4 color;
+	};
+
+	// view space bounding box of a cluster
+	struct CLUSTER_BOUNDS
+	{
+		glm::vec3 minimum;
+		glm::vec3 maximum;
+	};
+
+	// the texture buffers
+	enum BUFFER
+	{
+		BUFFER_LIGHTS = 0,
+		BUFFER_GRID,
+		BUFFER_INDICES,
+		BUFFER_COUNT
+	};
+
+	// compute the view space boxes of the clusters
+	void BuildClusterBounds(const glm::mat4& projection);
+	// build the light lists on the CPU
+	void AssignOnCPU(const glm::mat4& view);
+	// build the light lists with the compute shader
+	void AssignWithCompute(const glm::mat4& view, const glm::mat4& projection);
+	// depth slice of a view space distance
+	int GetSlice(float depth) const;
+	// near and far plane distances of a projection matrix
+	static void GetDepthRange(const glm::mat4& projection, float& nearPlane, float& farPlane);
+
+	// lights in memory
+	std::vector<LIGHT_DATA> m_lights;
+	// true when m_lights changed since the last upload
+	bool m_bLightsDirty;
+	// cluster boxes and the projection they were built for
+	std::vector<CLUSTER_BOUNDS> m_clusterBounds;
+	glm::mat4 m_boundsProjection;
+	// depth range of the projection
+	float m_nearPlane;
+	float m_farPlane;
+	// offset and length of the light list of each cluster
+	std::vector<GLuint> m_grid;
+	// light indices of every cluster's list
+	std::vector<GLuint> m_lightIndices;
+	// cluster of every light reaching a cluster, and the light
+	std::vector<GLuint> m_assignments;
+	int m_assignedCount;
+	// texture buffers, and the textures reading them
+	GLuint m_bufferIDs[BUFFER_COUNT];
+	GLuint m_textureIDs[BUFFER_COUNT];
+	// texture unit of the light buffer
+	int m_firstUnit;
+	// compute shader building the lists, 0 for none
+	GLuint m_computeProgram;
+	ASSIGNMENT m_assignment;
+	// uniforms of the compute shader, set by AssignWithCompute()
+	GLint m_viewLocation;
+	GLint m_inverseProjectionLocation;
+	GLint m_depthRangeLocation;
+	GLint m_lightCountLocation;
+	GLint m_lightDataLocation;
+	// cluster uniforms of the fragment shader
+	glm::vec2 m_tileSize;
+	glm::vec2 m_depthParams;
+};
@@ -0,0 +1,422 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredrenderer.cpp
+// ============
+// shade the scene from a G-buffer instead of while drawing each mesh
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DeferredRenderer.h"
+#include "ShaderVariants.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <iostream>
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// sampler uniforms of the lighting program, in GBUFFER order
+	// followed by the materials
+	const char* const g_SamplerNames[DeferredRenderer::TEXTURE_UNIT_COUNT] =
+	{
+		"gAlbedo", "gNormal", "gMaterial", "gDepth", "materialData"
+	};
+	// uniforms set by LightingPass()
+	const char* g_InverseViewProjectionName = "inverseViewProjection";
+	const char* g_PointLightIndexName = "pointLightIndex";
+}
+
+/***********************************************************
+ *  DeferredRenderer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DeferredRenderer::DeferredRenderer()
+{
+	m_framebufferID = 0;
+	for (int i = 0; i < GBUFFER_COUNT; i++)
+	{
+		m_textureIDs[i] = 0;
+	}
+	m_width = 0;
+	m_height = 0;
+	m_geometryProgram = 0;
+	m_lightingProgram = 0;
+	m_inverseViewProjectionLocation = -1;
+	m_pointLightIndexLocation = -1;
+	m_vertexArrayID = 0;
+	m_pointLightPasses = 0;
+	m_firstUnit = 0;
+	m_materialBufferID = 0;
+	m_materialTextureID = 0;
+}
+
+/***********************************************************
+ *  ~DeferredRenderer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DeferredRenderer::~DeferredRenderer()
+{
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for compiling the programs of the
+ *  geometry and lighting passes.  The G-buffer textures
+ *  are created by the first geometry pass, once the size
+ *  of the viewport is known.
+ ***********************************************************/
+bool DeferredRenderer::Initialize(const char* geometryVertexFilename, const char* geometryFragmentFilename,
+	const char* lightingVertexFilename, const char* lightingFragmentFilename)
+{
+	Destroy();
+
+	m_geometryProgram = ShaderVariants::CompileProgram(geometryVertexFilename, geometryFragmentFilename);
+	m_lightingProgram = ShaderVariants::CompileProgram(lightingVertexFilename, lightingFragmentFilename);
+	if ((m_geometryProgram == 0) || (m_lightingProgram == 0))
+	{
+		Destroy();
+		return(false);
+	}
+
+	SetTextureUnits(m_firstUnit);
+	m_inverseViewProjectionLocation = glGetUniformLocation(m_lightingProgram, g_InverseViewProjectionName);
+	m_pointLightIndexLocation = glGetUniformLocation(m_lightingProgram, g_PointLightIndexName);
+
+	glGenVertexArrays(1, &m_vertexArrayID);
+	glGenFramebuffers(1, &m_framebufferID);
+	glGenTextures(GBUFFER_COUNT, m_textureIDs);
+	glGenTextures(1, &m_materialTextureID);
+	SetMaterialBuffer(m_materialBufferID);
+	return(true);
+}
+
+/***********************************************************
+ *  SetTextureUnits()
+ *
+ *  This method is used for pointing the G-buffer samplers
+ *  of the lighting program at their texture units.  The
+ *  units are kept out of the texture unit cache, so the
+ *  lighting pass does not disturb the scene textures.
+ ***********************************************************/
+void DeferredRenderer::SetTextureUnits(int firstUnit)
+{
+	m_firstUnit = firstUnit;
+	if (m_lightingProgram == 0)
+	{
+		return;
+	}
+
+	GLint currentProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+	glUseProgram(m_lightingProgram);
+	for (int i = 0; i < TEXTURE_UNIT_COUNT; i++)
+	{
+		GLint location = glGetUniformLocation(m_lightingProgram, g_SamplerNames[i]);
+		if (location >= 0)
+		{
+			glUniform1i(location, firstUnit + i);
+		}
+	}
+	glUseProgram((GLuint)currentProgram);
+}
+
+/***********************************************************
+ *  SetMaterialBuffer()
+ *
+ *  This method is used for reading the materials of the
+ *  lighting pass straight from the material buffer.  The
+ *  G-buffer only stores the index of a material, and each
+ *  material is two RGBA32F texels of the buffer texture,
+ *  laid out as the material block.
+ ***********************************************************/
+void DeferredRenderer::SetMaterialBuffer(GLuint bufferID)
+{
+	m_materialBufferID = bufferID;
+	if ((m_materialTextureID == 0) || (bufferID == 0))
+	{
+		return;
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, m_materialTextureID);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bufferID);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  ResizeTargets()
+ *
+ *  This method is used for allocating the G-buffer textures
+ *  at a new size and attaching them to the framebuffer.
+ *  The normal keeps half floats, and the material index
+ *  is an unsigned integer looked up by the lighting pass.
+ ***********************************************************/
+bool DeferredRenderer::ResizeTargets(int width, int height)
+{
+	const GLint internalFormats[GBUFFER_COUNT] =
+	{
+		GL_RGBA8, GL_RGBA16F, GL_R16UI, GL_DEPTH_COMPONENT24
+	};
+	const GLenum formats[GBUFFER_COUNT] =
+	{
+		GL_RGBA, GL_RGBA, GL_RED_INTEGER, GL_DEPTH_COMPONENT
+	};
+	const GLenum types[GBUFFER_COUNT] =
+	{
+		GL_UNSIGNED_BYTE, GL_FLOAT, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT
+	};
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	for (int i = 0; i < GBUFFER_COUNT; i++)
+	{
+		bool bDepth = (i == GBUFFER_DEPTH);
+		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], width, height, 0, formats[i], types[i], NULL);
+		// the lighting pass reads single texels
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, bDepth ? GL_DEPTH_ATTACHMENT : GL_COLOR_ATTACHMENT0 + i,
+			GL_TEXTURE_2D, m_textureIDs[i], 0);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLenum drawBuffers[COLOR_TARGET_COUNT];
+	for (int i = 0; i < COLOR_TARGET_COUNT; i++)
+	{
+		drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+	}
+	glDrawBuffers(COLOR_TARGET_COUNT, drawBuffers);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "G-buffer is incomplete:" << status << std::endl;
+		m_width = 0;
+		m_height = 0;
+		return(false);
+	}
+	m_width = width;
+	m_height = height;
+	return(true);
+}
+
+/***********************************************************
+ *  BeginGeometryPass()
+ *
+ *  This method is used for getting the G-buffer ready for
+ *  the geometry pass.  It is resized when the viewport
+ *  changed.  Blending is turned off, the alpha of the draw
+ *  state must not mix normals or material indices.
+ ***********************************************************/
+bool DeferredRenderer::BeginGeometryPass()
+{
+	GLint viewport[4] = { 0, 0, 1, 1 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	if (((viewport[2] != m_width) || (viewport[3] != m_height)) &&
+		(ResizeTargets(viewport[2], viewport[3]) == false))
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return(false);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	const GLfloat clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLuint clearIndex[4] = { 0, 0, 0, 0 };
+	const GLfloat clearDepth = 1.0f;
+	for (int i = 0; i < COLOR_TARGET_COUNT; i++)
+	{
+		if (i == GBUFFER_MATERIAL)
+		{
+			glClearBufferuiv(GL_COLOR, i, clearIndex);
+		}
+		else
+		{
+			glClearBufferfv(GL_COLOR, i, clearColor);
+		}
+	}
+	glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+	glDisable(GL_BLEND);
+	return(true);
+}
+
+/***********************************************************
+ *  LightingPass()
+ *
+ *  This method is used for shading the G-buffer into the
+ *  window.  The first fullscreen triangle adds the ambient,
+ *  directional, spot and clustered lights and writes the
+ *  G-buffer depth into the window, so the transparent draws
+ *  after it are hidden behind the opaque ones.  Each point
+ *  light then adds its own pass, limited by the scissor
+ *  test to the rectangle its range covers.  Pixels nothing
+ *  was drawn into keep the window's clear color.
+ ***********************************************************/
+void DeferredRenderer::LightingPass(const LightBuffer::LIGHT_BLOCK& lights, const glm::mat4& view, const glm::mat4& projection)
+{
+	m_pointLightPasses = 0;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// no sampler object is bound to the reserved units, so the
+	// textures keep their nearest filtering
+	for (int i = 0; i < GBUFFER_COUNT; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + m_firstUnit + i);
+		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i]);
+	}
+	glActiveTexture(GL_TEXTURE0 + m_firstUnit + TEXTURE_UNIT_MATERIALS);
+	glBindTexture(GL_TEXTURE_BUFFER, m_materialTextureID);
+
+	glm::mat4 viewProjection = projection * view;
+	glUseProgram(m_lightingProgram);
+	glUniformMatrix4fv(m_inverseViewProjectionLocation, 1, GL_FALSE, glm::value_ptr(glm::inverse(viewProjection)));
+	glUniform1i(m_pointLightIndexLocation, -1);
+	glBindVertexArray(m_vertexArrayID);
+
+	// the shader writes the G-buffer depth, which every pixel
+	// of the fullscreen triangle must pass to be stored
+	GLint depthFunc = GL_LESS;
+	glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+	glDepthFunc(GL_ALWAYS);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// the point lights add to the image and leave the depth alone
+	glDepthMask(GL_FALSE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	glEnable(GL_SCISSOR_TEST);
+	for (int i = 0; i < LightBuffer::MAX_POINT_LIGHTS; i++)
+	{
+		const LightBuffer::POINT_LIGHT_DATA& light = lights.pointLights[i];
+		GLint rect[4];
+		if ((light.bActive == 0) || (GetScissorRect(light.position, light.range, viewProjection, rect) == false))
+		{
+			continue;
+		}
+		glScissor(rect[0], rect[1], rect[2], rect[3]);
+		glUniform1i(m_pointLightIndexLocation, i);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		m_pointLightPasses++;
+	}
+
+	// back to the state the forward draws expect, blending as
+	// set up by the ViewManager
+	glDisable(GL_SCISSOR_TEST);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_TRUE);
+	glDepthFunc((GLenum)depthFunc);
+	glBindVertexArray(0);
+	// the G-buffer is drawn into again by the next geometry pass
+	for (int i = 0; i < GBUFFER_COUNT; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + m_firstUnit + i);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	glActiveTexture(GL_TEXTURE0 + m_firstUnit + TEXTURE_UNIT_MATERIALS);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  GetScissorRect()
+ *
+ *  This method is used for finding the window rectangle
+ *  covered by the box around a light's range.  When the box
+ *  reaches behind the camera its projection is unbounded,
+ *  so the whole window is used.
+ ***********************************************************/
+bool DeferredRenderer::GetScissorRect(const glm::vec3& center, float range, const glm::mat4& viewProjection, GLint rect[4]) const
+{
+	float minimumX = 1.0f;
+	float minimumY = 1.0f;
+	float maximumX = -1.0f;
+	float maximumY = -1.0f;
+	int behindCount = 0;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 offset((corner & 1) ? range : -range, (corner & 2) ? range : -range, (corner & 4) ? range : -range);
+		glm::vec4 clip = viewProjection * glm::vec4(center + offset, 1.0f);
+		if (clip.w <= 0.0001f)
+		{
+			behindCount++;
+			continue;
+		}
+		minimumX = std::min(minimumX, clip.x / clip.w);
+		minimumY = std::min(minimumY, clip.y / clip.w);
+		maximumX = std::max(maximumX, clip.x / clip.w);
+		maximumY = std::max(maximumY, clip.y / clip.w);
+	}
+	if (behindCount == 8)
+	{
+		return(false);
+	}
+	if (behindCount > 0)
+	{
+		minimumX = -1.0f;
+		minimumY = -1.0f;
+		maximumX = 1.0f;
+		maximumY = 1.0f;
+	}
+
+	minimumX = std::max(minimumX, -1.0f);
+	minimumY = std::max(minimumY, -1.0f);
+	maximumX = std::min(maximumX, 1.0f);
+	maximumY = std::min(maximumY, 1.0f);
+	if ((minimumX >= maximumX) || (minimumY >= maximumY))
+	{
+		return(false);
+	}
+
+	rect[0] = (GLint)((minimumX * 0.5f + 0.5f) * m_width);
+	rect[1] = (GLint)((minimumY * 0.5f + 0.5f) * m_height);
+	rect[2] = (GLint)((maximumX * 0.5f + 0.5f) * m_width) + 1 - rect[0];
+	rect[3] = (GLint)((maximumY * 0.5f + 0.5f) * m_height) + 1 - rect[1];
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the G-buffer and the
+ *  programs.
+ ***********************************************************/
+void DeferredRenderer::Destroy()
+{
+	if (m_framebufferID != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebufferID);
+		m_framebufferID = 0;
+	}
+	for (int i = 0; i < GBUFFER_COUNT; i++)
+	{
+		if (m_textureIDs[i] != 0)
+		{
+			glDeleteTextures(1, &m_textureIDs[i]);
+			m_textureIDs[i] = 0;
+		}
+	}
+	if (m_materialTextureID != 0)
+	{
+		glDeleteTextures(1, &m_materialTextureID);
+		m_materialTextureID = 0;
+	}
+	if (m_vertexArrayID != 0)
+	{
+		glDeleteVertexArrays(1, &m_vertexArrayID);
+		m_vertexArrayID = 0;
+	}
+	if (m_geometryProgram != 0)
+	{
+		glDeleteProgram(m_geometryProgram);
+		m_geometryProgram = 0;
+	}
+	if (m_lightingProgram != 0)
+	{
+		glDeleteProgram(m_lightingProgram);
+		m_lightingProgram = 0;
+	}
+	m_width = 0;
+	m_height = 0;
+}
@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredrenderer.h
+// ============
+// shade the scene from a G-buffer instead of while drawing each mesh
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "LightBuffer.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  DeferredRenderer
+ *
+ *  This class holds the G-buffer of the deferred shading
+ *  path - the albedo, normal, material index and depth of
+ *  the closest surface at each pixel - and the programs
+ *  that fill and shade it.  The geometry pass draws the
+ *  meshes into the G-buffer without any lighting.  The
+ *  lighting pass then draws fullscreen triangles into the
+ *  window: one for the ambient, directional, spot and
+ *  clustered lights, and one added on top for each point
+ *  light, clipped to the screen rectangle its range covers,
+ *  so every pixel is lit once per light that reaches it.
+ ***********************************************************/
+class DeferredRenderer
+{
+public:
+	// textures of the G-buffer, also the texture units they are
+	// bound to for the lighting pass
+	enum GBUFFER
+	{
+		// surface color, alpha unused
+		GBUFFER_ALBEDO = 0,
+		// normal in xyz, w unused
+		GBUFFER_NORMAL,
+		// index of the material in the MaterialBuffer, 16 bits
+		GBUFFER_MATERIAL,
+		GBUFFER_DEPTH,
+		GBUFFER_COUNT
+	};
+	// color attachments written by the geometry pass
+	static const int COLOR_TARGET_COUNT = GBUFFER_DEPTH;
+	// texture unit of the materials, after the G-buffer units
+	static const int TEXTURE_UNIT_MATERIALS = GBUFFER_COUNT;
+	// texture units the lighting pass reads the G-buffer and the
+	// materials from
+	static const int TEXTURE_UNIT_COUNT = GBUFFER_COUNT + 1;
+
+	// constructor
+	DeferredRenderer();
+	// destructor
+	~DeferredRenderer();
+
+	// compile the geometry and lighting programs
+	bool Initialize(const char* geometryVertexFilename, const char* geometryFragmentFilename,
+		const char* lightingVertexFilename, const char* lightingFragmentFilename);
+	bool IsInitialized() const { return(m_lightingProgram != 0); }
+	// program drawing the meshes into the G-buffer
+	GLuint GetGeometryProgram() const { return(m_geometryProgram); }
+	// program shading the G-buffer
+	GLuint GetLightingProgram() const { return(m_lightingProgram); }
+	// read the G-buffer from the texture units
+	// [firstUnit, firstUnit + TEXTURE_UNIT_COUNT)
+	void SetTextureUnits(int firstUnit);
+	// look up the materials of the G-buffer in the buffer of a
+	// MaterialBuffer, after every upload of the materials
+	void SetMaterialBuffer(GLuint bufferID);
+
+	// bind and clear the G-buffer, sized to the viewport, and
+	// turn off blending for the draws into it, false when the
+	// G-buffer cannot be created at that size
+	bool BeginGeometryPass();
+	// shade the G-buffer into the window and copy its depth there,
+	// after a successful BeginGeometryPass(), the view uniforms of
+	// the lighting program must be set
+	void LightingPass(const LightBuffer::LIGHT_BLOCK& lights, const glm::mat4& view, const glm::mat4& projection);
+	// point light passes drawn by the last LightingPass()
+	int GetPointLightPassCount() const { return(m_pointLightPasses); }
+	// free the G-buffer and the programs
+	void Destroy();
+
+private:
+	// create or resize the G-buffer textures
+	bool ResizeTargets(int width, int height);
+	// window rectangle a light's range covers, false when the
+	// range is entirely off the screen
+	bool GetScissorRect(const glm::vec3& center, float range, const glm::mat4& viewProjection, GLint rect[4]) const;
+
+	// framebuffer and textures of the G-buffer
+	GLuint m_framebufferID;
+	GLuint m_textureIDs[GBUFFER_COUNT];
+	// size of the G-buffer textures
+	int m_width;
+	int m_height;
+	// programs of the two passes
+	GLuint m_geometryProgram;
+	GLuint m_lightingProgram;
+	// uniforms of the lighting program set by LightingPass()
+	GLint m_inverseViewProjectionLocation;
+	GLint m_pointLightIndexLocation;
+	// empty vertex array for the fullscreen triangle, which
+	// the vertex shader builds from the vertex index
+	GLuint m_vertexArrayID;
+	int m_pointLightPasses;
+	// texture unit of the first G-buffer texture
+	int m_firstUnit;
+	// buffer texture over the material buffer
+	GLuint m_materialBufferID;
+	GLuint m_materialTextureID;
+};
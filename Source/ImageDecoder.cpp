@@ -0,0 +1,226 @@
+///////////////////////////////////////////////////////////////////////////////
+// imagedecoder.cpp
+// ============
+// decode compressed image files into pixels with a selectable backend
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImageDecoder.h"
+
+#include "stb_image.h"
+
+#ifdef HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+#include <iostream>
+#include <atomic>
+#include <cstdlib>
+
+// declaration of global variables
+namespace
+{
+	/***********************************************************
+	 *  StbImageDecoder
+	 *
+	 *  Decodes every format supported by stb_image.
+	 ***********************************************************/
+	class StbImageDecoder : public ImageDecoder
+	{
+	public:
+		StbImageDecoder()
+		{
+			// every image is flipped vertically for OpenGL
+			stbi_set_flip_vertically_on_load(true);
+		}
+
+		const char* GetName() const { return("stb"); }
+
+		bool CanDecode(const unsigned char* bytes, size_t size) const
+		{
+			int width = 0;
+			int height = 0;
+			int colorChannels = 0;
+			return(stbi_info_from_memory(bytes, (int)size, &width, &height, &colorChannels) != 0);
+		}
+
+		unsigned char* Decode(const unsigned char* bytes, size_t size, int& width, int& height, int& colorChannels) const
+		{
+			return(stbi_load_from_memory(bytes, (int)size, &width, &height, &colorChannels, 0));
+		}
+	};
+
+#ifdef HAVE_TURBOJPEG
+	/***********************************************************
+	 *  TurboJpegDecoder
+	 *
+	 *  Decodes JPEG files with libjpeg-turbo.  Each thread
+	 *  keeps its own decompressor, as a handle must not be
+	 *  shared between threads.
+	 ***********************************************************/
+	class TurboJpegDecoder : public ImageDecoder
+	{
+	public:
+		const char* GetName() const { return("turbojpeg"); }
+
+		bool CanDecode(const unsigned char* bytes, size_t size) const
+		{
+			// JPEG files start with the SOI marker
+			return((size > 3) && (bytes[0] == 0xFF) && (bytes[1] == 0xD8) && (bytes[2] == 0xFF));
+		}
+
+		unsigned char* Decode(const unsigned char* bytes, size_t size, int& width, int& height, int& colorChannels) const
+		{
+			struct THREAD_HANDLE
+			{
+				tjhandle handle;
+				THREAD_HANDLE() { handle = tjInitDecompress(); }
+				~THREAD_HANDLE() { if (NULL != handle) tjDestroy(handle); }
+			};
+			thread_local THREAD_HANDLE decompressor;
+			if (NULL == decompressor.handle)
+			{
+				return(NULL);
+			}
+
+			int subsampling = 0;
+			int colorspace = 0;
+			if (tjDecompressHeader3(decompressor.handle, bytes, (unsigned long)size, &width, &height, &subsampling, &colorspace) != 0)
+			{
+				return(NULL);
+			}
+
+			// same channel layout as stb_image returns for the file
+			int pixelFormat = (colorspace == TJCS_GRAY) ? TJPF_GRAY : TJPF_RGB;
+			colorChannels = tjPixelSize[pixelFormat];
+			unsigned char* pixels = (unsigned char*)malloc((size_t)width * height * colorChannels);
+			if (NULL == pixels)
+			{
+				return(NULL);
+			}
+			if (tjDecompress2(decompressor.handle, bytes, (unsigned long)size, pixels, width, 0, height, pixelFormat, TJFLAG_BOTTOMUP) != 0)
+			{
+				free(pixels);
+				return(NULL);
+			}
+			return(pixels);
+		}
+	};
+#endif
+
+	StbImageDecoder g_StbDecoder;
+#ifdef HAVE_TURBOJPEG
+	TurboJpegDecoder g_TurboJpegDecoder;
+#endif
+
+	// backend tried first for each image file
+	std::atomic<int> g_PreferredBackend(ImageDecoder::DECODER_BACKEND_STB);
+}
+
+/***********************************************************
+ *  GetBackend()
+ *
+ *  This method is used for getting a decoder backend.
+ *  Backends that were not built in return NULL.
+ ***********************************************************/
+const ImageDecoder* ImageDecoder::GetBackend(DECODER_BACKEND backend)
+{
+	switch (backend)
+	{
+	case DECODER_BACKEND_STB:
+		return(&g_StbDecoder);
+#ifdef HAVE_TURBOJPEG
+	case DECODER_BACKEND_TURBOJPEG:
+		return(&g_TurboJpegDecoder);
+#endif
+	default:
+		return(NULL);
+	}
+}
+
+/***********************************************************
+ *  SetPreferredBackend()
+ *
+ *  This method is used for choosing the backend that is
+ *  tried first for each image file.
+ ***********************************************************/
+bool ImageDecoder::SetPreferredBackend(DECODER_BACKEND backend)
+{
+	if (NULL == GetBackend(backend))
+	{
+		return(false);
+	}
+	g_PreferredBackend = backend;
+	return(true);
+}
+
+/***********************************************************
+ *  SetPreferredBackend()
+ *
+ *  This method is used for choosing the preferred backend
+ *  by the name it reports.
+ ***********************************************************/
+bool ImageDecoder::SetPreferredBackend(const std::string& name)
+{
+	for (int i = 0; i < DECODER_BACKEND_COUNT; i++)
+	{
+		const ImageDecoder* pDecoder = GetBackend((DECODER_BACKEND)i);
+		if ((NULL != pDecoder) && (name == pDecoder->GetName()))
+		{
+			SetPreferredBackend((DECODER_BACKEND)i);
+			std::cout << "Image decoder:" << name << std::endl;
+			return(true);
+		}
+	}
+
+	std::cout << "Image decoder not available:" << name << ", using " << GetBackend((DECODER_BACKEND)g_PreferredBackend.load())->GetName() << std::endl;
+	return(false);
+}
+
+/***********************************************************
+ *  FindDecoder()
+ *
+ *  This method is used for getting the backend that decodes
+ *  the file contents - the preferred backend when it can,
+ *  otherwise stb_image.
+ ***********************************************************/
+const ImageDecoder* ImageDecoder::FindDecoder(const unsigned char* bytes, size_t size)
+{
+	const ImageDecoder* pDecoder = GetBackend((DECODER_BACKEND)g_PreferredBackend.load());
+	if ((NULL != pDecoder) && pDecoder->CanDecode(bytes, size))
+	{
+		return(pDecoder);
+	}
+	return(&g_StbDecoder);
+}
+
+/***********************************************************
+ *  DecodeImage()
+ *
+ *  This method is used for decoding the file contents with
+ *  the backend chosen for them.  When another backend fails
+ *  on a file, such as a JPEG flavor it does not support,
+ *  stb_image gets to try it too.
+ ***********************************************************/
+unsigned char* ImageDecoder::DecodeImage(const unsigned char* bytes, size_t size, int& width, int& height, int& colorChannels)
+{
+	const ImageDecoder* pDecoder = FindDecoder(bytes, size);
+	unsigned char* pixels = pDecoder->Decode(bytes, size, width, height, colorChannels);
+	if ((NULL == pixels) && (pDecoder != &g_StbDecoder))
+	{
+		pixels = g_StbDecoder.Decode(bytes, size, width, height, colorChannels);
+	}
+	return(pixels);
+}
+
+/***********************************************************
+ *  FreeImage()
+ *
+ *  This method is used for releasing decoded pixels.  The
+ *  stb_image buffers come from malloc(), so the other
+ *  backends allocate the same way.
+ ***********************************************************/
+void ImageDecoder::FreeImage(unsigned char* pixels)
+{
+	stbi_image_free(pixels);
+}
@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////////////
+// imagedecoder.h
+// ============
+// decode compressed image files into pixels with a selectable backend
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+/***********************************************************
+ *  ImageDecoder
+ *
+ *  This class is the interface of the image decoder
+ *  backends.  stb_image is always built in and decodes
+ *  every supported format.  libjpeg-turbo is built in when
+ *  HAVE_TURBOJPEG is defined and decodes JPEG files with
+ *  SIMD; files it cannot decode fall back to stb_image.
+ *  Every backend returns the image flipped vertically for
+ *  OpenGL, in a buffer released with FreeImage().
+ ***********************************************************/
+class ImageDecoder
+{
+public:
+	enum DECODER_BACKEND
+	{
+		DECODER_BACKEND_STB = 0,
+		DECODER_BACKEND_TURBOJPEG,
+		DECODER_BACKEND_COUNT
+	};
+
+	// destructor
+	virtual ~ImageDecoder() {}
+
+	// name used on the command line and in reports
+	virtual const char* GetName() const = 0;
+	// true when the backend can decode the file contents
+	virtual bool CanDecode(const unsigned char* bytes, size_t size) const = 0;
+	// decode the file contents, returns NULL on failure,
+	// can be called from several threads at once
+	virtual unsigned char* Decode(const unsigned char* bytes, size_t size, int& width, int& height, int& colorChannels) const = 0;
+
+	// get a backend, NULL when it is not built in
+	static const ImageDecoder* GetBackend(DECODER_BACKEND backend);
+	// choose the backend tried first, returns false when it is not built in
+	static bool SetPreferredBackend(DECODER_BACKEND backend);
+	// choose the preferred backend by its name
+	static bool SetPreferredBackend(const std::string& name);
+	// get the backend used for the file contents
+	static const ImageDecoder* FindDecoder(const unsigned char* bytes, size_t size);
+	// decode the file contents with the backend chosen by FindDecoder()
+	static unsigned char* DecodeImage(const unsigned char* bytes, size_t size, int& width, int& height, int& colorChannels);
+	// release the pixels returned by any backend
+	static void FreeImage(unsigned char* pixels);
+};
@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightbuffer.cpp
+// ============
+// hold the scene lights in a uniform buffer shared by every shader program
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightBuffer.h"
+
+#include <iostream>
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// name of the uniform block in the fragment shader
+	const char* g_LightBlockName = "LightBlock";
+}
+
+/***********************************************************
+ *  LightBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightBuffer::LightBuffer()
+{
+	// every light starts turned off
+	m_data = LIGHT_BLOCK();
+	m_bDirty = true;
+	m_bufferID = 0;
+}
+
+/***********************************************************
+ *  ~LightBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightBuffer::~LightBuffer()
+{
+}
+
+/***********************************************************
+ *  SetDirectionalLight()
+ *
+ *  This method is used for setting and turning on the
+ *  directional light.
+ ***********************************************************/
+void LightBuffer::SetDirectionalLight(const glm::vec3& direction, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular)
+{
+	m_data.directionalLight.direction = direction;
+	m_data.directionalLight.ambient = ambient;
+	m_data.directionalLight.diffuse = diffuse;
+	m_data.directionalLight.specular = specular;
+	m_data.directionalLight.bActive = 1;
+	m_bDirty = true;
+}
+
+/***********************************************************
+ *  SetPointLight()
+ *
+ *  This method is used for setting and turning on one of
+ *  the point lights.
+ ***********************************************************/
+void LightBuffer::SetPointLight(int index, const glm::vec3& position, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular,
+	float intensity, float range)
+{
+	if ((index < 0) || (index >= MAX_POINT_LIGHTS))
+	{
+		std::cout << "Point light index out of range:" << index << std::endl;
+		return;
+	}
+	m_data.pointLights[index].position = position;
+	m_data.pointLights[index].ambient = ambient;
+	m_data.pointLights[index].diffuse = diffuse;
+	m_data.pointLights[index].specular = specular;
+	m_data.pointLights[index].intensity = intensity;
+	m_data.pointLights[index].range = std::max(range, 0.001f);
+	m_data.pointLights[index].bActive = 1;
+	m_bDirty = true;
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for creating the uniform buffer and
+ *  binding it to the light block.  Programs created later,
+ *  such as the shader variants, only need their light block
+ *  connected to BLOCK_BINDING.
+ ***********************************************************/
+bool LightBuffer::Upload(GLuint programID)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(programID, g_LightBlockName);
+	if (blockIndex == GL_INVALID_INDEX)
+	{
+		std::cout << "Shader has no uniform block:" << g_LightBlockName << std::endl;
+		return(false);
+	}
+	glUniformBlockBinding(programID, blockIndex, BLOCK_BINDING);
+
+	GLint blockSize = 0;
+	glGetActiveUniformBlockiv(programID, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+	if (blockSize != (GLint)sizeof(LIGHT_BLOCK))
+	{
+		std::cout << "Light block is " << blockSize << " bytes, expected " << sizeof(LIGHT_BLOCK) << std::endl;
+		return(false);
+	}
+
+	if (m_bufferID == 0)
+	{
+		glGenBuffers(1, &m_bufferID);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, m_bufferID);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LIGHT_BLOCK), &m_data, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, BLOCK_BINDING, m_bufferID);
+	m_bDirty = false;
+	return(true);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for uploading the lights when they
+ *  changed.  The whole block is rewritten, it is smaller
+ *  than tracking the changed lights would be worth.
+ ***********************************************************/
+bool LightBuffer::Update()
+{
+	if ((m_bDirty == false) || (m_bufferID == 0))
+	{
+		return(false);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, m_bufferID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LIGHT_BLOCK), &m_data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	m_bDirty = false;
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the uniform buffer.
+ ***********************************************************/
+void LightBuffer::Destroy()
+{
+	if (m_bufferID != 0)
+	{
+		glDeleteBuffers(1, &m_bufferID);
+		m_bufferID = 0;
+	}
+	m_bDirty = true;
+}
@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightbuffer.h
+// ============
+// hold the scene lights in a uniform buffer shared by every shader program
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+/***********************************************************
+ *  LightBuffer
+ *
+ *  This class keeps a copy of the light block of the
+ *  fragment shader in memory.  The setters only change the
+ *  copy and mark it dirty, and Update() uploads it with a
+ *  single buffer write when anything changed, so setting
+ *  the lights again costs one upload.  The spot light is
+ *  left off.  The buffer stays bound to its binding
+ *  point, which every shader program and shader variant
+ *  reads the lights from.
+ ***********************************************************/
+class LightBuffer
+{
+public:
+	// point lights in the light block, must match
+	// TOTAL_POINT_LIGHTS in the fragment shader
+	static const int MAX_POINT_LIGHTS = 5;
+	// uniform buffer binding point of the light block
+	static const GLuint BLOCK_BINDING = 1;
+
+	// lights as laid out by std140 in the light block - a vec3
+	// is aligned to 16 bytes and a following scalar fills the
+	// last 4 bytes, a bool is stored as a 4 byte integer
+	struct DIRECTIONAL_LIGHT_DATA
+	{
+		glm::vec3 direction;
+		float padding0;
+		glm::vec3 ambient;
+		float padding1;
+		glm::vec3 diffuse;
+		float padding2;
+		glm::vec3 specular;
+		GLint bActive;
+	};
+
+	struct POINT_LIGHT_DATA
+	{
+		glm::vec3 position;
+		// distance where the light fades out completely
+		float range;
+		glm::vec3 ambient;
+		// scale of the inverse square falloff, the light has its
+		// colors at a distance of sqrt(intensity)
+		float intensity;
+		glm::vec3 diffuse;
+		float padding0;
+		glm::vec3 specular;
+		GLint bActive;
+	};
+
+	struct SPOT_LIGHT_DATA
+	{
+		glm::vec3 position;
+		float padding0;
+		glm::vec3 direction;
+		float cutOff;
+		float outerCutOff;
+		float constant;
+		float linear;
+		float quadratic;
+		glm::vec3 ambient;
+		float padding1;
+		glm::vec3 diffuse;
+		float padding2;
+		glm::vec3 specular;
+		GLint bActive;
+	};
+
+	struct LIGHT_BLOCK
+	{
+		DIRECTIONAL_LIGHT_DATA directionalLight;
+		POINT_LIGHT_DATA pointLights[MAX_POINT_LIGHTS];
+		SPOT_LIGHT_DATA spotLight;
+	};
+
+	// constructor
+	LightBuffer();
+	// destructor
+	~LightBuffer();
+
+	// turn on the directional light
+	void SetDirectionalLight(const glm::vec3& direction, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular);
+	// turn on a point light, its colors fall off with the inverse
+	// square of the distance scaled by intensity, and reach zero at
+	// the range
+	void SetPointLight(int index, const glm::vec3& position, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular,
+		float intensity, float range);
+	// the lights as uploaded by the next Update()
+	const LIGHT_BLOCK& GetData() const { return(m_data); }
+
+	// create the buffer and connect the light block of the
+	// shader program to it
+	bool Upload(GLuint programID);
+	// upload the lights if they changed since the last upload,
+	// returns true when they were uploaded
+	bool Update();
+	// free the buffer
+	void Destroy();
+
+private:
+	// lights in memory
+	LIGHT_BLOCK m_data;
+	// true when m_data changed since the last upload
+	bool m_bDirty;
+	// uniform buffer holding the light block
+	GLuint m_bufferID;
+};
+
+// the offsets must match the std140 layout of the light block
+static_assert(sizeof(LightBuffer::DIRECTIONAL_LIGHT_DATA) == 64, "directional light must be 64 bytes");
+static_assert(offsetof(LightBuffer::DIRECTIONAL_LIGHT_DATA, ambient) == 16, "directional light ambient offset");
+static_assert(offsetof(LightBuffer::DIRECTIONAL_LIGHT_DATA, specular) == 48, "directional light specular offset");
+static_assert(offsetof(LightBuffer::DIRECTIONAL_LIGHT_DATA, bActive) == 60, "directional light bActive offset");
+static_assert(sizeof(LightBuffer::POINT_LIGHT_DATA) == 64, "point light must be 64 bytes");
+static_assert(offsetof(LightBuffer::POINT_LIGHT_DATA, range) == 12, "point light range offset");
+static_assert(offsetof(LightBuffer::POINT_LIGHT_DATA, ambient) == 16, "point light ambient offset");
+static_assert(offsetof(LightBuffer::POINT_LIGHT_DATA, intensity) == 28, "point light intensity offset");
+static_assert(offsetof(LightBuffer::POINT_LIGHT_DATA, specular) == 48, "point light specular offset");
+static_assert(offsetof(LightBuffer::POINT_LIGHT_DATA, bActive) == 60, "point light bActive offset");
+static_assert(sizeof(LightBuffer::SPOT_LIGHT_DATA) == 96, "spot light must be 96 bytes");
+static_assert(offsetof(LightBuffer::SPOT_LIGHT_DATA, cutOff) == 28, "spot light cutOff offset");
+static_assert(offsetof(LightBuffer::SPOT_LIGHT_DATA, quadratic) == 44, "spot light quadratic offset");
+static_assert(offsetof(LightBuffer::SPOT_LIGHT_DATA, ambient) == 48, "spot light ambient offset");
+static_assert(offsetof(LightBuffer::SPOT_LIGHT_DATA, bActive) == 92, "spot light bActive offset");
+static_assert(offsetof(LightBuffer::LIGHT_BLOCK, pointLights) == 64, "point lights offset");
+static_assert(offsetof(LightBuffer::LIGHT_BLOCK, spotLight) == 64 + LightBuffer::MAX_POINT_LIGHTS * 64, "spot light offset");
+static_assert(sizeof(LightBuffer::LIGHT_BLOCK) == 64 + LightBuffer::MAX_POINT_LIGHTS * 64 + 96, "light block size");
@@ -9,6 +9,7 @@
 
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <string>           // command line arguments
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -22,6 +23,11 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "ShaderVariants.h"
+#include "TextureContainer.h"
+#include "TextureBenchmark.h"
+#include "ImageDecoder.h"
+#include "StartupTrace.h"
 
 // Namespace for declaring global variables
 namespace
@@ -54,12 +60,36 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// bake the texture images into containers and exit, used as a
+	// build step: --bake-textures [source directory] [output directory]
+	if ((argc > 1) && (std::string(argv[1]) == "--bake-textures"))
+	{
+		const char* sourceDirectory = (argc > 2) ? argv[2] : "textures";
+		const char* containerDirectory = (argc > 3) ? argv[3] : "textures/baked";
+		int failures = TextureContainer::BakeDirectory(sourceDirectory, containerDirectory);
+		return((failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// decode the images with every decoder backend and exit:
+	// --benchmark-decoders [image directory]
+	if ((argc > 1) && (std::string(argv[1]) == "--benchmark-decoders"))
+	{
+		return(TextureBenchmark::RunDecoderBenchmark((argc > 2) ? argv[2] : "textures"));
+	}
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
 		return(EXIT_FAILURE);
 	}
 
+	// time the driver and CPU mipmap paths and exit:
+	// --benchmark-mipmaps [image directory]
+	if ((argc > 1) && (std::string(argv[1]) == "--benchmark-mipmaps"))
+	{
+		return(TextureBenchmark::RunMipmapBenchmark((argc > 2) ? argv[2] : "textures"));
+	}
+
 	// try to create a new shader manager object
 	g_ShaderManager = new ShaderManager();
 	// try to create a new view manager object
@@ -67,7 +97,10 @@ int main(int argc, char* argv[])
 		g_ShaderManager);
 
 	// try to create the main display window
-	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	{
+		StartupTrace::Scope trace("CreateDisplayWindow", "main");
+		g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	}
 
 	// if GLEW fails initialization, then terminate the application
 	if (InitializeGLEW() == false)
@@ -76,19 +109,159 @@ int main(int argc, char* argv[])
 	}
 
 	// load the shader code from the external GLSL files
-	g_ShaderManager->LoadShaders(
-		"shaders/vertexShader.glsl",
-		"shaders/fragmentShader.glsl");
-	g_ShaderManager->use();
+	{
+		StartupTrace::Scope trace("LoadShaders", "main");
+		g_ShaderManager->LoadShaders(
+			"shaders/vertexShader.glsl",
+			"shaders/fragmentShader.glsl");
+		g_ShaderManager->use();
+	}
+#ifndef NDEBUG
+	// report when the copy of lighting.glsl in the forward shader
+	// no longer matches the shared file
+	{
+		std::string fragmentSource;
+		ShaderVariants::ReadSource("shaders/fragmentShader.glsl", fragmentSource);
+	}
+#endif
 
 	// try to create a new scene manager object and prepare the 3D scene
 	g_SceneManager = new SceneManager(g_ShaderManager);
-	g_SceneManager->PrepareScene();
+	// --stream-textures shows the first frame before the textures
+	// are loaded and fills them in as they become ready
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--stream-textures")
+		{
+			g_SceneManager->EnableTextureStreaming(true);
+		}
+		// --texture-array packs the textures into array textures by size
+		else if (std::string(argv[i]) == "--texture-array")
+		{
+			g_SceneManager->SetTextureBackend(SceneManager::TEXTURE_BACKEND_ARRAY);
+		}
+		// --sampler-quality low|medium|high limits the texture filtering
+		else if ((std::string(argv[i]) == "--sampler-quality") && (i + 1 < argc))
+		{
+			std::string quality = argv[++i];
+			if (quality == "low")
+				g_SceneManager->SetSamplerQuality(SamplerRegistry::SAMPLER_QUALITY_LOW);
+			else if (quality == "medium")
+				g_SceneManager->SetSamplerQuality(SamplerRegistry::SAMPLER_QUALITY_MEDIUM);
+			else if (quality == "high")
+				g_SceneManager->SetSamplerQuality(SamplerRegistry::SAMPLER_QUALITY_HIGH);
+			else
+				std::cout << "Unknown sampler quality:" << quality << ", expected low, medium or high" << std::endl;
+		}
+		// --texture-budget <megabytes> limits the GPU memory used by textures
+		else if ((std::string(argv[i]) == "--texture-budget") && (i + 1 < argc))
+		{
+			g_SceneManager->SetTextureBudget((size_t)atoi(argv[++i]) * 1024 * 1024);
+		}
+		// --watch-textures reloads each texture when its image file changes
+		else if (std::string(argv[i]) == "--watch-textures")
+		{
+			g_SceneManager->EnableTextureHotReload("textures");
+		}
+		// --gpu-mipmaps builds the mip levels with glGenerateMipmap()
+		else if (std::string(argv[i]) == "--gpu-mipmaps")
+		{
+			g_SceneManager->EnableCPUMipmaps(false);
+		}
+		// --compress-textures block compresses the textures, cached in textures/cache
+		else if (std::string(argv[i]) == "--compress-textures")
+		{
+			g_SceneManager->EnableTextureCompression(true);
+		}
+		// --shader-variants draws with shaders specialized for the draw state
+		else if (std::string(argv[i]) == "--shader-variants")
+		{
+			g_SceneManager->EnableShaderVariants(
+				"shaders/vertexShader.glsl",
+				"shaders/fragmentShader.glsl");
+		}
+		// --clustered-lights <count> shades point lights by view frustum
+		// cluster and adds count test lights, --clustered-lights-cpu
+		// builds the light lists on the CPU even with compute shaders
+		else if (((std::string(argv[i]) == "--clustered-lights") || (std::string(argv[i]) == "--clustered-lights-cpu")) && (i + 1 < argc))
+		{
+			bool bCompute = (std::string(argv[i]) == "--clustered-lights");
+			g_SceneManager->EnableClusteredLights(bCompute ? "shaders/clusterComputeShader.glsl" : NULL);
+			g_SceneManager->AddClusteredTestLights(atoi(argv[++i]));
+		}
+		// --deferred fills a G-buffer with the opaque draws and lights it
+		// with fullscreen passes, the transparent draws stay forward
+		else if (std::string(argv[i]) == "--deferred")
+		{
+			g_SceneManager->EnableDeferredShading(
+				"shaders/vertexShader.glsl",
+				"shaders/gbufferFragmentShader.glsl",
+				"shaders/deferredLightingVertexShader.glsl",
+				"shaders/deferredLightingFragmentShader.glsl");
+		}
+		// --shadows casts shadows from the directional and point lights,
+		// the shadow maps are only rendered again when something moves
+		else if (std::string(argv[i]) == "--shadows")
+		{
+			g_SceneManager->EnableShadows(
+				"shaders/shadowVertexShader.glsl",
+				"shaders/shadowFragmentShader.glsl");
+		}
+		// --lazy-resources creates textures and meshes when first drawn
+		else if (std::string(argv[i]) == "--lazy-resources")
+		{
+			g_SceneManager->EnableLazyResources(true);
+		}
+		// --prewarm name,name,... still loads these textures and meshes
+		// up front in lazy mode
+		else if ((std::string(argv[i]) == "--prewarm") && (i + 1 < argc))
+		{
+			std::string names = argv[++i];
+			size_t start = 0;
+			while (start <= names.size())
+			{
+				size_t end = names.find(',', start);
+				if (end == std::string::npos)
+				{
+					end = names.size();
+				}
+				if (end > start)
+				{
+					g_SceneManager->AddPrewarmResource(names.substr(start, end - start));
+				}
+				start = end + 1;
+			}
+		}
+		// --startup-trace [file] writes the startup phases as a Chrome
+		// trace at the first frame, startup_trace.json by default
+		else if (std::string(argv[i]) == "--startup-trace")
+		{
+			if ((i + 1 < argc) && (std::string(argv[i + 1]).compare(0, 2, "--") != 0))
+			{
+				StartupTrace::SetOutputFile(argv[++i]);
+			}
+			else
+			{
+				StartupTrace::SetOutputFile("startup_trace.json");
+			}
+		}
+		// --image-decoder stb|turbojpeg chooses the image decoder backend
+		else if ((std::string(argv[i]) == "--image-decoder") && (i + 1 < argc))
+		{
+			ImageDecoder::SetPreferredBackend(std::string(argv[++i]));
+		}
+	}
+	{
+		StartupTrace::Scope trace("PrepareScene", "main");
+		g_SceneManager->PrepareScene();
+	}
 
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
+		int64_t frameStart = StartupTrace::GetMicroseconds();
+
 		// Enable z-depth
 		glEnable(GL_DEPTH_TEST);
 
@@ -106,6 +279,13 @@ int main(int argc, char* argv[])
 		// Flips the the back buffer with the front buffer every frame.
 		glfwSwapBuffers(g_Window);
 
+		// the startup ends once the first frame is presented
+		if (StartupTrace::IsRecording())
+		{
+			StartupTrace::AddEvent("FirstFrame", "main", frameStart, StartupTrace::GetMicroseconds());
+			StartupTrace::Finish();
+		}
+
 		// query the latest GLFW events
 		glfwPollEvents();
 	}
@@ -138,6 +318,8 @@ int main(int argc, char* argv[])
  ***********************************************************/
 bool InitializeGLFW()
 {
+	StartupTrace::Scope trace("InitializeGLFW", "main");
+
 	// GLFW: initialize and configure library
 	// --------------------------------------
 	glfwInit();
@@ -165,6 +347,8 @@ bool InitializeGLFW()
  ***********************************************************/
 bool InitializeGLEW()
 {
+	StartupTrace::Scope trace("InitializeGLEW", "main");
+
 	// GLEW: initialize
 	// -----------------------------------------
 	GLenum GLEWInitResult = GLEW_OK;
@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// materialbuffer.cpp
+// ============
+// hold every object material in a uniform buffer indexed by the shader
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MaterialBuffer.h"
+
+#include <iostream>
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// name of the uniform block in the fragment shader
+	const char* g_MaterialBlockName = "MaterialBlock";
+}
+
+/***********************************************************
+ *  MaterialBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MaterialBuffer::MaterialBuffer()
+{
+	m_bufferID = 0;
+	m_boundPage = -1;
+}
+
+/***********************************************************
+ *  ~MaterialBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MaterialBuffer::~MaterialBuffer()
+{
+	m_materials.clear();
+}
+
+/***********************************************************
+ *  AddMaterial()
+ *
+ *  This method is used for adding a material to the data
+ *  that is uploaded by Upload().
+ ***********************************************************/
+int MaterialBuffer::AddMaterial(const glm::vec3& diffuseColor, const glm::vec3& specularColor, float shininess)
+{
+	MATERIAL_DATA material;
+	material.diffuseShininess = glm::vec4(diffuseColor, shininess);
+	material.specularColor = glm::vec4(specularColor, 0.0f);
+	m_materials.push_back(material);
+	return((int)m_materials.size() - 1);
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for creating the uniform buffer from
+ *  the added materials.  The last page is padded to a whole
+ *  page, so every page can be bound with the same size.
+ ***********************************************************/
+bool MaterialBuffer::Upload(GLuint programID)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(programID, g_MaterialBlockName);
+	if (blockIndex == GL_INVALID_INDEX)
+	{
+		std::cout << "Shader has no uniform block:" << g_MaterialBlockName << std::endl;
+		return(false);
+	}
+	glUniformBlockBinding(programID, blockIndex, BLOCK_BINDING);
+
+	size_t pageCount = (m_materials.size() + MATERIALS_PER_PAGE - 1) / MATERIALS_PER_PAGE;
+	std::vector<MATERIAL_DATA> pages(std::max(pageCount, (size_t)1) * MATERIALS_PER_PAGE);
+	std::copy(m_materials.begin(), m_materials.end(), pages.begin());
+
+	if (m_bufferID == 0)
+	{
+		glGenBuffers(1, &m_bufferID);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, m_bufferID);
+	glBufferData(GL_UNIFORM_BUFFER, pages.size() * sizeof(MATERIAL_DATA), pages.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	m_boundPage = -1;
+	Bind(0);
+
+	std::cout << "Uploaded " << m_materials.size() << " materials in " << std::max(pageCount, (size_t)1) << " uniform buffer pages" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for binding the page holding a
+ *  material to the material block.  The page size is a
+ *  multiple of every uniform buffer offset alignment
+ *  allowed by OpenGL, so any page can be bound.
+ ***********************************************************/
+int MaterialBuffer::Bind(int materialIndex)
+{
+	int page = materialIndex / MATERIALS_PER_PAGE;
+	if ((page != m_boundPage) && (m_bufferID != 0))
+	{
+		GLsizeiptr pageBytes = MATERIALS_PER_PAGE * sizeof(MATERIAL_DATA);
+		glBindBufferRange(GL_UNIFORM_BUFFER, BLOCK_BINDING, m_bufferID, page * pageBytes, pageBytes);
+		m_boundPage = page;
+	}
+	return(materialIndex % MATERIALS_PER_PAGE);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the uniform buffer.
+ ***********************************************************/
+void MaterialBuffer::Destroy()
+{
+	if (m_bufferID != 0)
+	{
+		glDeleteBuffers(1, &m_bufferID);
+		m_bufferID = 0;
+	}
+	m_materials.clear();
+	m_boundPage = -1;
+}
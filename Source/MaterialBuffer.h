@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// materialbuffer.h
+// ============
+// hold every object material in a uniform buffer indexed by the shader
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  MaterialBuffer
+ *
+ *  This class uploads all of the object materials once into
+ *  a uniform buffer, so a draw selects its material with a
+ *  single integer uniform.  The buffer is split into pages
+ *  of MATERIALS_PER_PAGE materials, the most a uniform
+ *  block is guaranteed to hold, and the page holding the
+ *  material is bound to the material block.  Any number of
+ *  materials can be stored, and the binding only changes
+ *  when consecutive draws use materials on different pages.
+ ***********************************************************/
+class MaterialBuffer
+{
+public:
+	// materials in one page, must match MATERIALS_PER_BLOCK in
+	// the fragment shader - 16 KB, the minimum uniform block size
+	static const int MATERIALS_PER_PAGE = 512;
+	// uniform buffer binding point of the material block
+	static const GLuint BLOCK_BINDING = 0;
+
+	// constructor
+	MaterialBuffer();
+	// destructor
+	~MaterialBuffer();
+
+	// add a material, returns its index in the buffer
+	int AddMaterial(const glm::vec3& diffuseColor, const glm::vec3& specularColor, float shininess);
+	// upload the added materials and connect the material
+	// block of the shader program to the buffer
+	bool Upload(GLuint programID);
+	// bind the page holding a material, returns the index of
+	// the material within the bound page
+	int Bind(int materialIndex);
+	// buffer holding every page, 0 before Upload()
+	GLuint GetBufferID() const { return(m_bufferID); }
+	// free the buffer and forget the materials
+	void Destroy();
+
+private:
+	// one material as laid out by std140 in the material block
+	struct MATERIAL_DATA
+	{
+		// diffuse color in xyz, shininess in w
+		glm::vec4 diffuseShininess;
+		glm::vec4 specularColor;
+	};
+
+	// material data, uploaded by Upload()
+	std::vector<MATERIAL_DATA> m_materials;
+	// uniform buffer holding every page
+	GLuint m_bufferID;
+	// page bound to the material block, -1 for none
+	int m_boundPage;
+};
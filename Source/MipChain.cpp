@@ -0,0 +1,380 @@
+///////////////////////////////////////////////////////////////////////////////
+// mipchain.cpp
+// ============
+// build texture mipmaps on the CPU in linear color space with SIMD
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MipChain.h"
+
+#include <algorithm>
+#include <cmath>
+
+// the AVX2 filter is compiled for every x86 target and only used
+// when the processor has AVX2, so the build does not need /arch:AVX2
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <immintrin.h>
+#include <intrin.h>
+#define MIPCHAIN_AVX2
+#define MIPCHAIN_AVX2_TARGET
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+#include <immintrin.h>
+#define MIPCHAIN_AVX2
+#define MIPCHAIN_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define MIPCHAIN_SSE2
+#endif
+
+// declaration of global variables
+namespace
+{
+	// the linear to sRGB table is indexed by the top 12 bits
+	const int g_LinearTableBits = 12;
+
+	/***********************************************************
+	 *  COLOR_TABLES
+	 *
+	 *  Lookup tables between 8-bit sRGB and 16-bit linear.
+	 ***********************************************************/
+	struct COLOR_TABLES
+	{
+		uint16_t toLinear[256];
+		unsigned char toSRGB[1 << g_LinearTableBits];
+
+		COLOR_TABLES()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				double c = i / 255.0;
+				double linear = (c <= 0.04045) ? (c / 12.92) : pow((c + 0.055) / 1.055, 2.4);
+				toLinear[i] = (uint16_t)(linear * 65535.0 + 0.5);
+			}
+			for (int i = 0; i < (1 << g_LinearTableBits); i++)
+			{
+				// convert the center of each bucket
+				double linear = (i + 0.5) / (double)(1 << g_LinearTableBits);
+				double c = (linear <= 0.0031308) ? (linear * 12.92) : (1.055 * pow(linear, 1.0 / 2.4) - 0.055);
+				toSRGB[i] = (unsigned char)std::min(std::max(c * 255.0 + 0.5, 0.0), 255.0);
+			}
+		}
+	};
+
+	/***********************************************************
+	 *  GetColorTables()
+	 *
+	 *  The tables are built once, on first use.
+	 ***********************************************************/
+	const COLOR_TABLES& GetColorTables()
+	{
+		static const COLOR_TABLES tables;
+		return(tables);
+	}
+
+#ifdef MIPCHAIN_AVX2
+	/***********************************************************
+	 *  HasAVX2()
+	 *
+	 *  True when the processor and the operating system
+	 *  support AVX2, checked once.
+	 ***********************************************************/
+	bool HasAVX2()
+	{
+#if defined(_MSC_VER)
+		static const bool bSupported = []()
+		{
+			int info[4] = { 0 };
+			__cpuid(info, 0);
+			if (info[0] < 7)
+			{
+				return(false);
+			}
+			// the OS must save the YMM registers on a context switch
+			__cpuid(info, 1);
+			bool bOSXSave = (info[2] & (1 << 27)) != 0;
+			if ((bOSXSave == false) || ((_xgetbv(0) & 6) != 6))
+			{
+				return(false);
+			}
+			__cpuidex(info, 7, 0);
+			return((info[1] & (1 << 5)) != 0);
+		}();
+#else
+		static const bool bSupported = (__builtin_cpu_supports("avx2") != 0);
+#endif
+		return(bSupported);
+	}
+
+	/***********************************************************
+	 *  DownsampleRowAVX2()
+	 *
+	 *  Box filter the start of a row of linear RGBA16 texels
+	 *  with AVX2, four outputs at a time.  Returns the number
+	 *  of outputs written, the caller finishes the row.
+	 ***********************************************************/
+	MIPCHAIN_AVX2_TARGET int DownsampleRowAVX2(const uint16_t* row0, const uint16_t* row1, uint16_t* output, int pairs)
+	{
+		int x = 0;
+		// four output texels from eight source texels of each row
+		const __m256i round = _mm256_set1_epi32(2);
+		for (; x + 4 <= pairs; x += 4)
+		{
+			const uint16_t* a = row0 + x * 8;
+			const uint16_t* b = row1 + x * 8;
+			__m256i s0 = _mm256_add_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(a + 0))), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(b + 0))));
+			__m256i s1 = _mm256_add_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(a + 8))), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(b + 8))));
+			__m256i s2 = _mm256_add_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(a + 16))), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(b + 16))));
+			__m256i s3 = _mm256_add_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(a + 24))), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(b + 24))));
+
+			// each lane holds one column sum, add the neighbouring columns
+			__m256i o01 = _mm256_add_epi32(_mm256_permute2x128_si256(s0, s1, 0x20), _mm256_permute2x128_si256(s0, s1, 0x31));
+			__m256i o23 = _mm256_add_epi32(_mm256_permute2x128_si256(s2, s3, 0x20), _mm256_permute2x128_si256(s2, s3, 0x31));
+			o01 = _mm256_srli_epi32(_mm256_add_epi32(o01, round), 2);
+			o23 = _mm256_srli_epi32(_mm256_add_epi32(o23, round), 2);
+
+			// the pack interleaves the lanes, restore the texel order
+			__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(o01, o23), 0xD8);
+			_mm256_storeu_si256((__m256i*)(output + x * 4), packed);
+		}
+		return(x);
+	}
+#endif
+
+	/***********************************************************
+	 *  DownsampleLinear()
+	 *
+	 *  Build the next level of a linear RGBA16 image with a
+	 *  2x2 box filter.  A trailing odd row or column is left
+	 *  out, as the levels are half the size rounded down; a
+	 *  level that is one texel wide or high clamps instead.
+	 ***********************************************************/
+	void DownsampleLinear(
+		const uint16_t* source, int sourceWidth, int sourceHeight,
+		uint16_t* destination, int width, int height)
+	{
+		// outputs whose two source columns are both in the image
+		int pairs = std::min(width, sourceWidth / 2);
+
+		for (int y = 0; y < height; y++)
+		{
+			const uint16_t* row0 = source + (size_t)std::min(y * 2, sourceHeight - 1) * sourceWidth * 4;
+			const uint16_t* row1 = source + (size_t)std::min(y * 2 + 1, sourceHeight - 1) * sourceWidth * 4;
+			uint16_t* output = destination + (size_t)y * width * 4;
+			int x = 0;
+
+#ifdef MIPCHAIN_AVX2
+			if (HasAVX2())
+			{
+				x = DownsampleRowAVX2(row0, row1, output, pairs);
+			}
+#endif
+#ifdef MIPCHAIN_SSE2
+			// two output texels from four source texels of each row
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i round2 = _mm_set1_epi32(2);
+			const __m128i bias = _mm_set1_epi32(32768);
+			const __m128i sign = _mm_set1_epi16((short)0x8000);
+			for (; x + 2 <= pairs; x += 2)
+			{
+				const uint16_t* a = row0 + x * 8;
+				const uint16_t* b = row1 + x * 8;
+				__m128i a0 = _mm_loadu_si128((const __m128i*)(a + 0));
+				__m128i a1 = _mm_loadu_si128((const __m128i*)(a + 8));
+				__m128i b0 = _mm_loadu_si128((const __m128i*)(b + 0));
+				__m128i b1 = _mm_loadu_si128((const __m128i*)(b + 8));
+
+				__m128i p0 = _mm_add_epi32(_mm_unpacklo_epi16(a0, zero), _mm_unpacklo_epi16(b0, zero));
+				__m128i p1 = _mm_add_epi32(_mm_unpackhi_epi16(a0, zero), _mm_unpackhi_epi16(b0, zero));
+				__m128i p2 = _mm_add_epi32(_mm_unpacklo_epi16(a1, zero), _mm_unpacklo_epi16(b1, zero));
+				__m128i p3 = _mm_add_epi32(_mm_unpackhi_epi16(a1, zero), _mm_unpackhi_epi16(b1, zero));
+				__m128i o0 = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(p0, p1), round2), 2);
+				__m128i o1 = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(p2, p3), round2), 2);
+
+				// SSE2 only packs signed values, so shift the range down and back
+				__m128i packed = _mm_packs_epi32(_mm_sub_epi32(o0, bias), _mm_sub_epi32(o1, bias));
+				_mm_storeu_si128((__m128i*)(output + x * 4), _mm_xor_si128(packed, sign));
+			}
+#endif
+			for (; x < width; x++)
+			{
+				int x0 = std::min(x * 2, sourceWidth - 1);
+				int x1 = std::min(x * 2 + 1, sourceWidth - 1);
+				for (int c = 0; c < 4; c++)
+				{
+					uint32_t sum = (uint32_t)row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+					output[x * 4 + c] = (uint16_t)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  StoreLevel()
+	 *
+	 *  Convert a linear RGBA16 level back to the 8-bit sRGB
+	 *  layout of the source image.
+	 ***********************************************************/
+	void StoreLevel(const uint16_t* linear, size_t texels, int colorChannels, unsigned char* destination)
+	{
+		const COLOR_TABLES& tables = GetColorTables();
+		const int shift = 16 - g_LinearTableBits;
+
+		for (size_t i = 0; i < texels; i++)
+		{
+			const uint16_t* texel = linear + i * 4;
+			unsigned char alpha = (unsigned char)(((uint32_t)texel[3] * 255 + 32767) / 65535);
+			switch (colorChannels)
+			{
+			case 1:
+				destination[0] = tables.toSRGB[texel[0] >> shift];
+				break;
+			case 2:
+				destination[0] = tables.toSRGB[texel[0] >> shift];
+				destination[1] = alpha;
+				break;
+			default:
+				destination[0] = tables.toSRGB[texel[0] >> shift];
+				destination[1] = tables.toSRGB[texel[1] >> shift];
+				destination[2] = tables.toSRGB[texel[2] >> shift];
+				if (colorChannels == 4)
+					destination[3] = alpha;
+				break;
+			}
+			destination += colorChannels;
+		}
+	}
+}
+
+/***********************************************************
+ *  MipChain()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MipChain::MipChain()
+{
+	m_width = 0;
+	m_height = 0;
+	m_colorChannels = 0;
+}
+
+/***********************************************************
+ *  Generate()
+ *
+ *  This method is used for building every mip level below
+ *  the passed in image.  Each level is built from the
+ *  linear 16-bit copy of the level above it, so the color
+ *  is only rounded to 8 bits once per level.
+ ***********************************************************/
+bool MipChain::Generate(const unsigned char* pixels, int width, int height, int colorChannels)
+{
+	m_levels.clear();
+	m_data.clear();
+	if ((NULL == pixels) || (width < 1) || (height < 1) || (colorChannels < 1) || (colorChannels > 4))
+	{
+		return(false);
+	}
+	m_width = width;
+	m_height = height;
+	m_colorChannels = colorChannels;
+
+	// reserve the data of every level up front
+	size_t totalBytes = 0;
+	int levelWidth = width;
+	int levelHeight = height;
+	while ((levelWidth > 1) || (levelHeight > 1))
+	{
+		levelWidth = std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+
+		MIP_LEVEL level;
+		level.width = levelWidth;
+		level.height = levelHeight;
+		level.offset = totalBytes;
+		level.size = (size_t)levelWidth * levelHeight * colorChannels;
+		m_levels.push_back(level);
+		totalBytes += level.size;
+	}
+	m_data.resize(totalBytes);
+
+	// convert the source image to linear RGBA16
+	const COLOR_TABLES& tables = GetColorTables();
+	std::vector<uint16_t> current((size_t)width * height * 4);
+	for (size_t i = 0; i < (size_t)width * height; i++)
+	{
+		const unsigned char* texel = pixels + i * colorChannels;
+		uint16_t* linear = &current[i * 4];
+		if (colorChannels < 3)
+		{
+			linear[0] = linear[1] = linear[2] = tables.toLinear[texel[0]];
+			linear[3] = (colorChannels == 2) ? (uint16_t)(texel[1] * 257) : 65535;
+		}
+		else
+		{
+			linear[0] = tables.toLinear[texel[0]];
+			linear[1] = tables.toLinear[texel[1]];
+			linear[2] = tables.toLinear[texel[2]];
+			linear[3] = (colorChannels == 4) ? (uint16_t)(texel[3] * 257) : 65535;
+		}
+	}
+
+	std::vector<uint16_t> next;
+	levelWidth = width;
+	levelHeight = height;
+	for (size_t i = 0; i < m_levels.size(); i++)
+	{
+		const MIP_LEVEL& level = m_levels[i];
+		next.resize((size_t)level.width * level.height * 4);
+		DownsampleLinear(current.data(), levelWidth, levelHeight, next.data(), level.width, level.height);
+		StoreLevel(next.data(), (size_t)level.width * level.height, colorChannels, m_data.data() + level.offset);
+
+		current.swap(next);
+		levelWidth = level.width;
+		levelHeight = level.height;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for uploading the source image as
+ *  level 0 and every generated level into the texture bound
+ *  to GL_TEXTURE_2D.
+ ***********************************************************/
+void MipChain::Upload(const unsigned char* levelZero, GLenum internalFormat, GLenum format) const
+{
+	// the small levels are not padded to four byte rows
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_width, m_height, 0, format, GL_UNSIGNED_BYTE, levelZero);
+	for (int i = 1; i < GetLevelCount(); i++)
+	{
+		const MIP_LEVEL& level = GetLevel(i);
+		glTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, GetLevelData(i));
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GetLevelCount() - 1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+/***********************************************************
+ *  GetInstructionSet()
+ *
+ *  This method is used for getting the name of the vector
+ *  instructions the box filter was compiled with.
+ ***********************************************************/
+const char* MipChain::GetInstructionSet()
+{
+#if defined(MIPCHAIN_AVX2)
+	if (HasAVX2())
+	{
+		return("AVX2");
+	}
+#endif
+#if defined(MIPCHAIN_SSE2)
+	return("SSE2");
+#else
+	return("scalar");
+#endif
+}
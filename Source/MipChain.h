@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// mipchain.h
+// ============
+// build texture mipmaps on the CPU in linear color space with SIMD
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/***********************************************************
+ *  MipChain
+ *
+ *  This class builds every mip level below a decoded 8-bit
+ *  image, so textures can be uploaded without calling
+ *  glGenerateMipmap.  The color channels are converted from
+ *  sRGB to linear before they are averaged, which keeps
+ *  the smaller levels from darkening.  The 2x2 box filter
+ *  uses AVX2 when the processor has it, otherwise SSE2 when
+ *  the compiler targets it.
+ ***********************************************************/
+class MipChain
+{
+public:
+	struct MIP_LEVEL
+	{
+		int width;
+		int height;
+		// offset of the level in the generated data
+		size_t offset;
+		size_t size;
+	};
+
+	// constructor
+	MipChain();
+
+	// build levels 1 to n of an image, can run on any thread
+	bool Generate(const unsigned char* pixels, int width, int height, int colorChannels);
+	// number of levels, including the source image as level 0
+	int GetLevelCount() const { return((int)m_levels.size() + 1); }
+	// get a generated level, 1 to GetLevelCount() - 1
+	const MIP_LEVEL& GetLevel(int level) const { return(m_levels[level - 1]); }
+	const unsigned char* GetLevelData(int level) const { return(m_data.data() + GetLevel(level).offset); }
+	// bytes of all of the generated levels
+	size_t GetTotalBytes() const { return(m_data.size()); }
+	// upload the source image and the generated levels into the
+	// texture bound to GL_TEXTURE_2D
+	void Upload(const unsigned char* levelZero, GLenum internalFormat, GLenum format) const;
+
+	// name of the instruction set the box filter runs with
+	static const char* GetInstructionSet();
+
+private:
+	// size of the source image
+	int m_width;
+	int m_height;
+	int m_colorChannels;
+	// generated levels, level 1 first
+	std::vector<MIP_LEVEL> m_levels;
+	// pixel data of the generated levels
+	std::vector<unsigned char> m_data;
+};
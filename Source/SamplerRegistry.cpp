@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+// samplerregistry.cpp
+// ============
+// own the OpenGL sampler objects used for texture filtering and wrapping
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SamplerRegistry.h"
+
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// largest anisotropy used by the medium quality tier
+	const float g_MediumMaxAnisotropy = 4.0f;
+
+	/***********************************************************
+	 *  PackSamplerState()
+	 *
+	 *  Pack a sampler state into a key for the sampler index.
+	 ***********************************************************/
+	uint64_t PackSamplerState(const SamplerRegistry::SAMPLER_STATE& state)
+	{
+		uint64_t key = (uint64_t)state.wrapMode;
+		key |= (uint64_t)(state.bTrilinear ? 1 : 0) << 32;
+		key |= (uint64_t)(std::max((int)state.anisotropy, 1) & 0xff) << 33;
+		return(key);
+	}
+}
+
+/***********************************************************
+ *  SamplerRegistry()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SamplerRegistry::SamplerRegistry()
+{
+	m_quality = SAMPLER_QUALITY_HIGH;
+	m_maxAnisotropy = 1.0f;
+	m_bQueriedLimits = false;
+}
+
+/***********************************************************
+ *  ~SamplerRegistry()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SamplerRegistry::~SamplerRegistry()
+{
+	m_samplers.clear();
+	m_samplerIndex.clear();
+}
+
+/***********************************************************
+ *  DefaultState()
+ *
+ *  This method is used for getting the sampler state used
+ *  by materials that do not request their own.
+ ***********************************************************/
+SamplerRegistry::SAMPLER_STATE SamplerRegistry::DefaultState()
+{
+	SAMPLER_STATE state;
+	state.bTrilinear = true;
+	state.anisotropy = 1.0f;
+	state.wrapMode = GL_REPEAT;
+	return(state);
+}
+
+/***********************************************************
+ *  SetQuality()
+ *
+ *  This method is used for changing the quality tier.  The
+ *  existing sampler objects are updated in place, so their
+ *  IDs and bindings stay valid.
+ ***********************************************************/
+void SamplerRegistry::SetQuality(SAMPLER_QUALITY quality)
+{
+	m_quality = quality;
+	for (size_t i = 0; i < m_samplers.size(); i++)
+	{
+		ApplyState(m_samplers[i]);
+	}
+}
+
+/***********************************************************
+ *  GetSampler()
+ *
+ *  This method is used for getting the sampler object for
+ *  the passed in state.  Materials requesting the same
+ *  state share one sampler object.
+ ***********************************************************/
+GLuint SamplerRegistry::GetSampler(const SAMPLER_STATE& state)
+{
+	uint64_t key = PackSamplerState(state);
+	std::unordered_map<uint64_t, size_t>::iterator found = m_samplerIndex.find(key);
+	if (found != m_samplerIndex.end())
+	{
+		return(m_samplers[found->second].samplerID);
+	}
+
+	if (m_bQueriedLimits == false)
+	{
+		if (GLEW_EXT_texture_filter_anisotropic || GLEW_ARB_texture_filter_anisotropic)
+		{
+			glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &m_maxAnisotropy);
+		}
+		m_bQueriedLimits = true;
+	}
+
+	SAMPLER_ENTRY sampler;
+	sampler.state = state;
+	sampler.samplerID = 0;
+	glGenSamplers(1, &sampler.samplerID);
+	ApplyState(sampler);
+
+	m_samplerIndex[key] = m_samplers.size();
+	m_samplers.push_back(sampler);
+
+	return(sampler.samplerID);
+}
+
+/***********************************************************
+ *  ApplyState()
+ *
+ *  This method is used for setting the parameters of a
+ *  sampler object from its requested state, limited by the
+ *  quality tier and the device.
+ ***********************************************************/
+void SamplerRegistry::ApplyState(const SAMPLER_ENTRY& sampler)
+{
+	GLenum minFilter = GL_LINEAR_MIPMAP_NEAREST;
+	float anisotropy = 1.0f;
+
+	if (m_quality == SAMPLER_QUALITY_MEDIUM)
+	{
+		minFilter = sampler.state.bTrilinear ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR_MIPMAP_NEAREST;
+		anisotropy = std::min(sampler.state.anisotropy, g_MediumMaxAnisotropy);
+	}
+	else if (m_quality == SAMPLER_QUALITY_HIGH)
+	{
+		minFilter = sampler.state.bTrilinear ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR_MIPMAP_NEAREST;
+		anisotropy = sampler.state.anisotropy;
+	}
+	anisotropy = std::max(std::min(anisotropy, m_maxAnisotropy), 1.0f);
+
+	glSamplerParameteri(sampler.samplerID, GL_TEXTURE_WRAP_S, sampler.state.wrapMode);
+	glSamplerParameteri(sampler.samplerID, GL_TEXTURE_WRAP_T, sampler.state.wrapMode);
+	glSamplerParameteri(sampler.samplerID, GL_TEXTURE_MIN_FILTER, minFilter);
+	glSamplerParameteri(sampler.samplerID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (m_maxAnisotropy > 1.0f)
+	{
+		glSamplerParameterf(sampler.samplerID, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy);
+	}
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for binding a sampler object to a
+ *  texture unit.  Nothing is done if the sampler is already
+ *  bound to the unit.
+ ***********************************************************/
+void SamplerRegistry::Bind(int textureUnit, GLuint samplerID)
+{
+	if (textureUnit < 0)
+	{
+		return;
+	}
+	if ((size_t)textureUnit >= m_boundSamplers.size())
+	{
+		m_boundSamplers.resize(textureUnit + 1, 0);
+	}
+	if (m_boundSamplers[textureUnit] != samplerID)
+	{
+		glBindSampler(textureUnit, samplerID);
+		m_boundSamplers[textureUnit] = samplerID;
+	}
+}
+
+/***********************************************************
+ *  ResetBindings()
+ *
+ *  This method is used for forgetting the sampler bound to
+ *  each texture unit, so the next Bind() always binds.
+ ***********************************************************/
+void SamplerRegistry::ResetBindings()
+{
+	m_boundSamplers.clear();
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for unbinding and freeing all of the
+ *  sampler objects.
+ ***********************************************************/
+void SamplerRegistry::Destroy()
+{
+	for (size_t i = 0; i < m_boundSamplers.size(); i++)
+	{
+		if (m_boundSamplers[i] != 0)
+		{
+			glBindSampler((GLuint)i, 0);
+		}
+	}
+	for (size_t i = 0; i < m_samplers.size(); i++)
+	{
+		glDeleteSamplers(1, &m_samplers[i].samplerID);
+	}
+	m_samplers.clear();
+	m_samplerIndex.clear();
+	m_boundSamplers.clear();
+}
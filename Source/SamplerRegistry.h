@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+// samplerregistry.h
+// ============
+// own the OpenGL sampler objects used for texture filtering and wrapping
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+/***********************************************************
+ *  SamplerRegistry
+ *
+ *  This class creates one sampler object for each distinct
+ *  sampler state requested by the materials.  A global
+ *  quality tier limits the filtering that the samplers
+ *  actually use, so the sampling cost can be traded against
+ *  image quality without touching the textures.
+ ***********************************************************/
+class SamplerRegistry
+{
+public:
+	// global texture filtering quality
+	enum SAMPLER_QUALITY
+	{
+		// bilinear filtering within the nearest mip level
+		SAMPLER_QUALITY_LOW,
+		// trilinear filtering, anisotropy limited to 4x
+		SAMPLER_QUALITY_MEDIUM,
+		// the filtering requested by each material
+		SAMPLER_QUALITY_HIGH
+	};
+
+	// filtering and wrapping requested for a material
+	struct SAMPLER_STATE
+	{
+		// blend between mip levels
+		bool bTrilinear;
+		// requested anisotropy level, 1 to disable
+		float anisotropy;
+		// GL_REPEAT, GL_CLAMP_TO_EDGE or GL_MIRRORED_REPEAT
+		GLenum wrapMode;
+	};
+
+	// constructor
+	SamplerRegistry();
+	// destructor
+	~SamplerRegistry();
+
+	// trilinear, no anisotropy, repeating
+	static SAMPLER_STATE DefaultState();
+
+	// change the quality tier of every sampler
+	void SetQuality(SAMPLER_QUALITY quality);
+	SAMPLER_QUALITY GetQuality() const { return(m_quality); }
+	// get the sampler object for a state, created on first use
+	GLuint GetSampler(const SAMPLER_STATE& state);
+	// bind a sampler to a texture unit unless it is already bound
+	void Bind(int textureUnit, GLuint samplerID);
+	// forget the sampler bound to each texture unit
+	void ResetBindings();
+	// free all of the sampler objects
+	void Destroy();
+
+private:
+	struct SAMPLER_ENTRY
+	{
+		SAMPLER_STATE state;
+		GLuint samplerID;
+	};
+
+	// set the sampler parameters for the current quality tier
+	void ApplyState(const SAMPLER_ENTRY& sampler);
+
+	// selected quality tier
+	SAMPLER_QUALITY m_quality;
+	// largest anisotropy supported, 1 if not supported
+	float m_maxAnisotropy;
+	// true once the device limits have been queried
+	bool m_bQueriedLimits;
+	// created samplers
+	std::vector<SAMPLER_ENTRY> m_samplers;
+	// maps packed sampler states to their index in m_samplers
+	std::unordered_map<uint64_t, size_t> m_samplerIndex;
+	// sampler bound to each texture unit, 0 for none
+	std::vector<GLuint> m_boundSamplers;
+};
@@ -8,6 +8,11 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
+#include "TextureContainer.h"
+#include "MipChain.h"
+#include "StartupTrace.h"
+#include "TextureFormat.h"
+#include "TextureCompressor.h"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -15,15 +20,76 @@
 #endif
 
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
 
 // declaration of global variables
 namespace
 {
-	const char* g_ModelName = "model";
-	const char* g_ColorValueName = "objectColor";
-	const char* g_TextureValueName = "objectTexture";
-	const char* g_UseTextureName = "bUseTexture";
-	const char* g_UseLightingName = "bUseLighting";
+	// uniform names, hashed at compile time
+	constexpr UniformCache::UNIFORM_NAME g_ModelName("model");
+	constexpr UniformCache::UNIFORM_NAME g_ColorValueName("objectColor");
+	constexpr UniformCache::UNIFORM_NAME g_TextureValueName("objectTexture");
+	constexpr UniformCache::UNIFORM_NAME g_UseTextureName("bUseTexture");
+	constexpr UniformCache::UNIFORM_NAME g_UseLightingName("bUseLighting");
+	constexpr UniformCache::UNIFORM_NAME g_TextureArrayValueName("objectTextureArray");
+	constexpr UniformCache::UNIFORM_NAME g_TextureLayerName("objectTextureLayer");
+	constexpr UniformCache::UNIFORM_NAME g_UseTextureArrayName("bUseTextureArray");
+	constexpr UniformCache::UNIFORM_NAME g_UVScaleName("UVscale");
+	constexpr UniformCache::UNIFORM_NAME g_MaterialIndexName("materialIndex");
+	constexpr UniformCache::UNIFORM_NAME g_PointLightMaskName("pointLightMask");
+	constexpr UniformCache::UNIFORM_NAME g_ViewName("view");
+	constexpr UniformCache::UNIFORM_NAME g_ProjectionName("projection");
+	constexpr UniformCache::UNIFORM_NAME g_UseClusteredLightsName("bUseClusteredLights");
+	// uniforms set into the ShaderManager program once per frame,
+	// set from there into the other programs
+	constexpr UniformCache::UNIFORM_NAME g_ViewPositionName("viewPosition");
+	constexpr UniformCache::UNIFORM_NAME g_ClusterTileSizeName("clusterTileSize");
+	constexpr UniformCache::UNIFORM_NAME g_ClusterDepthParamsName("clusterDepthParams");
+	constexpr UniformCache::UNIFORM_NAME g_DirectionalShadowMatrixName("directionalShadowMatrix");
+	constexpr UniformCache::UNIFORM_NAME g_PointShadowMaskName("pointShadowMask");
+	constexpr UniformCache::UNIFORM_NAME g_UseShadowsName("bUseShadows");
+	// box around every shadow caster and receiver of the scene, the
+	// directional light's shadow map covers it
+	const glm::vec3 g_ShadowSceneMinimum(-20.0f, -1.0f, -11.0f);
+	const glm::vec3 g_ShadowSceneMaximum(20.0f, 21.0f, 11.0f);
+
+	// directory of the block compressed texture cache
+	const char* g_CompressionCacheDirectory = "textures/cache";
+
+	// names of the meshes in the prewarm list, by MESH_TYPE
+	const char* const g_MeshNames[SceneManager::MESH_COUNT] =
+	{
+		"plane", "sphere", "cylinder", "torus", "box", "taperedCylinder"
+	};
+	// radius of a sphere around the mesh origin holding the whole
+	// unscaled mesh, by MESH_TYPE, rounded up
+	const float g_MeshBoundingRadius[SceneManager::MESH_COUNT] =
+	{
+		1.42f, 1.0f, 1.42f, 1.5f, 0.87f, 1.42f
+	};
+
+	/***********************************************************
+	 *  ComputeTextureBytes()
+	 *
+	 *  Size in GPU memory of a texture with a full mipmap chain.
+	 ***********************************************************/
+	size_t ComputeTextureBytes(int width, int height, int bytesPerPixel)
+	{
+		size_t total = 0;
+		while (true)
+		{
+			total += (size_t)width * (size_t)height * (size_t)bytesPerPixel;
+			if ((width == 1) && (height == 1))
+			{
+				break;
+			}
+			width = (width > 1) ? (width / 2) : 1;
+			height = (height > 1) ? (height / 2) : 1;
+		}
+		return(total);
+	}
 }
 
 /***********************************************************
@@ -35,6 +101,64 @@ SceneManager::SceneManager(ShaderManager *pShaderManager)
 {
 	m_pShaderManager = pShaderManager;
 	m_basicMeshes = new ShapeMeshes();
+	m_textureCacheHits = 0;
+	m_textureCacheBytesSaved = 0;
+	m_bStreamTextures = false;
+	m_pTextureStreamer = NULL;
+	m_placeholderTexture = 0;
+	m_textureBackend = TEXTURE_BACKEND_UNITS;
+	m_textureArrayUnit = 0;
+	m_boundTextureArray = 0;
+	m_currentTextureUnit = -1;
+	m_pTextureWatcher = NULL;
+	m_bCPUMipmaps = true;
+	m_bLazyResources = false;
+	m_bDeferTextures = false;
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		m_meshLoaded[i] = false;
+	}
+	m_drawState.model = glm::mat4(1.0f);
+	m_drawState.objectColor = glm::vec4(1.0f);
+	m_drawState.UVscale = glm::vec2(1.0f, 1.0f);
+	m_drawState.bUseTexture = false;
+	m_drawState.bUseTextureArray = false;
+	m_drawState.textureLayer = 0;
+	m_drawState.textureUnit = -1;
+	m_drawState.textureArrayUnit = 0;
+	m_drawState.materialIndex = 0;
+	m_drawState.pointLightMask = -1;
+	m_currentProgram = (NULL != pShaderManager) ? pShaderManager->m_programID : 0;
+	m_bShaderVariants = false;
+	m_lightVariant.bTextured = false;
+	m_lightVariant.bLit = false;
+	m_lightVariant.bDirectionalLight = false;
+	m_lightVariant.bSpotLight = false;
+	m_lightVariant.pointLights = 0;
+	m_lightVariant.bClusteredLights = false;
+	m_lightVariant.bShadows = false;
+	m_bVariantLights = true;
+	m_bClusteredLights = false;
+	m_clusterTextureUnit = 0;
+	m_bDeferredShading = false;
+	m_deferredTextureUnit = 0;
+	m_bDeferredUniformsCopied = false;
+	m_renderPass = RENDER_PASS_FORWARD;
+	m_bShadows = false;
+	m_shadowTextureUnit = 0;
+	m_shadowCaster = ShadowMaps::CASTER_NONE;
+	m_shadowPassCaster = ShadowMaps::CASTER_NONE;
+	m_shadowPassLight = -1;
+	m_frame = 0;
+	m_frameState.view = glm::mat4(1.0f);
+	m_frameState.projection = glm::mat4(1.0f);
+	m_frameState.viewPosition = glm::vec3(0.0f);
+	m_frameState.clusterTileSize = glm::vec2(1.0f);
+	m_frameState.clusterDepthParams = glm::vec2(0.0f);
+	m_frameState.directionalShadowMatrix = glm::mat4(1.0f);
+	m_frameState.pointShadowMask = 0;
+	// look up the texture and material tags drawn every frame
+	ResolveSceneTags();
 }
 
 /***********************************************************
@@ -44,9 +168,29 @@ SceneManager::SceneManager(ShaderManager *pShaderManager)
  ***********************************************************/
 SceneManager::~SceneManager()
 {
+	if (NULL != m_pShaderManager)
+	{
+		glUseProgram(m_pShaderManager->m_programID);
+	}
 	m_pShaderManager = NULL;
+	m_shaderVariants.Destroy();
+	m_materialBuffer.Destroy();
+	m_lightBuffer.Destroy();
+	m_clusteredLights.Destroy();
+	m_deferredRenderer.Destroy();
+	m_shadowMaps.Destroy();
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
+	if (NULL != m_pTextureStreamer)
+	{
+		delete m_pTextureStreamer;
+		m_pTextureStreamer = NULL;
+	}
+	if (NULL != m_pTextureWatcher)
+	{
+		delete m_pTextureWatcher;
+		m_pTextureWatcher = NULL;
+	}
 }
 
 /***********************************************************
@@ -55,87 +199,1032 @@ SceneManager::~SceneManager()
  *  This method is used for loading textures from image files,
  *  configuring the texture mapping parameters in OpenGL,
  *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
+ *  the next available texture slot in memory.  Image files
+ *  whose contents were already loaded are not decoded again -
+ *  the tag is registered as an alias of the existing texture.
  ***********************************************************/
 bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 {
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
+	QueueGLTexture(filename, tag);
+	return(FinishGLTextures());
+}
+
+/***********************************************************
+ *  QueueGLTexture()
+ *
+ *  This method is used for queueing an image file to be
+ *  decoded on the worker threads.  The texture is uploaded
+ *  and registered with its tag in FinishGLTextures().  When
+ *  streaming is enabled the texture is loaded in the
+ *  background instead.
+ ***********************************************************/
+void SceneManager::QueueGLTexture(const char* filename, std::string tag)
+{
+	// in lazy mode the texture is loaded when a draw first uses it
+	if (m_bDeferTextures && (IsPrewarmed(tag) == false))
+	{
+		m_deferredTextures[tag] = filename;
+		return;
+	}
+
+	if (m_bStreamTextures && StreamGLTexture(filename, tag))
+	{
+		return;
+	}
 
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
+	// the first texture of a batch sets up the shared decode state
+	if (m_pendingTextures.size() == 0)
+	{
+		// the array backend builds the mipmaps of the whole array
+		m_texturePool.SetGenerateMipmaps(m_bCPUMipmaps && (m_textureBackend == TEXTURE_BACKEND_UNITS));
+		// the array layers are uploaded uncompressed
+		m_texturePool.SetCompressionCache((m_textureBackend == TEXTURE_BACKEND_UNITS) ? m_compressionCache : std::string());
+
+		// images matching already loaded textures are not decoded
+		std::unordered_map<uint64_t, int>::iterator cached;
+		for (cached = m_textureCache.begin(); cached != m_textureCache.end(); cached++)
+		{
+			m_texturePool.MarkImageLoaded(cached->first);
+		}
+	}
+
+	PENDING_TEXTURE pending;
+	pending.filename = filename;
+	pending.tag = tag;
+	pending.jobIndex = m_texturePool.QueueImage(filename);
+	m_pendingTextures.push_back(pending);
+}
 
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
+/***********************************************************
+ *  FinishGLTextures()
+ *
+ *  This method is used for uploading the queued textures as
+ *  the worker threads finish decoding them, and then for
+ *  registering the tags into texture slots in the order the
+ *  textures were queued.
+ ***********************************************************/
+bool SceneManager::FinishGLTextures()
+{
+	bool bAllLoaded = true;
+	// textures uploaded in this batch, keyed by content hash
+	std::unordered_map<uint64_t, TEXTURE_INFO> uploaded;
+
+	// upload each image on this thread as soon as it is decoded
+	int jobIndex = m_texturePool.WaitForFinishedImage();
+	while (jobIndex != -1)
+	{
+		TextureDecodePool::DECODE_JOB& job = m_texturePool.GetJob(jobIndex);
+		if (((NULL != job.image) || (NULL != job.container)) && (job.duplicateOf == -1))
+		{
+			StartupTrace::Scope trace("Upload " + job.filename, "texture");
+			TEXTURE_INFO texture;
+			texture.ID = 0;
+			texture.filename = job.filename;
+			texture.contentHash = job.contentHash;
+			texture.byteSize = 0;
+			texture.layer = -1;
+
+			// the array backend packs the image into a layer, the
+			// array texture itself is uploaded once the batch is done
+			if (m_textureBackend == TEXTURE_BACKEND_ARRAY)
+			{
+				texture.layer = AddToTextureArray(job);
+			}
+
+			if (texture.layer < 0)
+			{
+				texture.ID = UploadGLTexture(job);
+				if (NULL != job.container)
+					texture.byteSize = job.container->GetTotalBytes();
+				else
+					texture.byteSize = ComputeTextureBytes(job.width, job.height, TextureFormat::GetBytesPerPixel(job.colorChannels));
+			}
+			if ((texture.ID != 0) || (texture.layer >= 0))
+			{
+				uploaded[job.contentHash] = texture;
+			}
+		}
+		jobIndex = m_texturePool.WaitForFinishedImage();
+	}
 
-	// if the image was successfully read from the image file
-	if (image)
+	// register the tags in queue order so the slots stay the same
+	for (size_t i = 0; i < m_pendingTextures.size(); i++)
 	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
+		const PENDING_TEXTURE& pending = m_pendingTextures[i];
+		TextureDecodePool::DECODE_JOB& job = m_texturePool.GetJob(pending.jobIndex);
 
-		glGenTextures(1, &textureID);
+		std::unordered_map<uint64_t, int>::iterator cached = m_textureCache.find(job.contentHash);
+		std::unordered_map<uint64_t, TEXTURE_INFO>::iterator texture = uploaded.find(job.contentHash);
+		if (job.bSuccess == false)
+		{
+			std::cout << "Could not load image:" << pending.filename << std::endl;
+			bAllLoaded = false;
+		}
+		else if (cached != m_textureCache.end())
+		{
+			// identical image data is already on the GPU, so only
+			// the tag needs to be associated with the loaded slot
+			AssignTextureSlot(pending.tag, cached->second);
+			m_textureCacheHits++;
+			m_textureCacheBytesSaved += m_textureIDs[cached->second].byteSize;
+
+			std::cout << "Reusing cached image:" << pending.filename << " for tag:" << pending.tag << std::endl;
+		}
+		else if (texture != uploaded.end())
+		{
+			// register the loaded texture and associate it with the special tag string
+			m_textureCache[job.contentHash] = RegisterTexture(texture->second, pending.tag);
+			if (texture->second.layer < 0)
+			{
+				m_textureResidency.Track(texture->second.ID, pending.filename);
+			}
+		}
+		else
+		{
+			std::cout << "Could not load image:" << pending.filename << std::endl;
+			bAllLoaded = false;
+		}
+	}
+
+	// upload the packed layers and point their slots at their arrays
+	if ((m_textureArray.GetLayerCount() > 0) && (m_textureArray.IsBuilt() == false))
+	{
+		if (m_textureArray.Build())
+		{
+			for (size_t i = 0; i < m_textureIDs.size(); i++)
+			{
+				if (m_textureIDs[i].layer >= 0)
+				{
+					m_textureIDs[i].ID = m_textureArray.GetTextureID(m_textureIDs[i].layer);
+					m_textureIDs[i].byteSize = m_textureArray.GetLayerBytes(m_textureIDs[i].layer);
+				}
+			}
+		}
+	}
+
+	m_pendingTextures.clear();
+	m_texturePool.Reset();
+
+	return(bAllLoaded);
+}
+
+/***********************************************************
+ *  RegisterTexture()
+ *
+ *  This method is used for adding a texture into the next
+ *  texture slot and associating it with the passed in tag.
+ *  The number of slots is not limited by the number of
+ *  texture units.  Returns the new slot.
+ ***********************************************************/
+int SceneManager::RegisterTexture(const TEXTURE_INFO& texture, std::string tag)
+{
+	int slot = (int)m_textureIDs.size();
+	m_textureIDs.push_back(texture);
+	m_textureIDs[slot].tag = tag;
+
+	AssignTextureSlot(tag, slot);
+
+	return(slot);
+}
+
+/***********************************************************
+ *  AssignTextureSlot()
+ *
+ *  This method is used for pointing the handle of a tag at
+ *  a texture slot.  A tag that is already registered keeps
+ *  its first texture.
+ ***********************************************************/
+void SceneManager::AssignTextureSlot(const std::string& tag, int slot)
+{
+	int tagHandle = m_tags.Intern(tag);
+	if (tagHandle >= (int)m_textureSlots.size())
+	{
+		m_textureSlots.resize(tagHandle + 1, -1);
+	}
+	if (m_textureSlots[tagHandle] == -1)
+	{
+		m_textureSlots[tagHandle] = slot;
+	}
+}
+
+/***********************************************************
+ *  UploadGLTexture()
+ *
+ *  This method is used for configuring the texture mapping
+ *  parameters in OpenGL, uploading decoded image data and
+ *  generating the mipmaps.  Baked containers are uploaded
+ *  with their stored mipmaps.  When an existing texture is
+ *  passed in, its image is replaced under the same name.
+ *  Returns 0 on failure.
+ ***********************************************************/
+GLuint SceneManager::UploadGLTexture(const TextureDecodePool::DECODE_JOB& job, GLuint existingID)
+{
+	GLuint textureID = existingID;
+
+	if (NULL != job.container)
+	{
+		if (textureID == 0)
+			glGenTextures(1, &textureID);
 		glBindTexture(GL_TEXTURE_2D, textureID);
 
 		// set the texture wrapping parameters
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+		// the container already holds the flipped mip chain
+		job.container->Upload();
+		TextureFormat::ApplySwizzle(GL_TEXTURE_2D, job.colorChannels);
+
+		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+
+		std::cout << "Successfully loaded baked image:" << job.filename << ", width:" << job.width << ", height:" << job.height << ", levels:" << job.container->GetHeader().levelCount
+			<< ", format:" << TextureFormat::GetInternalFormatName(job.container->GetHeader().internalFormat) << ", " << (job.container->GetTotalBytes() / 1024) << " KB" << std::endl;
+		return(textureID);
+	}
+
+	// gray, gray with alpha, RGB and RGBA formats are supported
+	if ((job.colorChannels < 1) || (job.colorChannels > 4))
+	{
+		std::cout << "Not implemented to handle image with " << job.colorChannels << " channels" << std::endl;
+		return(0);
+	}
+
+	if (textureID == 0)
+		glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// a replaced baked container may have limited the levels
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+
+	// grayscale textures are stored in one or two channels
+	GLenum internalFormat = TextureFormat::GetInternalFormat(job.colorChannels);
+	GLenum format = TextureFormat::GetFormat(job.colorChannels);
+	TextureFormat::ApplySwizzle(GL_TEXTURE_2D, job.colorChannels);
+
+	// the worker threads already built the mipmaps
+	if (NULL != job.mipChain)
+	{
+		job.mipChain->Upload(job.image, internalFormat, format);
+	}
+	else
+	{
+		// rows of R8 and RG8 images are not 4 byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, job.width, job.height, 0, format, GL_UNSIGNED_BYTE, job.image);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		// generate the texture mipmaps for mapping textures to lower resolutions
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+
+	// report the memory the packed format saves over the decoded channels
+	size_t textureBytes = ComputeTextureBytes(job.width, job.height, TextureFormat::GetBytesPerPixel(job.colorChannels));
+	size_t sourceBytes = ComputeTextureBytes(job.width, job.height, TextureFormat::GetBytesPerPixel(job.sourceChannels));
+	std::cout << "Successfully loaded image:" << job.filename << ", width:" << job.width << ", height:" << job.height << ", channels:" << job.sourceChannels
+		<< ", format:" << TextureFormat::GetName(job.colorChannels) << ", " << (textureBytes / 1024) << " KB";
+	if (sourceBytes > textureBytes)
+	{
+		std::cout << ", saved " << ((sourceBytes - textureBytes) / 1024) << " KB";
+	}
+	std::cout << std::endl;
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  AddToTextureArray()
+ *
+ *  This method is used for adding a decoded image, or the
+ *  top mip level of a baked container, to the texture
+ *  array.  Returns -1 if the image cannot be packed, in
+ *  which case it is uploaded as its own texture.
+ ***********************************************************/
+int SceneManager::AddToTextureArray(const TextureDecodePool::DECODE_JOB& job)
+{
+	if (NULL != job.container)
+	{
+		const TextureContainer::CONTAINER_HEADER& header = job.container->GetHeader();
+		if (header.type != GL_UNSIGNED_BYTE)
+		{
+			return(-1);
+		}
+		return(m_textureArray.AddImage(job.container->GetLevelData(0), header.width, header.height, job.colorChannels));
+	}
+
+	return(m_textureArray.AddImage(job.image, job.width, job.height, job.colorChannels));
+}
+
+/***********************************************************
+ *  EnableTextureStreaming()
+ *
+ *  This method is used for choosing whether textures are
+ *  streamed in the background.  It must be called before
+ *  the scene is prepared.
+ ***********************************************************/
+void SceneManager::EnableTextureStreaming(bool bEnable)
+{
+	m_bStreamTextures = bEnable;
+}
+
+/***********************************************************
+ *  SetTextureBackend()
+ *
+ *  This method is used for choosing how the loaded textures
+ *  are stored.  The array backend does not apply to
+ *  streamed textures.
+ ***********************************************************/
+void SceneManager::SetTextureBackend(TEXTURE_BACKEND backend)
+{
+	m_textureBackend = backend;
+}
+
+/***********************************************************
+ *  SetSamplerQuality()
+ *
+ *  This method is used for choosing the texture filtering
+ *  quality tier.  It can be changed at any time, the sampler
+ *  objects are updated in place.
+ ***********************************************************/
+void SceneManager::SetSamplerQuality(SamplerRegistry::SAMPLER_QUALITY quality)
+{
+	m_samplers.SetQuality(quality);
+}
+
+/***********************************************************
+ *  EnableCPUMipmaps()
+ *
+ *  This method is used for choosing whether the mipmaps are
+ *  built on the decode worker threads or by the driver with
+ *  glGenerateMipmap.  It must be called before the scene is
+ *  prepared.
+ ***********************************************************/
+void SceneManager::EnableCPUMipmaps(bool bEnable)
+{
+	m_bCPUMipmaps = bEnable;
+	// restored textures are built the same way as the originals
+	m_textureResidency.SetGenerateMipmaps(bEnable);
+}
+
+/***********************************************************
+ *  EnableTextureCompression()
+ *
+ *  This method is used for choosing whether the standalone
+ *  textures are block compressed on the decode threads.
+ *  The compressed mip chains are cached on disk, so only
+ *  the first run pays for the encoding.  It must be called
+ *  before the scene is prepared.
+ ***********************************************************/
+void SceneManager::EnableTextureCompression(bool bEnable)
+{
+	if (bEnable && (TextureCompressor::IsSupported() == false))
+	{
+		std::cout << "Texture compression is not supported by the driver" << std::endl;
+		bEnable = false;
+	}
+
+	m_compressionCache = bEnable ? g_CompressionCacheDirectory : "";
+	// restored textures are decoded again and must match the originals
+	m_textureResidency.SetCompressionCache(m_compressionCache);
+}
+
+/***********************************************************
+ *  EnableShaderVariants()
+ *
+ *  This method is used for drawing with shader variants
+ *  specialized for the draw state, compiled from the same
+ *  source files as the ShaderManager program the first
+ *  time a state is drawn.
+ ***********************************************************/
+void SceneManager::EnableShaderVariants(const char* vertexFilename, const char* fragmentFilename)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+	m_bShaderVariants = m_shaderVariants.LoadSource(vertexFilename, fragmentFilename, m_pShaderManager->m_programID);
+}
+
+/***********************************************************
+ *  EnableClusteredLights()
+ *
+ *  This method is used for shading the clustered point
+ *  lights.  Each fragment only loops over the lights whose
+ *  range reaches its cluster of the view frustum.
+ ***********************************************************/
+void SceneManager::EnableClusteredLights(const char* computeShaderFilename)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+	m_bClusteredLights = m_clusteredLights.Initialize(computeShaderFilename);
+	m_lightVariant.bClusteredLights = m_bClusteredLights;
+	m_pShaderManager->setBoolValue(g_UseClusteredLightsName.name, m_bClusteredLights);
+}
+
+/***********************************************************
+ *  EnableDeferredShading()
+ *
+ *  This method is used for rendering with deferred shading
+ *  instead of shading each draw as it is made.  The
+ *  geometry pass uses the vertex shader of the scene, so
+ *  the transformations are set up the same way.
+ ***********************************************************/
+void SceneManager::EnableDeferredShading(const char* geometryVertexFilename, const char* geometryFragmentFilename,
+	const char* lightingVertexFilename, const char* lightingFragmentFilename)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+	m_bDeferredShading = m_deferredRenderer.Initialize(geometryVertexFilename, geometryFragmentFilename,
+		lightingVertexFilename, lightingFragmentFilename);
+	m_bDeferredUniformsCopied = false;
+}
+
+/***********************************************************
+ *  EnableShadows()
+ *
+ *  This method is used for casting shadows from the
+ *  directional light and the point lights.  The shadow
+ *  maps are cached, and only rendered again when a light
+ *  or a caster moves.
+ ***********************************************************/
+void SceneManager::EnableShadows(const char* vertexFilename, const char* fragmentFilename)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+	m_bShadows = m_shadowMaps.Initialize(vertexFilename, fragmentFilename);
+	m_shadowMaps.SetSceneBounds(g_ShadowSceneMinimum, g_ShadowSceneMaximum);
+	m_lightVariant.bShadows = m_bShadows;
+	m_pShaderManager->setBoolValue(g_UseShadowsName.name, m_bShadows);
+}
+
+/***********************************************************
+ *  AddClusteredTestLights()
+ *
+ *  This method is used for scattering small colored point
+ *  lights over the counter, to try the clustered lighting
+ *  with many lights.  The same count always gives the same
+ *  lights.
+ ***********************************************************/
+void SceneManager::AddClusteredTestLights(int count)
+{
+	uint32_t seed = 12345;
+	for (int i = 0; i < count; i++)
+	{
+		float random[7];
+		for (int j = 0; j < 7; j++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			random[j] = (float)(seed >> 8) / (float)(1 << 24);
+		}
+		glm::vec3 position(-12.0f + 24.0f * random[0], 0.2f + 2.8f * random[1], -8.0f + 16.0f * random[2]);
+		glm::vec3 color(0.2f + 0.8f * random[3], 0.2f + 0.8f * random[4], 0.2f + 0.8f * random[5]);
+		m_clusteredLights.AddLight(position, color * 1.5f, 2.0f + 2.0f * random[6]);
+	}
+}
+
+/***********************************************************
+ *  SetTextureBudget()
+ *
+ *  This method is used for limiting the GPU memory used by
+ *  the standalone textures.  Over the budget, the top mip
+ *  levels of the least recently drawn textures are dropped.
+ ***********************************************************/
+void SceneManager::SetTextureBudget(size_t budgetBytes)
+{
+	m_textureResidency.SetBudget(budgetBytes);
+}
+
+/***********************************************************
+ *  StreamGLTexture()
+ *
+ *  This method is used for registering a tag into a texture
+ *  slot right away, bound to a 1x1 placeholder texture, and
+ *  queueing the image file on the background loader.
+ ***********************************************************/
+bool SceneManager::StreamGLTexture(const char* filename, std::string tag)
+{
+	if (NULL == m_pTextureStreamer)
+	{
+		m_pTextureStreamer = new TextureStreamer();
+		m_pTextureStreamer->SetGenerateMipmaps(m_bCPUMipmaps);
+		m_pTextureStreamer->SetCompressionCache(m_compressionCache);
+		if (m_pTextureStreamer->Start() == false)
+		{
+			// fall back to loading the textures before the first frame
+			delete m_pTextureStreamer;
+			m_pTextureStreamer = NULL;
+			m_bStreamTextures = false;
+			return(false);
+		}
+
+		const unsigned char placeholderPixel[4] = { 128, 128, 128, 255 };
+		glGenTextures(1, &m_placeholderTexture);
+		glBindTexture(GL_TEXTURE_2D, m_placeholderTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		// one level keeps it complete under the mipmapped samplers
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholderPixel);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// the same image file only needs to be streamed once
+	std::unordered_map<std::string, int>::iterator streamed = m_streamedFiles.find(filename);
+	if (streamed != m_streamedFiles.end())
+	{
+		AssignTextureSlot(tag, streamed->second);
+		m_textureCacheHits++;
+		return(true);
+	}
+
+	TEXTURE_INFO placeholder;
+	placeholder.ID = m_placeholderTexture;
+	placeholder.filename = filename;
+	placeholder.contentHash = 0;
+	placeholder.byteSize = 0;
+	placeholder.layer = -1;
+	int slot = RegisterTexture(placeholder, tag);
+
+	m_streamedFiles[filename] = slot;
+	m_pTextureStreamer->QueueTexture(filename, slot);
+
+	return(true);
+}
+
+/***********************************************************
+ *  UpdateStreamedTextures()
+ *
+ *  This method is used for replacing the placeholder of each
+ *  slot whose streamed texture is now resident on the GPU.
+ *  It never waits for the loader thread.
+ ***********************************************************/
+void SceneManager::UpdateStreamedTextures()
+{
+	if ((NULL == m_pTextureStreamer) || m_pTextureStreamer->IsIdle())
+	{
+		return;
+	}
+
+	TextureStreamer::STREAMED_TEXTURE texture;
+	while (m_pTextureStreamer->PollResidentTexture(texture))
+	{
+		if (texture.textureID == 0)
+		{
+			// the slot keeps the placeholder if the image failed to load
+			continue;
+		}
+
+		m_textureIDs[texture.slot].ID = texture.textureID;
+		m_textureIDs[texture.slot].contentHash = texture.contentHash;
+		m_textureIDs[texture.slot].byteSize = texture.byteSize;
+		if (m_textureCache.find(texture.contentHash) == m_textureCache.end())
+		{
+			m_textureCache[texture.contentHash] = texture.slot;
+		}
+		m_textureResidency.Track(texture.textureID, m_textureIDs[texture.slot].filename);
+
+		// bind so this context sees the texture uploaded by the loader
+		m_textureUnits.Bind(GL_TEXTURE_2D, texture.textureID);
+	}
+}
+
+/***********************************************************
+ *  UpdateTextureResidency()
+ *
+ *  This method is used once per frame for dropping mip
+ *  levels of textures while over the memory budget, and for
+ *  uploading the full size textures that were restored.
+ ***********************************************************/
+void SceneManager::UpdateTextureResidency()
+{
+	std::vector<TextureResidency::TEXTURE_REPLACEMENT> replaced;
+	m_textureResidency.EnforceBudget(replaced);
+	for (size_t i = 0; i < replaced.size(); i++)
+	{
+		ReplaceTextureID(replaced[i].oldID, replaced[i].newID);
+	}
+
+	GLuint reducedID = 0;
+	const TextureDecodePool::DECODE_JOB* job = m_textureResidency.PollRestoredImage(reducedID);
+	while (NULL != job)
+	{
+		GLuint textureID = UploadGLTexture(*job);
+		if (textureID != 0)
+		{
+			m_textureResidency.FinishRestore(reducedID, textureID);
+			ReplaceTextureID(reducedID, textureID);
+			// the upload changed the binding of the active unit
+			m_textureUnits.Reset();
+		}
+		job = m_textureResidency.PollRestoredImage(reducedID);
+	}
+}
+
+/***********************************************************
+ *  ReplaceTextureID()
+ *
+ *  This method is used for pointing every slot that uses a
+ *  texture at the texture replacing it, and for deleting
+ *  the old texture.
+ ***********************************************************/
+void SceneManager::ReplaceTextureID(GLuint oldID, GLuint newID)
+{
+	for (size_t i = 0; i < m_textureIDs.size(); i++)
+	{
+		if (m_textureIDs[i].ID == oldID)
+		{
+			m_textureIDs[i].ID = newID;
+		}
+	}
+	m_textureUnits.Invalidate(oldID);
+	glDeleteTextures(1, &oldID);
+}
+
+/***********************************************************
+ *  EnableTextureHotReload()
+ *
+ *  This method is used for starting to watch the directory
+ *  holding the texture images.  Each image file that is
+ *  changed afterwards is reloaded into its texture slot.
+ ***********************************************************/
+void SceneManager::EnableTextureHotReload(const char* directory)
+{
+	if (NULL == m_pTextureWatcher)
+	{
+		m_pTextureWatcher = new TextureWatcher();
+	}
+	if (m_pTextureWatcher->Start(directory) == false)
+	{
+		delete m_pTextureWatcher;
+		m_pTextureWatcher = NULL;
+	}
+}
+
+/***********************************************************
+ *  UpdateHotReloadedTextures()
+ *
+ *  This method is used once per frame for reloading the
+ *  textures whose image files changed.  Only the changed
+ *  images are decoded again.
+ ***********************************************************/
+void SceneManager::UpdateHotReloadedTextures()
+{
+	if (NULL == m_pTextureWatcher)
+	{
+		return;
+	}
+
+	std::string filename;
+	while (m_pTextureWatcher->PollChangedFile(filename))
+	{
+		for (size_t i = 0; i < m_textureIDs.size(); i++)
+		{
+			// textures still streaming in will load the new file anyway
+			if ((m_textureIDs[i].filename == filename) && (m_textureIDs[i].ID != m_placeholderTexture))
+			{
+				ReloadGLTexture((int)i);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  ReloadGLTexture()
+ *
+ *  This method is used for decoding the image file of a
+ *  slot again and uploading it in place, under the same
+ *  OpenGL texture name, so the tags and slots stay valid.
+ *  Textures packed into the texture array replace their
+ *  layer.  A texture reduced by the memory budget has
+ *  immutable storage and is replaced by a new texture.
+ ***********************************************************/
+bool SceneManager::ReloadGLTexture(int slot)
+{
+	TEXTURE_INFO& texture = m_textureIDs[slot];
+
+	m_texturePool.QueueImage(texture.filename.c_str());
+	int jobIndex = m_texturePool.WaitForFinishedImage();
+	const TextureDecodePool::DECODE_JOB& job = m_texturePool.GetJob(jobIndex);
+
+	bool bReloaded = false;
+	if ((NULL == job.image) && (NULL == job.container))
+	{
+		std::cout << "Could not reload image:" << texture.filename << std::endl;
+	}
+	else if (texture.layer >= 0)
+	{
+		const unsigned char* pixels = job.image;
+		int width = job.width;
+		int height = job.height;
+		if (NULL != job.container)
+		{
+			pixels = job.container->GetLevelData(0);
+			width = job.container->GetHeader().width;
+			height = job.container->GetHeader().height;
+		}
+		bReloaded = m_textureArray.UpdateImage(texture.layer, pixels, width, height, job.colorChannels);
+	}
+	else
+	{
+		GLint bImmutable = GL_FALSE;
+		glBindTexture(GL_TEXTURE_2D, texture.ID);
+		glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_FORMAT, &bImmutable);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		m_textureResidency.Untrack(texture.ID);
+		GLuint textureID = UploadGLTexture(job, (bImmutable == GL_TRUE) ? 0 : texture.ID);
+		if ((textureID != 0) && (textureID != texture.ID))
+		{
+			ReplaceTextureID(texture.ID, textureID);
+		}
+		m_textureResidency.Track(texture.ID, texture.filename);
+		bReloaded = (textureID != 0);
+
+		if (NULL != job.container)
+			texture.byteSize = job.container->GetTotalBytes();
 		else
+			texture.byteSize = ComputeTextureBytes(job.width, job.height, TextureFormat::GetBytesPerPixel(job.colorChannels));
+	}
+
+	if (bReloaded)
+	{
+		// later loads of the new contents share this slot
+		std::unordered_map<uint64_t, int>::iterator cached = m_textureCache.find(texture.contentHash);
+		if ((cached != m_textureCache.end()) && (cached->second == slot))
 		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
+			m_textureCache.erase(cached);
 		}
+		texture.contentHash = job.contentHash;
+		m_textureCache.insert(std::make_pair(job.contentHash, slot));
 
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
+		std::cout << "Reloaded texture:" << texture.filename << std::endl;
+	}
 
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+	m_texturePool.Reset();
+	// the upload changed the binding of the active unit
+	m_textureUnits.Reset();
+
+	return(bReloaded);
+}
+
+/***********************************************************
+ *  EnableLazyResources()
+ *
+ *  This method is used for choosing whether the textures and
+ *  meshes are created when they are first drawn instead of
+ *  in PrepareScene().  It must be called before the scene
+ *  is prepared.
+ ***********************************************************/
+void SceneManager::EnableLazyResources(bool bEnable)
+{
+	m_bLazyResources = bEnable;
+}
+
+/***********************************************************
+ *  AddPrewarmResource()
+ *
+ *  This method is used for naming a texture tag or a mesh
+ *  ("plane", "sphere", "cylinder", "torus", "box" or
+ *  "taperedCylinder") that is still loaded in PrepareScene()
+ *  in lazy mode, so its first draw does not hitch.
+ ***********************************************************/
+void SceneManager::AddPrewarmResource(const std::string& name)
+{
+	m_prewarmList.push_back(name);
+}
+
+/***********************************************************
+ *  IsPrewarmed()
+ *
+ *  This method is used for checking the prewarm list.
+ ***********************************************************/
+bool SceneManager::IsPrewarmed(const std::string& name) const
+{
+	return(std::find(m_prewarmList.begin(), m_prewarmList.end(), name) != m_prewarmList.end());
+}
+
+/***********************************************************
+ *  LoadDeferredTexture()
+ *
+ *  This method is used for loading a texture that was
+ *  deferred in lazy mode, the first time a draw uses its
+ *  tag.  Tags sharing an image file with a loaded texture
+ *  become aliases of it without decoding the file again.
+ ***********************************************************/
+bool SceneManager::LoadDeferredTexture(const std::string& tag)
+{
+	std::unordered_map<std::string, std::string>::iterator deferred = m_deferredTextures.find(tag);
+	if (deferred == m_deferredTextures.end())
+	{
+		return(false);
+	}
+	std::string filename = deferred->second;
+	m_deferredTextures.erase(deferred);
+
+	std::cout << "Loading texture on first use:" << filename << " for tag:" << tag << std::endl;
+	bool bLoaded = CreateGLTexture(filename.c_str(), tag);
+	// the upload changed the binding of the active unit
+	m_textureUnits.Reset();
 
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
+	return(bLoaded);
+}
 
-		return true;
+/***********************************************************
+ *  LoadMesh()
+ *
+ *  This method is used for loading a mesh the first time it
+ *  is needed.  Every draw goes through it, so in lazy mode
+ *  the meshes that are never drawn are never created.
+ ***********************************************************/
+void SceneManager::LoadMesh(MESH_TYPE mesh)
+{
+	if (m_meshLoaded[mesh] == false)
+	{
+		StartupTrace::Scope trace(std::string("LoadMesh ") + g_MeshNames[mesh], "mesh");
+		switch (mesh)
+		{
+		case MESH_PLANE:
+			m_basicMeshes->LoadPlaneMesh();
+			break;
+		case MESH_SPHERE:
+			// also serves the half sphere draws
+			m_basicMeshes->LoadSphereMesh();
+			break;
+		case MESH_CYLINDER:
+			m_basicMeshes->LoadCylinderMesh();
+			break;
+		case MESH_TORUS:
+			m_basicMeshes->LoadTorusMesh();
+			break;
+		case MESH_BOX:
+			m_basicMeshes->LoadBoxMesh();
+			break;
+		case MESH_TAPERED_CYLINDER:
+			m_basicMeshes->LoadTaperedCylinderMesh();
+			break;
+		default:
+			break;
+		}
+		m_meshLoaded[mesh] = true;
 	}
+}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+/***********************************************************
+ *  UseMesh()
+ *
+ *  This method is used for getting ready to draw a mesh.
+ *  The mesh is loaded on first use, and the draw state
+ *  collected by the SetShader methods is set into the
+ *  shader program selected for it, along with the point
+ *  lights that reach the mesh.  Returns false when the draw
+ *  is skipped - in the deferred passes the draws of the
+ *  other pass are skipped, and the shadow pass only draws
+ *  the casters of the view it renders.
+ ***********************************************************/
+bool SceneManager::UseMesh(MESH_TYPE mesh)
+{
+	// only untextured draws set a color with transparency
+	bool bTransparent = (m_drawState.bUseTexture == false) && (m_drawState.objectColor.a < 1.0f);
+	if (m_renderPass == RENDER_PASS_SHADOW)
+	{
+		// transparent draws cast no shadow, and a point light's view
+		// skips the casters its range does not reach
+		if (bTransparent || (m_shadowCaster != m_shadowPassCaster) ||
+			((m_shadowPassLight >= 0) && ((GetPointLightMask(mesh) & (1 << m_shadowPassLight)) == 0)))
+		{
+			return(false);
+		}
+		LoadMesh(mesh);
+		ApplyDrawState();
+		return(true);
+	}
+	// the G-buffer only holds the opaque draws, the transparent ones
+	// are drawn over the lit G-buffer
+	if ((m_renderPass == RENDER_PASS_GEOMETRY) && bTransparent)
+	{
+		return(false);
+	}
+	if ((m_renderPass == RENDER_PASS_TRANSPARENT) && (bTransparent == false))
+	{
+		return(false);
+	}
 
-	// Error loading the image
-	return false;
+	LoadMesh(mesh);
+	m_drawState.pointLightMask = GetPointLightMask(mesh);
+	if (m_bShadows && (bTransparent == false))
+	{
+		m_shadowMaps.TrackCaster(m_shadowCaster, mesh, m_drawState.model, m_drawState.pointLightMask);
+	}
+	ApplyDrawState();
+	return(true);
+}
+
+/***********************************************************
+ *  GetPointLightMask()
+ *
+ *  This method is used for testing the bounding sphere of
+ *  a mesh, placed by the model matrix of the draw state,
+ *  against the range of each point light.  The fragment
+ *  shader skips the lights whose bit is clear, so objects
+ *  far from a light do not pay for it.
+ ***********************************************************/
+int SceneManager::GetPointLightMask(MESH_TYPE mesh) const
+{
+	const glm::mat4& model = m_drawState.model;
+	glm::vec3 center = glm::vec3(model[3]);
+	// the largest scale of the model matrix bounds the rotated mesh
+	float scale = std::max(glm::length(glm::vec3(model[0])),
+		std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	float radius = g_MeshBoundingRadius[mesh] * scale;
+
+	const LightBuffer::LIGHT_BLOCK& lights = m_lightBuffer.GetData();
+	int mask = 0;
+	for (int i = 0; i < LightBuffer::MAX_POINT_LIGHTS; i++)
+	{
+		const LightBuffer::POINT_LIGHT_DATA& light = lights.pointLights[i];
+		if ((light.bActive != 0) && (glm::distance(center, light.position) < light.range + radius))
+		{
+			mask |= (1 << i);
+		}
+	}
+	return(mask);
 }
 
 /***********************************************************
  *  BindGLTextures()
  *
  *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  OpenGL texture units.  The last unit is reserved for the
+ *  texture array, the ones below it for the clustered light
+ *  buffers, the shadow maps and the G-buffer, the others
+ *  are handed out on demand by the texture unit cache, so
+ *  any number of textures can be loaded.  The textures that
+ *  fit are bound up front.
  ***********************************************************/
 void SceneManager::BindGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	GLint maxTextureUnits = 16;
+	glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxTextureUnits);
+	m_textureArrayUnit = maxTextureUnits - 1;
+	m_clusterTextureUnit = m_textureArrayUnit - ClusteredLights::TEXTURE_UNIT_COUNT;
+	m_shadowTextureUnit = m_clusterTextureUnit - ShadowMaps::TEXTURE_UNIT_COUNT;
+	// the G-buffer only takes units when it is used
+	m_deferredTextureUnit = m_shadowTextureUnit - (m_bDeferredShading ? DeferredRenderer::TEXTURE_UNIT_COUNT : 0);
+	m_textureUnits.Initialize(0, m_deferredTextureUnit);
+	m_samplers.ResetBindings();
+
+	for (size_t i = 0; i < m_textureIDs.size(); i++)
+	{
+		if ((m_textureIDs[i].layer >= 0) || ((int)i >= m_textureUnits.GetUnitCount()))
+		{
+			continue;
+		}
+		m_textureUnits.Bind(GL_TEXTURE_2D, m_textureIDs[i].ID);
+	}
+
+	// the array sampler always needs its own unit, two samplers
+	// of different types cannot share a texture unit; the array
+	// of each draw is bound there by SetShaderTexture()
+	glActiveTexture(GL_TEXTURE0 + m_textureArrayUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	m_boundTextureArray = 0;
+	m_drawState.textureArrayUnit = m_textureArrayUnit;
+
+	// the buffer samplers get their units even when the clusters are
+	// not used, for the same reason
+	if (NULL != m_pShaderManager)
 	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		ClusteredLights::SetSamplerUnits(m_pShaderManager->m_programID, m_clusterTextureUnit);
+		ShadowMaps::SetSamplerUnits(m_pShaderManager->m_programID, m_shadowTextureUnit);
+	}
+	if (m_clusteredLights.IsInitialized())
+	{
+		m_clusteredLights.Bind(m_clusterTextureUnit);
+	}
+	if (m_shadowMaps.IsInitialized())
+	{
+		m_shadowMaps.Bind(m_shadowTextureUnit);
+	}
+	if (m_bDeferredShading)
+	{
+		m_deferredRenderer.SetTextureUnits(m_deferredTextureUnit);
 	}
 }
 
@@ -147,62 +1236,111 @@ void SceneManager::BindGLTextures()
  ***********************************************************/
 void SceneManager::DestroyGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	for (size_t i = 0; i < m_textureIDs.size(); i++)
 	{
-		glGenTextures(1, &m_textureIDs[i].ID);
+		if ((m_textureIDs[i].ID != m_placeholderTexture) && (m_textureIDs[i].layer < 0))
+		{
+			glDeleteTextures(1, &m_textureIDs[i].ID);
+		}
 	}
+	if (m_placeholderTexture != 0)
+	{
+		glDeleteTextures(1, &m_placeholderTexture);
+		m_placeholderTexture = 0;
+	}
+	m_textureIDs.clear();
+	// the tag handles stay valid for the materials and the scene
+	std::fill(m_textureSlots.begin(), m_textureSlots.end(), -1);
+	m_textureUnits.Reset();
+	m_textureResidency.Reset();
+	m_currentTextureUnit = -1;
+	m_samplers.Destroy();
+	m_textureCache.clear();
+	m_streamedFiles.clear();
+	m_textureArray.Destroy();
+	m_boundTextureArray = 0;
 }
 
 /***********************************************************
  *  FindTextureID()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for getting an ID for the previously
+ *  loaded texture bitmap associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureID(const std::string& tag)
+{
+	int textureID = -1;
+
+	int textureSlot = FindTextureSlot(tag);
+	if (textureSlot >= 0)
+	{
+		textureID = m_textureIDs[textureSlot].ID;
+	}
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  FindTextureSlot()
+ *
+ *  This method is used for getting a slot index for the previously
+ *  loaded texture bitmap associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureSlot(const std::string& tag)
+{
+	return(FindTextureSlot(m_tags.Find(tag)));
+}
+
+/***********************************************************
+ *  FindTextureSlot()
+ *
+ *  This method is used for getting the slot index of the
+ *  texture associated with a tag handle.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+int SceneManager::FindTextureSlot(int tagHandle) const
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	if ((tagHandle < 0) || (tagHandle >= (int)m_textureSlots.size()))
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
-		}
-		else
-			index++;
+		return(-1);
 	}
-
-	return(textureID);
+	return(m_textureSlots[tagHandle]);
 }
 
 /***********************************************************
- *  FindTextureSlot()
+ *  RegisterMaterials()
  *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for indexing the defined materials
+ *  by the handles of their tags.  When two materials share
+ *  a tag, the first one defined is used.  All materials are
+ *  uploaded into the material buffer at the same index as
+ *  in m_objectMaterials.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+void SceneManager::RegisterMaterials()
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	m_materialBuffer.Destroy();
+	for (size_t index = 0; index < m_objectMaterials.size(); index++)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
+		m_materialBuffer.AddMaterial(
+			m_objectMaterials[index].diffuseColor,
+			m_objectMaterials[index].specularColor,
+			m_objectMaterials[index].shininess);
+
+		int tagHandle = m_tags.Intern(m_objectMaterials[index].tag);
+		if (tagHandle >= (int)m_materialIndices.size())
 		{
-			textureSlot = index;
-			bFound = true;
+			m_materialIndices.resize(tagHandle + 1, -1);
+		}
+		if (m_materialIndices[tagHandle] == -1)
+		{
+			m_materialIndices[tagHandle] = (int)index;
 		}
-		else
-			index++;
 	}
 
-	return(textureSlot);
+	if (NULL != m_pShaderManager)
+	{
+		m_materialBuffer.Upload(m_pShaderManager->m_programID);
+		m_deferredRenderer.SetMaterialBuffer(m_materialBuffer.GetBufferID());
+	}
 }
 
 /***********************************************************
@@ -211,31 +1349,24 @@ int SceneManager::FindTextureSlot(std::string tag)
  *  This method is used for getting a material from the previously
  *  defined materials list that is associated with the passed in tag.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+const SceneManager::OBJECT_MATERIAL* SceneManager::FindMaterial(const std::string& tag) const
 {
-	if (m_objectMaterials.size() == 0)
-	{
-		return(false);
-	}
+	return(FindMaterial(m_tags.Find(tag)));
+}
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
+/***********************************************************
+ *  FindMaterial()
+ *
+ *  This method is used for getting the defined material
+ *  associated with a tag handle.
+ ***********************************************************/
+const SceneManager::OBJECT_MATERIAL* SceneManager::FindMaterial(int tagHandle) const
+{
+	if ((tagHandle < 0) || (tagHandle >= (int)m_materialIndices.size()) || (m_materialIndices[tagHandle] < 0))
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
-		{
-			bFound = true;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
-		}
-		else
-		{
-			index++;
-		}
+		return(NULL);
 	}
-
-	return(true);
+	return(&m_objectMaterials[m_materialIndices[tagHandle]]);
 }
 
 /***********************************************************
@@ -270,10 +1401,7 @@ void SceneManager::SetTransformations(
 
 	modelView = translation * rotationZ * rotationY * rotationX * scale;
 
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
-	}
+	m_drawState.model = modelView;
 }
 
 /***********************************************************
@@ -296,29 +1424,88 @@ void SceneManager::SetShaderColor(
 	currentColor.b = blueColorValue;
 	currentColor.a = alphaValue;
 
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
-	}
+	m_drawState.bUseTexture = false;
+	m_drawState.objectColor = currentColor;
+	// a material for this draw has no texture to sample
+	m_currentTextureUnit = -1;
+}
+
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data
+ *  associated with the passed in tag into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+	const std::string& textureTag)
+{
+	SetShaderTexture(m_tags.Find(textureTag));
 }
 
 /***********************************************************
  *  SetShaderTexture()
  *
  *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
+ *  associated with the passed in tag handle into the shader.
+ *  Textures in the texture arrays are selected by layer, so
+ *  the sampler uniforms do not change between draws, and
+ *  only a draw from another array rebinds the array unit.
+ *  The default sampler is bound until a material replaces
+ *  it.
  ***********************************************************/
 void SceneManager::SetShaderTexture(
-	std::string textureTag)
+	int textureTagHandle)
 {
 	if (NULL != m_pShaderManager)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
+		m_drawState.bUseTexture = true;
 
 		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+		textureID = FindTextureSlot(textureTagHandle);
+		if ((textureID < 0) && (textureTagHandle >= 0) && LoadDeferredTexture(m_tags.GetName(textureTagHandle)))
+		{
+			textureID = FindTextureSlot(textureTagHandle);
+		}
+		if ((textureID >= 0) && (m_textureIDs[textureID].layer >= 0))
+		{
+			m_drawState.bUseTextureArray = true;
+			m_drawState.textureLayer = m_textureArray.GetArrayLayer(m_textureIDs[textureID].layer);
+			m_currentTextureUnit = m_textureArrayUnit;
+
+			// images of other sizes and formats are in other arrays
+			if (m_textureIDs[textureID].ID != m_boundTextureArray)
+			{
+				glActiveTexture(GL_TEXTURE0 + m_textureArrayUnit);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureIDs[textureID].ID);
+				m_boundTextureArray = m_textureIDs[textureID].ID;
+			}
+		}
+		else
+		{
+			m_drawState.bUseTextureArray = false;
+
+			// a texture already resident on a unit is not bound again,
+			// and the sampler only changes when the unit changes
+			int textureUnit = -1;
+			if (textureID >= 0)
+			{
+				textureUnit = m_textureUnits.Bind(GL_TEXTURE_2D, m_textureIDs[textureID].ID);
+				m_textureResidency.Touch(m_textureIDs[textureID].ID);
+			}
+			m_drawState.textureUnit = textureUnit;
+			m_currentTextureUnit = textureUnit;
+
+			// without a unit the sampler would read whatever texture
+			// the last draw left bound, so draw the object color
+			if (textureUnit < 0)
+			{
+				m_drawState.bUseTexture = false;
+				return;
+			}
+		}
+
+		// the material set after the texture may replace the sampler
+		m_samplers.Bind(m_currentTextureUnit, m_samplers.GetSampler(SamplerRegistry::DefaultState()));
 	}
 }
 
@@ -330,33 +1517,42 @@ void SceneManager::SetShaderTexture(
  ***********************************************************/
 void SceneManager::SetTextureUVScale(float u, float v)
 {
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
-	}
+	m_drawState.UVscale = glm::vec2(u, v);
 }
 
 /***********************************************************
  *  SetShaderMaterial()
  *
  *  This method is used for passing the material values
- *  into the shader.
+ *  associated with the passed in tag into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	const std::string& materialTag)
+{
+	SetShaderMaterial(m_tags.Find(materialTag));
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for selecting the material in the
+ *  material buffer for the next draw, and for binding the
+ *  sampler of the material to the unit of the current
+ *  texture.
  ***********************************************************/
 void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+	int materialTagHandle)
 {
-	if (m_objectMaterials.size() > 0)
+	if ((materialTagHandle < 0) || (materialTagHandle >= (int)m_materialIndices.size()) || (m_materialIndices[materialTagHandle] < 0))
 	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
+		return;
+	}
 
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
-		{
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
-		}
+	m_drawState.materialIndex = m_materialIndices[materialTagHandle];
+	// an untextured draw has no unit for the sampler
+	if (m_currentTextureUnit >= 0)
+	{
+		m_samplers.Bind(m_currentTextureUnit, m_samplers.GetSampler(m_objectMaterials[m_materialIndices[materialTagHandle]].sampler));
 	}
 }
 
@@ -374,42 +1570,62 @@ void SceneManager::SetShaderMaterial(
 ***************************************************************/
 void SceneManager::LoadSceneTextures()
 {
+	StartupTrace::Scope trace("LoadSceneTextures", "scene");
+
 	bool bReturn = false;
-	// get textures
-	bReturn = CreateGLTexture(
+	// queue textures - the image files are decoded in parallel
+	QueueGLTexture(
 		"textures/black_marble.jpg", "box"
 	);
-	bReturn = CreateGLTexture(
+	QueueGLTexture(
 		"textures/cement.jpg", "potBody"
 	);
-	bReturn = CreateGLTexture(
+	QueueGLTexture(
 		"textures/cement.jpg", "potRim"
 	);
-	bReturn = CreateGLTexture(
+	QueueGLTexture(
 		"textures/cement.jpg", "potSphereBottom"
 	);
-	bReturn = CreateGLTexture(
+	QueueGLTexture(
 		"textures/dirt.jpg", "potDirt"
 	);
-	bReturn = CreateGLTexture(
+	QueueGLTexture(
 		"textures/bricks_white_seamless.jpg", "backsplash"
 	);
-	bReturn = CreateGLTexture(
+	QueueGLTexture(
 		"textures/marble_light_seamless.jpg", "counter"
 	);
-	bReturn = CreateGLTexture(
+	QueueGLTexture(
 		"textures/green_texture.jpg", "stem"
 	);
-	bReturn = CreateGLTexture(
+	QueueGLTexture(
 		"textures/green_texture.jpg", "leaf"
 	);
-	bReturn = CreateGLTexture(
+	QueueGLTexture(
 		"textures/metal.jpg", "metal"
 	);
-	bReturn = CreateGLTexture(
+	QueueGLTexture(
 		"textures/plastic_dark_seamless.png", "plastic"
 	);
 
+	// upload the decoded textures and register their tags
+	bReturn = FinishGLTextures();
+
+	if (m_deferredTextures.size() > 0)
+	{
+		std::cout << "Lazy resources: " << m_deferredTextures.size() << " textures deferred until first use" << std::endl;
+	}
+
+	// report how much work the texture cache saved
+	std::cout << "Texture cache: " << m_textureCacheHits << " decodes/uploads saved, "
+		<< (m_textureCacheBytesSaved / 1024) << " KB of texture memory not allocated" << std::endl;
+	std::cout << "Texture memory: " << (m_textureResidency.GetResidentBytes() / 1024) << " KB resident";
+	if (m_textureResidency.GetBudget() > 0)
+	{
+		std::cout << ", budget " << (m_textureResidency.GetBudget() / 1024) << " KB";
+	}
+	std::cout << std::endl;
+
 	// after the texture image data is loaded into memory
 	// the loaded textures need to be bound to texture slots
 	// there are a total of 16 available slots
@@ -423,6 +1639,8 @@ void SceneManager::LoadSceneTextures()
 ************************************************************/
 void SceneManager::DefineObjectMaterials()
 {
+	StartupTrace::Scope trace("DefineObjectMaterials", "scene");
+
 	// for plant pot
 	OBJECT_MATERIAL cementMaterial;
 	cementMaterial.diffuseColor = glm::vec3(0.5f, 0.5f, 0.5f);
@@ -438,6 +1656,7 @@ void SceneManager::DefineObjectMaterials()
 	tileMaterial.specularColor = glm::vec3(0.4f, 0.5f, 0.6f);
 	tileMaterial.shininess = 25.0;
 	tileMaterial.tag = "tile";
+	tileMaterial.sampler.anisotropy = 8.0f;
 
 	m_objectMaterials.push_back(tileMaterial);
 
@@ -447,6 +1666,8 @@ void SceneManager::DefineObjectMaterials()
 	marbleMaterial.specularColor = glm::vec3(0.3f, 0.4f, 0.4f);
 	marbleMaterial.shininess = 28.0;
 	marbleMaterial.tag = "marble";
+	// the countertop is seen at grazing angles
+	marbleMaterial.sampler.anisotropy = 8.0f;
 
 	m_objectMaterials.push_back(marbleMaterial);
 
@@ -495,40 +1716,420 @@ void SceneManager::DefineObjectMaterials()
 ************************************************************/
 void SceneManager::SetupSceneLights()
 {
+	StartupTrace::Scope trace("SetupSceneLights", "scene");
+
 	// this line of code is needed for telling the shaders
 	// to render the 3D scene with custom lighting
 	// to use default, comment next line out
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+	m_pShaderManager->setBoolValue(g_UseLightingName.name, true);
 
 	// directional light to emulate sunlight
-	m_pShaderManager->setVec3Value("directionalLight.direction", 1.0f, 1.0f, 1.0f);
-	m_pShaderManager->setVec3Value("directionalLight.ambient", 0.52f, 0.56f, 0.5f);
-	m_pShaderManager->setVec3Value("directionalLight.diffuse", 0.6f, 0.6f, 0.6f);
-	m_pShaderManager->setVec3Value("directionalLight.specular", 0.0f, 0.0f, 0.0f);
-	m_pShaderManager->setBoolValue("directionalLight.bActive", true);
+	m_lightBuffer.SetDirectionalLight(
+		glm::vec3(1.0f, 1.0f, 1.0f),
+		glm::vec3(0.52f, 0.56f, 0.5f),
+		glm::vec3(0.6f, 0.6f, 0.6f),
+		glm::vec3(0.0f, 0.0f, 0.0f));
+
+	// the point lights fall off with the square of the distance and
+	// have their colors about as far away as the counter below them
 
 	// point light 1
-	m_pShaderManager->setVec3Value("pointLights[0].position", -4.0f, 8.0f, 0.0f);
-	m_pShaderManager->setVec3Value("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[0].diffuse", 0.3f, 0.3f, 0.3f);
-	m_pShaderManager->setVec3Value("pointLights[0].specular", 0.1f, 0.1f, 0.1f);
-	m_pShaderManager->setBoolValue("pointLights[0].bActive", true);
+	m_lightBuffer.SetPointLight(0,
+		glm::vec3(-4.0f, 8.0f, 0.0f),
+		glm::vec3(0.05f, 0.05f, 0.05f),
+		glm::vec3(0.3f, 0.3f, 0.3f),
+		glm::vec3(0.1f, 0.1f, 0.1f),
+		64.0f, 20.0f);
 
 	// point light 2
-	m_pShaderManager->setVec3Value("pointLights[1].position", 4.0f, 8.0f, 0.0f);
-	m_pShaderManager->setVec3Value("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[1].diffuse", 0.3f, 0.3f, 0.3f);
-	m_pShaderManager->setVec3Value("pointLights[1].specular", 0.1f, 0.1f, 0.1f);
-	m_pShaderManager->setBoolValue("pointLights[1].bActive", true);
+	m_lightBuffer.SetPointLight(1,
+		glm::vec3(4.0f, 8.0f, 0.0f),
+		glm::vec3(0.05f, 0.05f, 0.05f),
+		glm::vec3(0.3f, 0.3f, 0.3f),
+		glm::vec3(0.1f, 0.1f, 0.1f),
+		64.0f, 20.0f);
 
 	// point light 3
-	m_pShaderManager->setVec3Value("pointLights[2].position", 3.8f, 5.5f, 4.0f);
-	m_pShaderManager->setVec3Value("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[2].diffuse", 0.2f, 0.2f, 0.2f);
-	m_pShaderManager->setVec3Value("pointLights[2].specular", 0.8f, 0.8f, 0.8f);
-	m_pShaderManager->setBoolValue("pointLights[2].bActive", true);
+	m_lightBuffer.SetPointLight(2,
+		glm::vec3(3.8f, 5.5f, 4.0f),
+		glm::vec3(0.05f, 0.05f, 0.05f),
+		glm::vec3(0.2f, 0.2f, 0.2f),
+		glm::vec3(0.8f, 0.8f, 0.8f),
+		30.0f, 12.0f);
+
+	// the light block is shared by every shader program, later
+	// changes to the lights are uploaded by RenderScene()
+	m_lightBuffer.Upload(m_pShaderManager->m_programID);
+}
+/***********************************************************
+ *  ResolveSceneTags()
+ *
+ *  This method is used for getting the handles of the tags
+ *  used by RenderScene().  The tags are interned before any
+ *  texture or material is registered under them, and find
+ *  their texture and material once those are registered.
+ ***********************************************************/
+void SceneManager::ResolveSceneTags()
+{
+	m_sceneTags.counterTexture = m_tags.Intern("counter");
+	m_sceneTags.backsplashTexture = m_tags.Intern("backsplash");
+	m_sceneTags.boxTexture = m_tags.Intern("box");
+	m_sceneTags.potSphereBottomTexture = m_tags.Intern("potSphereBottom");
+	m_sceneTags.potDirtTexture = m_tags.Intern("potDirt");
+	m_sceneTags.potBodyTexture = m_tags.Intern("potBody");
+	m_sceneTags.potRimTexture = m_tags.Intern("potRim");
+	m_sceneTags.stemTexture = m_tags.Intern("stem");
+	m_sceneTags.leafTexture = m_tags.Intern("leaf");
+	m_sceneTags.metalTexture = m_tags.Intern("metal");
+	m_sceneTags.plasticTexture = m_tags.Intern("plastic");
+	m_sceneTags.marbleMaterial = m_tags.Intern("marble");
+	m_sceneTags.tileMaterial = m_tags.Intern("tile");
+	m_sceneTags.cementMaterial = m_tags.Intern("cement");
+	m_sceneTags.dirtMaterial = m_tags.Intern("dirt");
+	m_sceneTags.metalMaterial = m_tags.Intern("metal");
+	m_sceneTags.glassMaterial = m_tags.Intern("glass");
+	m_sceneTags.plasticMaterial = m_tags.Intern("plastic");
+}
+
+/***********************************************************
+ *  ClearUniforms()
+ *
+ *  This method is used for setting every uniform location
+ *  to -1, which OpenGL ignores, so a program that is not
+ *  resolved never writes to location 0 by accident.
+ ***********************************************************/
+void SceneManager::ClearUniforms(SCENE_UNIFORMS& locations)
+{
+	locations.model = -1;
+	locations.objectColor = -1;
+	locations.objectTexture = -1;
+	locations.bUseTexture = -1;
+	locations.objectTextureArray = -1;
+	locations.objectTextureLayer = -1;
+	locations.bUseTextureArray = -1;
+	locations.UVscale = -1;
+	locations.materialIndex = -1;
+	locations.pointLightMask = -1;
+	locations.view = -1;
+	locations.projection = -1;
+	locations.viewPosition = -1;
+	locations.clusterTileSize = -1;
+	locations.clusterDepthParams = -1;
+	locations.directionalShadowMatrix = -1;
+	locations.pointShadowMask = -1;
+}
+
+/***********************************************************
+ *  ResolveUniforms()
+ *
+ *  This method is used for reading the uniform locations
+ *  of a shader program once, so the draw code sets the
+ *  uniforms by location instead of by name.  Only the
+ *  ShaderManager program must have every uniform, the
+ *  shader variants drop the ones they do not need.
+ ***********************************************************/
+void SceneManager::ResolveUniforms(GLuint programID, SCENE_UNIFORMS& locations)
+{
+	ClearUniforms(locations);
+
+	UniformCache uniforms;
+	if (uniforms.Resolve(programID) == false)
+	{
+		return;
+	}
+	bool bRequired = (NULL != m_pShaderManager) && (programID == m_pShaderManager->m_programID);
+
+	locations.model = uniforms.GetLocation(g_ModelName, bRequired);
+	locations.objectColor = uniforms.GetLocation(g_ColorValueName, bRequired);
+	locations.objectTexture = uniforms.GetLocation(g_TextureValueName, bRequired);
+	locations.bUseTexture = uniforms.GetLocation(g_UseTextureName, bRequired);
+	locations.objectTextureArray = uniforms.GetLocation(g_TextureArrayValueName, bRequired);
+	locations.objectTextureLayer = uniforms.GetLocation(g_TextureLayerName, bRequired);
+	locations.bUseTextureArray = uniforms.GetLocation(g_UseTextureArrayName, bRequired);
+	locations.UVscale = uniforms.GetLocation(g_UVScaleName, bRequired);
+	locations.materialIndex = uniforms.GetLocation(g_MaterialIndexName, bRequired);
+	locations.pointLightMask = uniforms.GetLocation(g_PointLightMaskName, bRequired);
+	locations.view = uniforms.GetLocation(g_ViewName, false);
+	locations.projection = uniforms.GetLocation(g_ProjectionName, false);
+	locations.viewPosition = uniforms.GetLocation(g_ViewPositionName, false);
+	locations.clusterTileSize = uniforms.GetLocation(g_ClusterTileSizeName, false);
+	locations.clusterDepthParams = uniforms.GetLocation(g_ClusterDepthParamsName, false);
+	locations.directionalShadowMatrix = uniforms.GetLocation(g_DirectionalShadowMatrixName, false);
+	locations.pointShadowMask = uniforms.GetLocation(g_PointShadowMaskName, false);
+}
+
+/***********************************************************
+ *  GetShaderProgram()
+ *
+ *  This method is used for getting the draw bookkeeping of
+ *  a shader program, created the first time it is used.
+ ***********************************************************/
+SceneManager::SHADER_PROGRAM& SceneManager::GetShaderProgram(GLuint programID)
+{
+	std::unordered_map<GLuint, SHADER_PROGRAM>::iterator found = m_shaderPrograms.find(programID);
+	if (found != m_shaderPrograms.end())
+	{
+		return(found->second);
+	}
+
+	SHADER_PROGRAM& program = m_shaderPrograms[programID];
+	ResolveUniforms(programID, program.locations);
+	program.applied = m_drawState;
+	program.bApplied = false;
+	program.frame = -1;
+	return(program);
+}
+
+/***********************************************************
+ *  ReadLightState()
+ *
+ *  This method is used for reading which lights are turned
+ *  on, to pick the shader variants.  Lighting is read back
+ *  from the ShaderManager program and the lights from the
+ *  light buffer.  The variants assume the active point
+ *  lights come first, otherwise lit draws keep using the
+ *  ShaderManager program.
+ ***********************************************************/
+void SceneManager::ReadLightState()
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+	GLuint programID = m_pShaderManager->m_programID;
+	UniformCache uniforms;
+	uniforms.Resolve(programID);
+
+	GLint value = 0;
+	GLint location = uniforms.GetLocation(g_UseLightingName);
+	m_lightVariant.bLit = false;
+	if (location >= 0)
+	{
+		glGetUniformiv(programID, location, &value);
+		m_lightVariant.bLit = (value != 0);
+	}
+
+	const LightBuffer::LIGHT_BLOCK& lights = m_lightBuffer.GetData();
+	m_lightVariant.bDirectionalLight = (lights.directionalLight.bActive != 0);
+	m_lightVariant.bSpotLight = (lights.spotLight.bActive != 0);
+
+	m_lightVariant.pointLights = 0;
+	m_bVariantLights = true;
+	for (int i = 0; i < LightBuffer::MAX_POINT_LIGHTS; i++)
+	{
+		bool bActive = (lights.pointLights[i].bActive != 0);
+		if (bActive && (m_lightVariant.pointLights == i))
+		{
+			m_lightVariant.pointLights++;
+		}
+		else if (bActive)
+		{
+			m_bVariantLights = false;
+		}
+	}
+}
+
+/***********************************************************
+ *  ApplyDrawState()
+ *
+ *  This method is used for selecting the shader program
+ *  for the next draw and setting the uniforms that changed
+ *  since the program was last drawn with.  With shader
+ *  variants, the program depends on whether the draw is
+ *  textured and on the lights of the scene.
+ ***********************************************************/
+void SceneManager::ApplyDrawState()
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+
+	GLuint programID = m_pShaderManager->m_programID;
+	// the G-buffer is filled without lighting, so one program serves
+	// every draw of the geometry pass
+	if (m_renderPass == RENDER_PASS_GEOMETRY)
+	{
+		programID = m_deferredRenderer.GetGeometryProgram();
+	}
+	// the shadow casters only need their transformation
+	else if (m_renderPass == RENDER_PASS_SHADOW)
+	{
+		programID = m_shadowMaps.GetProgram();
+	}
+	else if (m_bShaderVariants && (m_bVariantLights || (m_lightVariant.bLit == false)))
+	{
+		ShaderVariants::VARIANT variant = m_lightVariant;
+		variant.bTextured = m_drawState.bUseTexture;
+		programID = m_shaderVariants.GetProgram(variant);
+	}
+
+	SHADER_PROGRAM& program = GetShaderProgram(programID);
+	if (programID != m_currentProgram)
+	{
+		glUseProgram(programID);
+		m_currentProgram = programID;
+	}
+	// the shadow views are set by the shadow maps
+	if (m_renderPass != RENDER_PASS_SHADOW)
+	{
+		ApplyFrameState(program);
+	}
+
+	const DRAW_STATE& state = m_drawState;
+	DRAW_STATE& applied = program.applied;
+	const SCENE_UNIFORMS& locations = program.locations;
+	bool bAll = (program.bApplied == false);
+
+	if (bAll || (state.model != applied.model))
+		UniformCache::SetMat4(locations.model, state.model);
+	if (bAll || (state.objectColor != applied.objectColor))
+		UniformCache::SetVec4(locations.objectColor, state.objectColor);
+	if (bAll || (state.UVscale != applied.UVscale))
+		UniformCache::SetVec2(locations.UVscale, state.UVscale);
+	if (bAll || (state.bUseTexture != applied.bUseTexture))
+		UniformCache::SetBool(locations.bUseTexture, state.bUseTexture);
+	if (bAll || (state.bUseTextureArray != applied.bUseTextureArray))
+		UniformCache::SetBool(locations.bUseTextureArray, state.bUseTextureArray);
+	if (bAll || (state.textureLayer != applied.textureLayer))
+		UniformCache::SetInt(locations.objectTextureLayer, state.textureLayer);
+	if (bAll || (state.textureArrayUnit != applied.textureArrayUnit))
+		UniformCache::SetInt(locations.objectTextureArray, state.textureArrayUnit);
+	// the G-buffer stores the index in the whole material buffer,
+	// the forward programs read the page bound for the material
+	int materialIndex = state.materialIndex;
+	if ((m_renderPass != RENDER_PASS_GEOMETRY) && (m_renderPass != RENDER_PASS_SHADOW))
+		materialIndex = m_materialBuffer.Bind(materialIndex);
+	if (bAll || (state.materialIndex != applied.materialIndex))
+		UniformCache::SetInt(locations.materialIndex, materialIndex);
+	if (bAll || (state.pointLightMask != applied.pointLightMask))
+		UniformCache::SetInt(locations.pointLightMask, state.pointLightMask);
+	// draws without a texture leave the sampler on its last unit
+	int textureUnit = applied.textureUnit;
+	if ((state.textureUnit >= 0) && (bAll || (state.textureUnit != applied.textureUnit)))
+	{
+		UniformCache::SetInt(locations.objectTexture, state.textureUnit);
+		textureUnit = state.textureUnit;
+	}
+
+	applied = state;
+	applied.textureUnit = textureUnit;
+	program.bApplied = true;
+}
+
+/***********************************************************
+ *  UpdateClusteredLights()
+ *
+ *  This method is used for building the clustered light
+ *  lists for the view and projection that were set into the
+ *  ShaderManager program for this frame.
+ ***********************************************************/
+void SceneManager::UpdateClusteredLights()
+{
+	if ((m_bClusteredLights == false) || (NULL == m_pShaderManager))
+	{
+		return;
+	}
+
+	glm::mat4 view(1.0f);
+	glm::mat4 projection(1.0f);
+	ReadViewMatrices(view, projection);
+	GLint viewport[4] = { 0, 0, 1, 1 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	m_clusteredLights.Update(view, projection, viewport[2], viewport[3]);
+	// the compute shader was put in use to build the lists
+	if (m_clusteredLights.GetAssignment() == ClusteredLights::ASSIGNMENT_COMPUTE)
+	{
+		glUseProgram(m_currentProgram);
+	}
+}
+
+/***********************************************************
+ *  ReadViewMatrices()
+ *
+ *  This method is used for reading back the view and
+ *  projection the ViewManager set into the ShaderManager
+ *  program for this frame.
+ ***********************************************************/
+void SceneManager::ReadViewMatrices(glm::mat4& view, glm::mat4& projection)
+{
+	GLuint programID = m_pShaderManager->m_programID;
+	const SCENE_UNIFORMS& locations = GetShaderProgram(programID).locations;
+	if (locations.view >= 0)
+	{
+		glGetUniformfv(programID, locations.view, glm::value_ptr(view));
+	}
+	if (locations.projection >= 0)
+	{
+		glGetUniformfv(programID, locations.projection, glm::value_ptr(projection));
+	}
+}
+
+/***********************************************************
+ *  ReadFrameState()
+ *
+ *  This method is used for collecting the per frame
+ *  uniforms once.  The view is read back from the
+ *  ShaderManager program, where the ViewManager set it, by
+ *  its resolved locations.  The cluster and shadow values
+ *  come from the clustered lights and the shadow maps.
+ ***********************************************************/
+void SceneManager::ReadFrameState()
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+
+	GLuint programID = m_pShaderManager->m_programID;
+	const SCENE_UNIFORMS& locations = GetShaderProgram(programID).locations;
+	FRAME_STATE& state = m_frameState;
+	if (locations.view >= 0)
+		glGetUniformfv(programID, locations.view, glm::value_ptr(state.view));
+	if (locations.projection >= 0)
+		glGetUniformfv(programID, locations.projection, glm::value_ptr(state.projection));
+	if (locations.viewPosition >= 0)
+		glGetUniformfv(programID, locations.viewPosition, glm::value_ptr(state.viewPosition));
+	if (m_bClusteredLights)
+	{
+		state.clusterTileSize = m_clusteredLights.GetTileSize();
+		state.clusterDepthParams = m_clusteredLights.GetDepthParams();
+	}
+	if (m_bShadows)
+	{
+		state.directionalShadowMatrix = m_shadowMaps.GetDirectionalShadowMatrix();
+		state.pointShadowMask = m_shadowMaps.GetPointShadowMask();
+	}
+}
 
+/***********************************************************
+ *  ApplyFrameState()
+ *
+ *  This method is used for setting the per frame uniforms
+ *  into the program in use by their resolved locations.  A
+ *  program is only set up once per frame, at its first
+ *  draw.
+ ***********************************************************/
+void SceneManager::ApplyFrameState(SHADER_PROGRAM& program)
+{
+	if (program.frame == m_frame)
+	{
+		return;
+	}
+
+	const FRAME_STATE& state = m_frameState;
+	const SCENE_UNIFORMS& locations = program.locations;
+	UniformCache::SetMat4(locations.view, state.view);
+	UniformCache::SetMat4(locations.projection, state.projection);
+	UniformCache::SetVec3(locations.viewPosition, state.viewPosition);
+	UniformCache::SetVec2(locations.clusterTileSize, state.clusterTileSize);
+	UniformCache::SetVec2(locations.clusterDepthParams, state.clusterDepthParams);
+	UniformCache::SetMat4(locations.directionalShadowMatrix, state.directionalShadowMatrix);
+	UniformCache::SetInt(locations.pointShadowMask, state.pointShadowMask);
+	program.frame = m_frame;
 }
+
 /***********************************************************
  *  PrepareScene()
  *
@@ -538,24 +2139,30 @@ void SceneManager::SetupSceneLights()
  ***********************************************************/
 void SceneManager::PrepareScene()
 {
+	// in lazy mode only the prewarmed textures are loaded here, the
+	// array backend packs every texture up front so it stays eager
+	m_bDeferTextures = m_bLazyResources && (m_textureBackend == TEXTURE_BACKEND_UNITS);
 	// load texture files into scene
 	LoadSceneTextures();
+	m_bDeferTextures = false;
 	// load materials
 	DefineObjectMaterials();
+	RegisterMaterials();
 	// load lights
 	SetupSceneLights();
+	ReadLightState();
 
 	// only one instance of a particular mesh needs to be
 	// loaded in memory no matter how many times it is drawn
-	// in the rendered 3D scene
-
-	m_basicMeshes->LoadPlaneMesh();
-	// load shapes for scene
-	m_basicMeshes->LoadSphereMesh();
-	m_basicMeshes->LoadCylinderMesh();
-	m_basicMeshes->LoadTorusMesh();
-	m_basicMeshes->LoadBoxMesh();
-	m_basicMeshes->LoadTaperedCylinderMesh();
+	// in the rendered 3D scene, and in lazy mode it is only
+	// loaded here when it is prewarmed
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		if ((m_bLazyResources == false) || IsPrewarmed(g_MeshNames[i]))
+		{
+			LoadMesh((MESH_TYPE)i);
+		}
+	}
 }
 
 /***********************************************************
@@ -566,6 +2173,164 @@ void SceneManager::PrepareScene()
  ***********************************************************/
 void SceneManager::RenderScene()
 {
+	// the shader variants pick up the new view at their first draw
+	m_frame++;
+	// pick up any textures that finished streaming in
+	UpdateStreamedTextures();
+	// drop or restore texture mip levels to stay within the budget
+	UpdateTextureResidency();
+	// reload the textures whose image files were changed
+	UpdateHotReloadedTextures();
+	// upload the lights if they were changed since the last frame,
+	// a light turned on or off selects other shader variants
+	if (m_lightBuffer.Update())
+	{
+		ReadLightState();
+	}
+	// list the clustered lights reaching each cluster of the new view
+	UpdateClusteredLights();
+	// render the shadow maps whose light or casters changed
+	UpdateShadowMaps();
+	// collect the uniforms every program is set up with
+	ReadFrameState();
+
+	if (m_bDeferredShading)
+	{
+		RenderDeferred();
+	}
+	else
+	{
+		DrawSceneObjects();
+	}
+	// the casters drawn this frame decide which maps are rendered
+	// at the next frame
+	if (m_bShadows)
+	{
+		m_shadowMaps.EndFrame();
+	}
+
+	// the view of the next frame is set into the ShaderManager program
+	if ((NULL != m_pShaderManager) && (m_currentProgram != m_pShaderManager->m_programID))
+	{
+		glUseProgram(m_pShaderManager->m_programID);
+		m_currentProgram = m_pShaderManager->m_programID;
+	}
+}
+
+/***********************************************************
+ *  RenderDeferred()
+ *
+ *  This method is used for rendering the scene with
+ *  deferred shading.  The opaque draws fill the G-buffer,
+ *  the lighting pass shades it into the window, and the
+ *  transparent draws are then drawn forward and blended
+ *  over the result, as the G-buffer holds only the closest
+ *  surface.  The scene is walked once for each of the two
+ *  draw passes, and UseMesh() skips the draws that do not
+ *  belong to the pass.
+ ***********************************************************/
+void SceneManager::RenderDeferred()
+{
+	GLuint baseProgram = m_pShaderManager->m_programID;
+	GLuint lightingProgram = m_deferredRenderer.GetLightingProgram();
+	// the material and light block bindings, the lighting switch and
+	// the clustered light samplers are set up by PrepareScene()
+	if (m_bDeferredUniformsCopied == false)
+	{
+		ShaderVariants::CopyUniforms(baseProgram, m_deferredRenderer.GetGeometryProgram());
+		ShaderVariants::CopyUniforms(baseProgram, lightingProgram);
+		m_currentProgram = lightingProgram;
+		m_bDeferredUniformsCopied = true;
+	}
+
+	if (m_deferredRenderer.BeginGeometryPass() == false)
+	{
+		DrawSceneObjects();
+		return;
+	}
+	m_renderPass = RENDER_PASS_GEOMETRY;
+	DrawSceneObjects();
+
+	glUseProgram(lightingProgram);
+	m_currentProgram = lightingProgram;
+	ApplyFrameState(GetShaderProgram(lightingProgram));
+	m_deferredRenderer.LightingPass(m_lightBuffer.GetData(), m_frameState.view, m_frameState.projection);
+
+	m_renderPass = RENDER_PASS_TRANSPARENT;
+	DrawSceneObjects();
+	m_renderPass = RENDER_PASS_FORWARD;
+}
+
+/***********************************************************
+ *  UpdateShadowMaps()
+ *
+ *  This method is used for rendering the shadow maps whose
+ *  light or casters changed since they were last rendered.
+ *  For each view of a map, the scene is walked once for
+ *  the static layer and once for the dynamic casters drawn
+ *  over it, and UseMesh() skips the other draws.  Without
+ *  changes nothing is drawn.
+ ***********************************************************/
+void SceneManager::UpdateShadowMaps()
+{
+	if ((m_bShadows == false) || (NULL == m_pShaderManager))
+	{
+		return;
+	}
+
+	m_shadowMaps.UpdateLights(m_lightBuffer.GetData());
+	if (m_shadowMaps.NeedsUpdate())
+	{
+		m_shadowMaps.BeginUpdate();
+		m_renderPass = RENDER_PASS_SHADOW;
+		for (int layer = 0; layer < ShadowMaps::LAYER_COUNT; layer++)
+		{
+			m_shadowPassCaster = (layer == ShadowMaps::LAYER_STATIC) ? ShadowMaps::CASTER_STATIC : ShadowMaps::CASTER_DYNAMIC;
+			for (int view = 0; view < ShadowMaps::VIEW_COUNT; view++)
+			{
+				if (m_shadowMaps.BeginView((ShadowMaps::LAYER)layer, view) == false)
+				{
+					continue;
+				}
+				// the depth program was put in use with the view
+				m_currentProgram = m_shadowMaps.GetProgram();
+				// without dynamic casters the final layer is a copy of
+				// the static layer
+				if ((layer == ShadowMaps::LAYER_STATIC) || m_shadowMaps.HasDynamicCasters())
+				{
+					m_shadowPassLight = ShadowMaps::GetViewPointLight(view);
+					DrawSceneObjects();
+				}
+			}
+		}
+		m_renderPass = RENDER_PASS_FORWARD;
+		m_shadowMaps.EndUpdate();
+	}
+}
+
+/***********************************************************
+ *  SetShadowCaster()
+ *
+ *  This method is used for setting how the following draws
+ *  cast shadows.
+ ***********************************************************/
+void SceneManager::SetShadowCaster(ShadowMaps::CASTER caster)
+{
+	m_shadowCaster = caster;
+}
+
+/***********************************************************
+ *  DrawSceneObjects()
+ *
+ *  This method is used for transforming and drawing the
+ *  basic 3D shapes of the scene.
+ ***********************************************************/
+void SceneManager::DrawSceneObjects()
+{
+	// the counter, backsplash, pot, plant and clock do not move, their
+	// shadows are kept in the cached static layer
+	SetShadowCaster(ShadowMaps::CASTER_STATIC);
+
 	// declare the variables for the transformations
 	glm::vec3 scaleXYZ;
 	float XrotationDegrees = 0.0f;
@@ -597,10 +2362,11 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	//SetShaderColor(1, 1, 1, 1);
-	SetShaderTexture("counter");
-	SetShaderMaterial("marble");
+	SetShaderTexture(m_sceneTags.counterTexture);
+	SetShaderMaterial(m_sceneTags.marbleMaterial);
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
+	if (UseMesh(MESH_PLANE))
+		m_basicMeshes->DrawPlaneMesh();
 	/****************************************************************/
 	// backdrop/background plane for the kitchen tile/wall
 	scaleXYZ = glm::vec3(20.0f, 1.0f, 10.0f);
@@ -622,10 +2388,11 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	//SetShaderColor(1, 1, 1, 1);
-	SetShaderTexture("backsplash");
-	SetShaderMaterial("tile");
+	SetShaderTexture(m_sceneTags.backsplashTexture);
+	SetShaderMaterial(m_sceneTags.tileMaterial);
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
+	if (UseMesh(MESH_PLANE))
+		m_basicMeshes->DrawPlaneMesh();
 
 	/******************************************************************************/
 
@@ -650,10 +2417,11 @@ void SceneManager::RenderScene()
 
 	//SetShaderColor(0, 0, 0, 1);
 	// set texture
-	SetShaderTexture("box");
-	SetShaderMaterial("marble");
+	SetShaderTexture(m_sceneTags.boxTexture);
+	SetShaderMaterial(m_sceneTags.marbleMaterial);
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
+	if (UseMesh(MESH_BOX))
+		m_basicMeshes->DrawBoxMesh();
 
 	/*****************************************************************/
 	// render a half-sphere for the bottom of the pot?
@@ -676,10 +2444,11 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	//SetShaderColor(0.9, 0.9, 0.9, 1);
-	SetShaderTexture("potSphereBottom");
-	SetShaderMaterial("cement");
+	SetShaderTexture(m_sceneTags.potSphereBottomTexture);
+	SetShaderMaterial(m_sceneTags.cementMaterial);
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawSphereMesh();
+	if (UseMesh(MESH_SPHERE))
+		m_basicMeshes->DrawSphereMesh();
 
 	/*****************************************************************/
 	// render a cylinder for the body of the pot
@@ -702,14 +2471,16 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	//SetShaderColor(0.9, 0.9, 0.9, 1);
-	SetShaderTexture("potDirt");
-	SetShaderMaterial("dirt");
-	m_basicMeshes->DrawCylinderMesh(true,false, false);
+	SetShaderTexture(m_sceneTags.potDirtTexture);
+	SetShaderMaterial(m_sceneTags.dirtMaterial);
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh(true,false, false);
 	// set texture
-	SetShaderTexture("potBody");
-	SetShaderMaterial("cement");
+	SetShaderTexture(m_sceneTags.potBodyTexture);
+	SetShaderMaterial(m_sceneTags.cementMaterial);
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh(false,true,true);
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh(false,true,true);
 
 	/*****************************************************************/
 	// render a torus for the rim
@@ -734,10 +2505,11 @@ void SceneManager::RenderScene()
 
 	//SetShaderColor(0.9, 0.9, 0.9, 1);
 	//set texture
-	SetShaderTexture("potRim");
-	SetShaderMaterial("cement");
+	SetShaderTexture(m_sceneTags.potRimTexture);
+	SetShaderMaterial(m_sceneTags.cementMaterial);
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	if (UseMesh(MESH_TORUS))
+		m_basicMeshes->DrawTorusMesh();
 
 	/*****************************************************************/
 	// render a cylinder for a plant stem
@@ -759,10 +2531,11 @@ void SceneManager::RenderScene()
 		ZrotationDegrees,
 		positionXYZ);
 
-	SetShaderTexture("stem");
+	SetShaderTexture(m_sceneTags.stemTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh();
 
 	/***********************************************************************/
 
@@ -786,10 +2559,11 @@ void SceneManager::RenderScene()
 		ZrotationDegrees,
 		positionXYZ);
 	// Add texture for stem
-	SetShaderTexture("stem");
+	SetShaderTexture(m_sceneTags.stemTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh();
 
 	/***********************************************************************/
 
@@ -813,10 +2587,11 @@ void SceneManager::RenderScene()
 		ZrotationDegrees,
 		positionXYZ);
 	// Add texture for stem
-	SetShaderTexture("stem");
+	SetShaderTexture(m_sceneTags.stemTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh();
 
 	/****************************************************************************/
 
@@ -841,10 +2616,11 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	// add texture for stem
-	SetShaderTexture("stem");
+	SetShaderTexture(m_sceneTags.stemTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh();
 
 	/************************************************************/
 	// render a cylinder for a plant stem
@@ -868,10 +2644,11 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	// add texture for stem
-	SetShaderTexture("stem");
+	SetShaderTexture(m_sceneTags.stemTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh();
 
 	/***************************************************************/
 	// render a half sphere for a leaf
@@ -895,10 +2672,11 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	// add texture for leaf
-	SetShaderTexture("leaf");
+	SetShaderTexture(m_sceneTags.leafTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawHalfSphereMesh();
+	if (UseMesh(MESH_SPHERE))
+		m_basicMeshes->DrawHalfSphereMesh();
 
 	/************************************************************/
 	/***************************************************************/
@@ -922,10 +2700,11 @@ void SceneManager::RenderScene()
 		ZrotationDegrees,
 		positionXYZ);
 
-	SetShaderTexture("leaf");
+	SetShaderTexture(m_sceneTags.leafTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawHalfSphereMesh();
+	if (UseMesh(MESH_SPHERE))
+		m_basicMeshes->DrawHalfSphereMesh();
 
 	/***************************************************************/
 	// render a half sphere for a leaf
@@ -948,10 +2727,11 @@ void SceneManager::RenderScene()
 		ZrotationDegrees,
 		positionXYZ);
 
-	SetShaderTexture("leaf");
+	SetShaderTexture(m_sceneTags.leafTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawHalfSphereMesh();
+	if (UseMesh(MESH_SPHERE))
+		m_basicMeshes->DrawHalfSphereMesh();
 
 	/***************************************************************/
 	// render a half sphere for a leaf
@@ -975,10 +2755,11 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	// set shader texture
-	SetShaderTexture("leaf");
+	SetShaderTexture(m_sceneTags.leafTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawHalfSphereMesh();
+	if (UseMesh(MESH_SPHERE))
+		m_basicMeshes->DrawHalfSphereMesh();
 
 	/***************************************************************/
 	// render a half sphere for a leaf
@@ -1002,10 +2783,11 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	// set shader texture
-	SetShaderTexture("leaf");
+	SetShaderTexture(m_sceneTags.leafTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawHalfSphereMesh();
+	if (UseMesh(MESH_SPHERE))
+		m_basicMeshes->DrawHalfSphereMesh();
 	/***************************************************************/
 	// render a half sphere for a leaf
 	scaleXYZ = glm::vec3(0.3f, 0.05f, 0.1f);
@@ -1029,10 +2811,11 @@ void SceneManager::RenderScene()
 
 	// set texture
 	//SetShaderColor(0.4, 0.4, 0.3, 1);
-	SetShaderTexture("leaf");
+	SetShaderTexture(m_sceneTags.leafTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawHalfSphereMesh();
+	if (UseMesh(MESH_SPHERE))
+		m_basicMeshes->DrawHalfSphereMesh();
 
 	/************************************************************/
 	// render a half sphere for a leaf
@@ -1057,10 +2840,11 @@ void SceneManager::RenderScene()
 
 	// set texture
 	//SetShaderColor(0.4, 0.4, 0.3, 1);
-	SetShaderTexture("leaf");
+	SetShaderTexture(m_sceneTags.leafTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawHalfSphereMesh();
+	if (UseMesh(MESH_SPHERE))
+		m_basicMeshes->DrawHalfSphereMesh();
 	/************************************************************/
 	// render a half sphere for a leaf
 	scaleXYZ = glm::vec3(0.2f, 0.05f, 0.1f);
@@ -1084,10 +2868,11 @@ void SceneManager::RenderScene()
 
 	// set texture
 	//SetShaderColor(0.4, 0.4, 0.3, 1);
-	SetShaderTexture("leaf");
+	SetShaderTexture(m_sceneTags.leafTexture);
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawHalfSphereMesh();
+	if (UseMesh(MESH_SPHERE))
+		m_basicMeshes->DrawHalfSphereMesh();
 	/************************************************************/
 	// render a box for the clock
 	scaleXYZ = glm::vec3(3.0f, 3.0f, 3.0f);
@@ -1110,25 +2895,30 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	// draw the back
-	SetShaderTexture("plastic");
-	SetShaderMaterial("plastic");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::back);
+	SetShaderTexture(m_sceneTags.plasticTexture);
+	SetShaderMaterial(m_sceneTags.plasticMaterial);
+	if (UseMesh(MESH_BOX))
+		m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::back);
 	// draw the top
-	SetShaderTexture("plastic");
-	SetShaderMaterial("plastic");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::top);
+	SetShaderTexture(m_sceneTags.plasticTexture);
+	SetShaderMaterial(m_sceneTags.plasticMaterial);
+	if (UseMesh(MESH_BOX))
+		m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::top);
 	// draw the bottom
-	SetShaderTexture("plastic");
-	SetShaderMaterial("plastic");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::bottom);
+	SetShaderTexture(m_sceneTags.plasticTexture);
+	SetShaderMaterial(m_sceneTags.plasticMaterial);
+	if (UseMesh(MESH_BOX))
+		m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::bottom);
 	// draw the left side
-	SetShaderTexture("plastic");
-	SetShaderMaterial("plastic");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::left);
+	SetShaderTexture(m_sceneTags.plasticTexture);
+	SetShaderMaterial(m_sceneTags.plasticMaterial);
+	if (UseMesh(MESH_BOX))
+		m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::left);
 	// draw the right side of box
-	SetShaderTexture("plastic");
-	SetShaderMaterial("plastic");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::right);
+	SetShaderTexture(m_sceneTags.plasticTexture);
+	SetShaderMaterial(m_sceneTags.plasticMaterial);
+	if (UseMesh(MESH_BOX))
+		m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::right);
 	
 	/*************************************************************/
 	// render a box for the clock
@@ -1152,13 +2942,15 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	SetShaderColor(1, 1, 1, 1);
-	SetShaderMaterial("plastic");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::front);
+	SetShaderMaterial(m_sceneTags.plasticMaterial);
+	if (UseMesh(MESH_BOX))
+		m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::front);
 
-	SetShaderTexture("plastic");
-	SetShaderMaterial("plastic");
+	SetShaderTexture(m_sceneTags.plasticTexture);
+	SetShaderMaterial(m_sceneTags.plasticMaterial);
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
+	if (UseMesh(MESH_BOX))
+		m_basicMeshes->DrawBoxMesh();
 	/**********************************************************/
 	// render a half sphere for the clock
 	scaleXYZ = glm::vec3(0.2f, 0.1f, 0.2f);
@@ -1180,8 +2972,9 @@ void SceneManager::RenderScene()
 		ZrotationDegrees,
 		positionXYZ);
 
-	SetShaderTexture("plastic");
-	m_basicMeshes->DrawHalfSphereMesh();
+	SetShaderTexture(m_sceneTags.plasticTexture);
+	if (UseMesh(MESH_SPHERE))
+		m_basicMeshes->DrawHalfSphereMesh();
 	/*************************************************************/
 	// render a cylinder for the clock
 	scaleXYZ = glm::vec3(0.05f, 1.2f, 0.05f);
@@ -1203,8 +2996,9 @@ void SceneManager::RenderScene()
 		ZrotationDegrees,
 		positionXYZ);
 
-	SetShaderTexture("plastic");
-	m_basicMeshes->DrawCylinderMesh();
+	SetShaderTexture(m_sceneTags.plasticTexture);
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh();
 
 	/*************************************************************/
 	// render a cylinder for the clock
@@ -1227,9 +3021,16 @@ void SceneManager::RenderScene()
 		ZrotationDegrees,
 		positionXYZ);
 
-	SetShaderTexture("plastic");
-	m_basicMeshes->DrawCylinderMesh();
+	SetShaderTexture(m_sceneTags.plasticTexture);
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh();
 	/*************************************************************/
+	// the salt shakers are the dynamic casters - nothing moves
+	// them yet, but their shadows are drawn over the cached
+	// static layer, so moving them would not render the counter
+	// and the rest of the static casters again
+	SetShadowCaster(ShadowMaps::CASTER_DYNAMIC);
+
 	// render a cylinder for the salt shaker
 	scaleXYZ = glm::vec3(0.5f, 1.0f, 0.5f);
 
@@ -1251,8 +3052,9 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	SetShaderColor(1, 1, 1, 0.3);
-	SetShaderMaterial("glass");
-	m_basicMeshes->DrawCylinderMesh();
+	SetShaderMaterial(m_sceneTags.glassMaterial);
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh();
 
 	/*************************************************************/
 	// render a tapered cylinder for the salt shaker
@@ -1276,8 +3078,9 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	SetShaderColor(1, 1, 1, 0.3);
-	SetShaderMaterial("glass");
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	SetShaderMaterial(m_sceneTags.glassMaterial);
+	if (UseMesh(MESH_TAPERED_CYLINDER))
+		m_basicMeshes->DrawTaperedCylinderMesh();
 
 	/*************************************************************/
 	// render a cylinder for the top of salt shaker
@@ -1301,9 +3104,10 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	// SetShaderColor(0.2, 0.2, 0.2, 1);
-	SetShaderTexture("metal");
-	SetShaderMaterial("metal");
-	m_basicMeshes->DrawCylinderMesh();
+	SetShaderTexture(m_sceneTags.metalTexture);
+	SetShaderMaterial(m_sceneTags.metalMaterial);
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh();
 
 	/*************************************************************/
 	// render a half sphere for the top of salt shaker
@@ -1327,9 +3131,10 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	// SetShaderColor(0.2, 0.2, 0.2, 1);
-	SetShaderTexture("metal");
-	SetShaderMaterial("metal");
-	m_basicMeshes->DrawHalfSphereMesh();
+	SetShaderTexture(m_sceneTags.metalTexture);
+	SetShaderMaterial(m_sceneTags.metalMaterial);
+	if (UseMesh(MESH_SPHERE))
+		m_basicMeshes->DrawHalfSphereMesh();
 
 	/*************************************************************/
 	// render a cylinder for the salt shaker
@@ -1353,8 +3158,9 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	SetShaderColor(1, 1, 1, 0.3);
-	SetShaderMaterial("glass");
-	m_basicMeshes->DrawCylinderMesh();
+	SetShaderMaterial(m_sceneTags.glassMaterial);
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh();
 
 	/*************************************************************/
 	// render a tapered cylinder for the salt shaker
@@ -1378,8 +3184,9 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	SetShaderColor(1, 1, 1, 0.3);
-	SetShaderMaterial("glass");
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	SetShaderMaterial(m_sceneTags.glassMaterial);
+	if (UseMesh(MESH_TAPERED_CYLINDER))
+		m_basicMeshes->DrawTaperedCylinderMesh();
 
 	/*************************************************************/
 	// render a cylinder for the top of salt shaker
@@ -1403,9 +3210,10 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	// SetShaderColor(0.2, 0.2, 0.2, 1);
-	SetShaderTexture("metal");
-	SetShaderMaterial("metal");
-	m_basicMeshes->DrawCylinderMesh();
+	SetShaderTexture(m_sceneTags.metalTexture);
+	SetShaderMaterial(m_sceneTags.metalMaterial);
+	if (UseMesh(MESH_CYLINDER))
+		m_basicMeshes->DrawCylinderMesh();
 
 	/*************************************************************/
 	// render a half sphere for the top of salt shaker
@@ -1429,7 +3237,8 @@ void SceneManager::RenderScene()
 		positionXYZ);
 
 	// SetShaderColor(0.2, 0.2, 0.2, 1);
-	SetShaderTexture("metal");
-	SetShaderMaterial("metal");
-	m_basicMeshes->DrawHalfSphereMesh();
+	SetShaderTexture(m_sceneTags.metalTexture);
+	SetShaderMaterial(m_sceneTags.metalMaterial);
+	if (UseMesh(MESH_SPHERE))
+		m_basicMeshes->DrawHalfSphereMesh();
 }
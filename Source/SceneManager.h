@@ -11,9 +11,26 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "TextureDecodePool.h"
+#include "TextureStreamer.h"
+#include "TextureArray.h"
+#include "TextureUnitCache.h"
+#include "SamplerRegistry.h"
+#include "TextureResidency.h"
+#include "TextureWatcher.h"
+#include "TagTable.h"
+#include "MaterialBuffer.h"
+#include "LightBuffer.h"
+#include "ClusteredLights.h"
+#include "DeferredRenderer.h"
+#include "ShadowMaps.h"
+#include "UniformCache.h"
+#include "ShaderVariants.h"
 
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <cstdint>
 
 /***********************************************************
  *  SceneManager
@@ -33,6 +50,140 @@ public:
 	{
 		std::string tag;
 		uint32_t ID;
+		// image file the texture was loaded from
+		std::string filename;
+		// hash of the image file contents the texture was created from
+		uint64_t contentHash;
+		// GPU memory used by the texture, including its mipmaps
+		size_t byteSize;
+		// layer handle in the texture arrays, or -1 for a standalone texture
+		int layer;
+	};
+
+	// how loaded textures are stored and bound for drawing
+	enum TEXTURE_BACKEND
+	{
+		// one texture object per image, one texture unit per slot
+		TEXTURE_BACKEND_UNITS,
+		// images packed into the layers of one array texture
+		TEXTURE_BACKEND_ARRAY
+	};
+
+	// shape meshes used by the scene, loaded eagerly or on first use
+	enum MESH_TYPE
+	{
+		MESH_PLANE,
+		MESH_SPHERE,
+		MESH_CYLINDER,
+		MESH_TORUS,
+		MESH_BOX,
+		MESH_TAPERED_CYLINDER,
+		MESH_COUNT
+	};
+
+	// handles of the tags drawn by RenderScene(), resolved once
+	// up front so drawing does not look up strings
+	struct SCENE_TAGS
+	{
+		int counterTexture;
+		int backsplashTexture;
+		int boxTexture;
+		int potSphereBottomTexture;
+		int potDirtTexture;
+		int potBodyTexture;
+		int potRimTexture;
+		int stemTexture;
+		int leafTexture;
+		int metalTexture;
+		int plasticTexture;
+		int marbleMaterial;
+		int tileMaterial;
+		int cementMaterial;
+		int dirtMaterial;
+		int metalMaterial;
+		int glassMaterial;
+		int plasticMaterial;
+	};
+
+	// locations of the uniforms set by the draw code, resolved
+	// once for each shader program
+	struct SCENE_UNIFORMS
+	{
+		GLint model;
+		GLint objectColor;
+		GLint objectTexture;
+		GLint bUseTexture;
+		GLint objectTextureArray;
+		GLint objectTextureLayer;
+		GLint bUseTextureArray;
+		GLint UVscale;
+		GLint materialIndex;
+		GLint pointLightMask;
+		// per frame uniforms, set from the FRAME_STATE once per
+		// frame
+		GLint view;
+		GLint projection;
+		GLint viewPosition;
+		GLint clusterTileSize;
+		GLint clusterDepthParams;
+		GLint directionalShadowMatrix;
+		GLint pointShadowMask;
+	};
+
+	// values of the per frame uniforms, read once per frame and
+	// set into every other program drawing the frame
+	struct FRAME_STATE
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec3 viewPosition;
+		glm::vec2 clusterTileSize;
+		glm::vec2 clusterDepthParams;
+		glm::mat4 directionalShadowMatrix;
+		int pointShadowMask;
+	};
+
+	// uniform values of the next draw, collected by the SetShader
+	// methods and set into the selected program by UseMesh()
+	struct DRAW_STATE
+	{
+		glm::mat4 model;
+		glm::vec4 objectColor;
+		glm::vec2 UVscale;
+		bool bUseTexture;
+		bool bUseTextureArray;
+		int textureLayer;
+		int textureUnit;
+		int textureArrayUnit;
+		// index in the whole material buffer
+		int materialIndex;
+		// bit i is set when point light i reaches the object
+		int pointLightMask;
+	};
+
+	// a shader program used for drawing and the values last set
+	// into its uniforms, so unchanged uniforms are not set again
+	struct SHADER_PROGRAM
+	{
+		SCENE_UNIFORMS locations;
+		DRAW_STATE applied;
+		// false until the first draw with the program
+		bool bApplied;
+		// frame the view uniforms were last copied in
+		int frame;
+	};
+
+	// which draws of the scene are made, and where they go
+	enum RENDER_PASS
+	{
+		// every draw, shaded as it is drawn
+		RENDER_PASS_FORWARD,
+		// the opaque draws, into the G-buffer
+		RENDER_PASS_GEOMETRY,
+		// the transparent draws, shaded over the lit G-buffer
+		RENDER_PASS_TRANSPARENT,
+		// the shadow casters, into a view of the shadow maps
+		RENDER_PASS_SHADOW
 	};
 
 	struct OBJECT_MATERIAL
@@ -41,6 +192,8 @@ public:
 		glm::vec3 specularColor;
 		float shininess;
 		std::string tag;
+		// filtering and wrapping used for the object texture
+		SamplerRegistry::SAMPLER_STATE sampler = SamplerRegistry::DefaultState();
 	};
 
 private:
@@ -48,24 +201,210 @@ private:
 	ShaderManager* m_pShaderManager;
 	// pointer to basic shapes object
 	ShapeMeshes* m_basicMeshes;
-	// total number of loaded textures
-	int m_loadedTextures;
-	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
+	// loaded textures info, indexed by texture slot
+	std::vector<TEXTURE_INFO> m_textureIDs;
+	// handles of the texture and material tags
+	TagTable m_tags;
+	// texture registry - texture slot of every registered tag, including
+	// the tags sharing an identical cached texture, indexed by tag handle
+	// and -1 for tags without a texture
+	std::vector<int> m_textureSlots;
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// index in m_objectMaterials of each tag handle, -1 for none
+	std::vector<int> m_materialIndices;
+	// every defined material, in the order of m_objectMaterials
+	MaterialBuffer m_materialBuffer;
+	// lights of the scene, shared by every shader program
+	LightBuffer m_lightBuffer;
+	// point lights shaded only by the clusters they reach
+	ClusteredLights m_clusteredLights;
+	// true when the clustered lights are shaded
+	bool m_bClusteredLights;
+	// first of the texture units of the clustered light buffers
+	int m_clusterTextureUnit;
+	// G-buffer and programs of the deferred shading path
+	DeferredRenderer m_deferredRenderer;
+	// first of the texture units of the G-buffer
+	int m_deferredTextureUnit;
+	// true when the scene is rendered with deferred shading
+	bool m_bDeferredShading;
+	// false until the deferred programs got the scene's uniforms
+	bool m_bDeferredUniformsCopied;
+	// pass of the draws being made
+	RENDER_PASS m_renderPass;
+	// cached shadow maps of the scene lights
+	ShadowMaps m_shadowMaps;
+	// true when the lights cast shadows
+	bool m_bShadows;
+	// first of the texture units of the shadow maps
+	int m_shadowTextureUnit;
+	// how the next draws cast shadows
+	ShadowMaps::CASTER m_shadowCaster;
+	// casters drawn by the shadow pass, and the point light of its
+	// view or -1 for the directional light
+	ShadowMaps::CASTER m_shadowPassCaster;
+	int m_shadowPassLight;
+	// tag handles used by RenderScene()
+	SCENE_TAGS m_sceneTags;
+	// uniform values of the next draw
+	DRAW_STATE m_drawState;
+	// programs used for drawing, by program ID
+	std::unordered_map<GLuint, SHADER_PROGRAM> m_shaderPrograms;
+	// program currently in use
+	GLuint m_currentProgram;
+	// specialized variants of the scene shaders
+	ShaderVariants m_shaderVariants;
+	// true when draws use the shader variants
+	bool m_bShaderVariants;
+	// lights of the scene, as turned on in the light buffer
+	ShaderVariants::VARIANT m_lightVariant;
+	// false when the active point lights are not the first ones,
+	// which the variants cannot express
+	bool m_bVariantLights;
+	// number of frames rendered
+	int m_frame;
+	// per frame uniforms of the frame being rendered
+	FRAME_STATE m_frameState;
+	// texture cache - maps image file content hashes to loaded texture slots
+	std::unordered_map<uint64_t, int> m_textureCache;
+	// number of image decodes and uploads skipped by the texture cache
+	int m_textureCacheHits;
+	// GPU memory not allocated because of texture cache hits
+	size_t m_textureCacheBytesSaved;
+
+	struct PENDING_TEXTURE
+	{
+		std::string filename;
+		std::string tag;
+		int jobIndex;
+	};
+
+	// worker threads for decoding texture image files
+	TextureDecodePool m_texturePool;
+	// textures queued for decoding, in the order they were queued
+	std::vector<PENDING_TEXTURE> m_pendingTextures;
+	// true when textures are streamed in the background
+	bool m_bStreamTextures;
+	// background texture loader, created on first use
+	TextureStreamer* m_pTextureStreamer;
+	// 1x1 texture bound to slots whose texture is still streaming
+	GLuint m_placeholderTexture;
+	// slots of the image files already queued for streaming
+	std::unordered_map<std::string, int> m_streamedFiles;
+	// selected texture storage backend
+	TEXTURE_BACKEND m_textureBackend;
+	// array textures used by the array backend
+	TextureArray m_textureArray;
+	// texture unit reserved for the texture arrays
+	int m_textureArrayUnit;
+	// array texture bound to that unit
+	GLuint m_boundTextureArray;
+	// binds standalone textures to the remaining texture units
+	TextureUnitCache m_textureUnits;
+	// texture unit of the texture selected for the next draw
+	int m_currentTextureUnit;
+	// sampler objects for the material sampler states
+	SamplerRegistry m_samplers;
+	// GPU memory budget for the standalone textures
+	TextureResidency m_textureResidency;
+	// watches the textures directory in hot reload mode, or NULL
+	TextureWatcher* m_pTextureWatcher;
+	// true when mipmaps are built on the CPU instead of the driver
+	bool m_bCPUMipmaps;
+	// directory of the compressed texture cache, empty when disabled
+	std::string m_compressionCache;
+	// true when textures and meshes are created on first use
+	bool m_bLazyResources;
+	// true while LoadSceneTextures() defers the queued textures
+	bool m_bDeferTextures;
+	// image files of the textures not loaded yet, by tag
+	std::unordered_map<std::string, std::string> m_deferredTextures;
+	// meshes already loaded into the basic shapes object
+	bool m_meshLoaded[MESH_COUNT];
+	// texture tags and mesh names loaded up front in lazy mode
+	std::vector<std::string> m_prewarmList;
 
 	// load texture images and convert to OpenGL texture data
 	bool CreateGLTexture(const char* filename, std::string tag);
+	// queue a texture image to be decoded on the worker threads
+	void QueueGLTexture(const char* filename, std::string tag);
+	// upload the queued textures and register their tags
+	bool FinishGLTextures();
+	// add a texture to the registry under the passed in tag
+	int RegisterTexture(const TEXTURE_INFO& texture, std::string tag);
+	// point a tag at a texture slot unless it already has one
+	void AssignTextureSlot(const std::string& tag, int slot);
+	// index the defined materials by tag handle and upload them
+	void RegisterMaterials();
+	// resolve the tag handles used by RenderScene()
+	void ResolveSceneTags();
+	// mark every uniform location as missing
+	static void ClearUniforms(SCENE_UNIFORMS& locations);
+	// resolve the locations of the uniforms set by the draw code
+	void ResolveUniforms(GLuint programID, SCENE_UNIFORMS& locations);
+	// get a program used for drawing, resolving its uniforms on first use
+	SHADER_PROGRAM& GetShaderProgram(GLuint programID);
+	// read which lights are turned on, to pick the shader variants
+	void ReadLightState();
+	// select the program for the draw state and set its uniforms
+	void ApplyDrawState();
+	// build the clustered light lists for the view of the frame
+	void UpdateClusteredLights();
+	// read the view and projection of the frame
+	void ReadViewMatrices(glm::mat4& view, glm::mat4& projection);
+	// read the per frame uniforms of the ShaderManager program
+	void ReadFrameState();
+	// set the per frame uniforms into the program in use, once
+	// per frame
+	void ApplyFrameState(SHADER_PROGRAM& program);
+	// render the frame from the G-buffer
+	void RenderDeferred();
+	// transform and draw the meshes of the scene
+	void DrawSceneObjects();
+	// set how the next draws cast shadows
+	void SetShadowCaster(ShadowMaps::CASTER caster);
+	// render the shadow maps that changed and set their uniforms
+	void UpdateShadowMaps();
+	// upload a decoded image into a new or an existing OpenGL texture
+	GLuint UploadGLTexture(const TextureDecodePool::DECODE_JOB& job, GLuint existingID = 0);
+	// add a decoded image to the texture array, returns the layer
+	int AddToTextureArray(const TextureDecodePool::DECODE_JOB& job);
+	// register a slot for a texture and stream it in the background
+	bool StreamGLTexture(const char* filename, std::string tag);
+	// swap the streamed textures that became resident into their slots
+	void UpdateStreamedTextures();
+	// keep the textures within the memory budget
+	void UpdateTextureResidency();
+	// point every slot using a texture at its replacement
+	void ReplaceTextureID(GLuint oldID, GLuint newID);
+	// reload the textures whose image files changed
+	void UpdateHotReloadedTextures();
+	// decode an image file again and replace the texture of a slot
+	bool ReloadGLTexture(int slot);
+	// load a deferred texture the first time its tag is used
+	bool LoadDeferredTexture(const std::string& tag);
+	// load a mesh into the basic shapes object if needed
+	void LoadMesh(MESH_TYPE mesh);
+	// load a mesh if needed and apply the draw state, false when
+	// the pass being drawn skips the draw
+	bool UseMesh(MESH_TYPE mesh);
+	// the point lights whose range reaches a mesh drawn with the
+	// current transformation, as a bit mask
+	int GetPointLightMask(MESH_TYPE mesh) const;
+	// true when a texture tag or mesh name is in the prewarm list
+	bool IsPrewarmed(const std::string& name) const;
 	// bind loaded OpenGL textures to slots in memory
 	void BindGLTextures();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
 	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
-	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	int FindTextureID(const std::string& tag);
+	int FindTextureSlot(const std::string& tag);
+	int FindTextureSlot(int tagHandle) const;
+	// find a defined material by tag, NULL when none is defined
+	const OBJECT_MATERIAL* FindMaterial(const std::string& tag) const;
+	const OBJECT_MATERIAL* FindMaterial(int tagHandle) const;
 
 	// set the transformation values 
 	// into the transform buffer
@@ -85,7 +424,9 @@ private:
 
 	// set the texture data into the shader
 	void SetShaderTexture(
-		std::string textureTag);
+		const std::string& textureTag);
+	void SetShaderTexture(
+		int textureTagHandle);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
@@ -93,9 +434,46 @@ private:
 
 	// set the object material into the shader
 	void SetShaderMaterial(
-		std::string materialTag);
+		const std::string& materialTag);
+	void SetShaderMaterial(
+		int materialTagHandle);
 
 public:
+	// stream textures in the background instead of loading
+	// them all before the first frame
+	void EnableTextureStreaming(bool bEnable);
+	// choose how textures are stored, before the scene is prepared
+	void SetTextureBackend(TEXTURE_BACKEND backend);
+	// choose the texture filtering quality tier
+	void SetSamplerQuality(SamplerRegistry::SAMPLER_QUALITY quality);
+	// build mipmaps on the decode threads instead of the driver
+	void EnableCPUMipmaps(bool bEnable);
+	// block compress the textures, cached on disk between runs
+	void EnableTextureCompression(bool bEnable);
+	// draw with shader variants compiled from these source files
+	void EnableShaderVariants(const char* vertexFilename, const char* fragmentFilename);
+	// limit the GPU memory used by textures, 0 for no limit
+	void SetTextureBudget(size_t budgetBytes);
+	// reload textures when their image files in the directory change
+	void EnableTextureHotReload(const char* directory);
+	// create textures and meshes when they are first drawn
+	void EnableLazyResources(bool bEnable);
+	// load a texture tag or mesh name up front in lazy mode
+	void AddPrewarmResource(const std::string& name);
+	// shade point lights by view frustum cluster, the lists are built
+	// by the compute shader in the file when it can run
+	void EnableClusteredLights(const char* computeShaderFilename);
+	// clustered point lights, changes are uploaded at the next frame
+	ClusteredLights& GetClusteredLights() { return(m_clusteredLights); }
+	// scatter small clustered point lights over the counter
+	void AddClusteredTestLights(int count);
+	// shade from a G-buffer filled by the geometry shaders and lit by
+	// fullscreen passes of the lighting shaders
+	void EnableDeferredShading(const char* geometryVertexFilename, const char* geometryFragmentFilename,
+		const char* lightingVertexFilename, const char* lightingFragmentFilename);
+	// cast shadows from the directional and point lights, the casters
+	// are drawn into the maps by the depth shaders in the files
+	void EnableShadows(const char* vertexFilename, const char* fragmentFilename);
 
 	// The following methods are for the students to 
 	// customize for their own 3D scene
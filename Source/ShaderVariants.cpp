@@ -0,0 +1,543 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadervariants.cpp
+// ============
+// compile specialized variants of the scene shaders on first use
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderVariants.h"
+#include "StartupTrace.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+
+// declaration of global variables
+namespace
+{
+	/***********************************************************
+	 *  InsertDefines()
+	 *
+	 *  Put the defines right after the #version line, which
+	 *  must stay the first line of the shader.
+	 ***********************************************************/
+	std::string InsertDefines(const std::string& source, const std::string& defines)
+	{
+		size_t versionLine = source.find("#version");
+		if (versionLine == std::string::npos)
+		{
+			return(defines + source);
+		}
+		size_t lineEnd = source.find('\n', versionLine);
+		if (lineEnd == std::string::npos)
+		{
+			return(source + "\n" + defines);
+		}
+		return(source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1));
+	}
+}
+
+/***********************************************************
+ *  ShaderVariants()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderVariants::ShaderVariants()
+{
+	m_baseProgram = 0;
+}
+
+/***********************************************************
+ *  ~ShaderVariants()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderVariants::~ShaderVariants()
+{
+	m_programs.clear();
+}
+
+/***********************************************************
+ *  LoadSource()
+ *
+ *  This method is used for reading the shader source files
+ *  the variants are compiled from.
+ ***********************************************************/
+bool ShaderVariants::LoadSource(const char* vertexFilename, const char* fragmentFilename, GLuint baseProgram)
+{
+	m_baseProgram = baseProgram;
+	if ((ReadSource(vertexFilename, m_vertexSource) == false) ||
+		(ReadSource(fragmentFilename, m_fragmentSource) == false))
+	{
+		m_vertexSource.clear();
+		m_fragmentSource.clear();
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  GetProgram()
+ *
+ *  This method is used for getting the program of a variant.
+ *  A variant that failed to compile is not tried again and
+ *  the base program is used for it instead.
+ ***********************************************************/
+GLuint ShaderVariants::GetProgram(const VARIANT& variant)
+{
+	if (IsLoaded() == false)
+	{
+		return(m_baseProgram);
+	}
+
+	uint32_t key = GetKey(variant);
+	std::unordered_map<uint32_t, GLuint>::iterator found = m_programs.find(key);
+	if (found != m_programs.end())
+	{
+		return((found->second != 0) ? found->second : m_baseProgram);
+	}
+
+	GLuint programID = 0;
+	{
+		StartupTrace::Scope trace("CompileShaderVariant", "shader");
+		programID = Compile(GetDefines(variant));
+	}
+	m_programs[key] = programID;
+	if (programID == 0)
+	{
+		return(m_baseProgram);
+	}
+
+	// start from the uniform values set into the base program
+	GLint currentProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+	CopyUniforms(m_baseProgram, programID);
+	glUseProgram((GLuint)currentProgram);
+
+	std::cout << "Compiled shader variant: textured:" << variant.bTextured << ", lit:" << variant.bLit
+		<< ", point lights:" << (variant.bLit ? variant.pointLights : 0) << std::endl;
+	return(programID);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for deleting the compiled variants.
+ ***********************************************************/
+void ShaderVariants::Destroy()
+{
+	std::unordered_map<uint32_t, GLuint>::iterator program;
+	for (program = m_programs.begin(); program != m_programs.end(); program++)
+	{
+		if (program->second != 0)
+		{
+			glDeleteProgram(program->second);
+		}
+	}
+	m_programs.clear();
+}
+
+/***********************************************************
+ *  CopyUniforms()
+ *
+ *  This method is used for copying uniform values between
+ *  two programs built from the same source.  Uniforms the
+ *  target does not use are skipped, and the uniform block
+ *  bindings are copied along with the values.
+ ***********************************************************/
+void ShaderVariants::CopyUniforms(GLuint fromProgram, GLuint toProgram)
+{
+	glUseProgram(toProgram);
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(fromProgram, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(fromProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<char> nameBuffer(maxNameLength + 1);
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(fromProgram, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+		std::string name(nameBuffer.data(), length);
+
+		// arrays are listed once, as "name[0]"
+		std::string arrayName = name;
+		if ((size > 1) && (name.size() > 3) && (name.compare(name.size() - 3, 3, "[0]") == 0))
+		{
+			arrayName = name.substr(0, name.size() - 3);
+		}
+		for (GLint element = 0; element < size; element++)
+		{
+			std::string elementName = (size > 1) ? arrayName + "[" + std::to_string(element) + "]" : name;
+			GLint fromLocation = glGetUniformLocation(fromProgram, elementName.c_str());
+			GLint toLocation = glGetUniformLocation(toProgram, elementName.c_str());
+			// members of uniform blocks have no location
+			if ((fromLocation < 0) || (toLocation < 0))
+			{
+				continue;
+			}
+
+			GLfloat floats[16];
+			GLint ints[4];
+			switch (type)
+			{
+			case GL_FLOAT:
+				glGetUniformfv(fromProgram, fromLocation, floats);
+				glUniform1fv(toLocation, 1, floats);
+				break;
+			case GL_FLOAT_VEC2:
+				glGetUniformfv(fromProgram, fromLocation, floats);
+				glUniform2fv(toLocation, 1, floats);
+				break;
+			case GL_FLOAT_VEC3:
+				glGetUniformfv(fromProgram, fromLocation, floats);
+				glUniform3fv(toLocation, 1, floats);
+				break;
+			case GL_FLOAT_VEC4:
+				glGetUniformfv(fromProgram, fromLocation, floats);
+				glUniform4fv(toLocation, 1, floats);
+				break;
+			case GL_FLOAT_MAT3:
+				glGetUniformfv(fromProgram, fromLocation, floats);
+				glUniformMatrix3fv(toLocation, 1, GL_FALSE, floats);
+				break;
+			case GL_FLOAT_MAT4:
+				glGetUniformfv(fromProgram, fromLocation, floats);
+				glUniformMatrix4fv(toLocation, 1, GL_FALSE, floats);
+				break;
+			case GL_INT:
+			case GL_BOOL:
+			case GL_SAMPLER_2D:
+			case GL_SAMPLER_2D_ARRAY:
+			case GL_SAMPLER_2D_SHADOW:
+			case GL_SAMPLER_CUBE:
+			case GL_SAMPLER_BUFFER:
+			case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+				glGetUniformiv(fromProgram, fromLocation, ints);
+				glUniform1i(toLocation, ints[0]);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	GLint blockCount = 0;
+	glGetProgramiv(fromProgram, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+	for (GLint i = 0; i < blockCount; i++)
+	{
+		GLsizei length = 0;
+		char blockName[256];
+		glGetActiveUniformBlockName(fromProgram, (GLuint)i, sizeof(blockName), &length, blockName);
+		GLint binding = 0;
+		glGetActiveUniformBlockiv(fromProgram, (GLuint)i, GL_UNIFORM_BLOCK_BINDING, &binding);
+		GLuint toBlock = glGetUniformBlockIndex(toProgram, blockName);
+		if (toBlock != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(toProgram, toBlock, (GLuint)binding);
+		}
+	}
+}
+
+/***********************************************************
+ *  GetKey()
+ *
+ *  Pack a variant into an integer.  The lights do not
+ *  change unlit variants, so they are left out of the key.
+ ***********************************************************/
+uint32_t ShaderVariants::GetKey(const VARIANT& variant)
+{
+	uint32_t key = variant.bTextured ? 1 : 0;
+	if (variant.bLit)
+	{
+		key |= 2;
+		key |= variant.bDirectionalLight ? 4 : 0;
+		key |= variant.bSpotLight ? 8 : 0;
+		key |= (uint32_t)variant.pointLights << 4;
+		key |= variant.bClusteredLights ? 256 : 0;
+		key |= variant.bShadows ? 512 : 0;
+	}
+	return(key);
+}
+
+/***********************************************************
+ *  GetDefines()
+ *
+ *  Build the #define lines read by the fragment shader.
+ ***********************************************************/
+std::string ShaderVariants::GetDefines(const VARIANT& variant)
+{
+	std::ostringstream defines;
+	defines << "#define SHADER_VARIANT\n";
+	defines << "#define VARIANT_TEXTURED " << (variant.bTextured ? 1 : 0) << "\n";
+	defines << "#define VARIANT_LIT " << (variant.bLit ? 1 : 0) << "\n";
+	defines << "#define VARIANT_DIRECTIONAL_LIGHT " << ((variant.bLit && variant.bDirectionalLight) ? 1 : 0) << "\n";
+	defines << "#define VARIANT_SPOT_LIGHT " << ((variant.bLit && variant.bSpotLight) ? 1 : 0) << "\n";
+	defines << "#define VARIANT_POINT_LIGHTS " << (variant.bLit ? variant.pointLights : 0) << "\n";
+	defines << "#define VARIANT_CLUSTERED_LIGHTS " << ((variant.bLit && variant.bClusteredLights) ? 1 : 0) << "\n";
+	defines << "#define VARIANT_SHADOWS " << ((variant.bLit && variant.bShadows) ? 1 : 0) << "\n";
+	return(defines.str());
+}
+
+/***********************************************************
+ *  Compile()
+ *
+ *  This method is used for compiling and linking the shader
+ *  source with the defines of a variant.
+ ***********************************************************/
+GLuint ShaderVariants::Compile(const std::string& defines)
+{
+	GLuint shaderIDs[2];
+	shaderIDs[0] = CompileShader(GL_VERTEX_SHADER, InsertDefines(m_vertexSource, defines), "shader variant");
+	shaderIDs[1] = CompileShader(GL_FRAGMENT_SHADER, InsertDefines(m_fragmentSource, defines), "shader variant");
+	return(LinkProgram(shaderIDs, 2, "shader variant"));
+}
+
+/***********************************************************
+ *  ReadSource()
+ *
+ *  This method is used for reading a whole shader source
+ *  file into a string.  GLSL has no includes, so each
+ *  #include "file" line is replaced here by the named file,
+ *  which is found next to the including shader.
+ ***********************************************************/
+bool ShaderVariants::ReadSource(const char* filename, std::string& source)
+{
+	std::vector<std::string> includeStack;
+	return(ReadSource(filename, source, includeStack));
+}
+
+/***********************************************************
+ *  ReadSource()
+ *
+ *  This method is used for reading a shader source file
+ *  that is included by the files on the include stack.  A
+ *  file that is already on the stack would include itself
+ *  without end, so the cycle is reported instead.
+ ***********************************************************/
+bool ShaderVariants::ReadSource(const char* filename, std::string& source, std::vector<std::string>& includeStack)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Could not read shader file:" << filename << std::endl;
+		return(false);
+	}
+
+	std::string normalized = std::filesystem::path(filename).lexically_normal().generic_string();
+	if (std::find(includeStack.begin(), includeStack.end(), normalized) != includeStack.end())
+	{
+		std::cout << "Shader include cycle:";
+		for (size_t i = 0; i < includeStack.size(); i++)
+		{
+			std::cout << " " << includeStack[i] << " ->";
+		}
+		std::cout << " " << normalized << std::endl;
+		return(false);
+	}
+	includeStack.push_back(normalized);
+
+	std::string path = filename;
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = (slash == std::string::npos) ? std::string() : path.substr(0, slash + 1);
+
+	source.clear();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		size_t start = line.find_first_not_of(" \t");
+		if ((start != std::string::npos) && (line.compare(start, 8, "// #copy") == 0))
+		{
+			if (ReadCopy(file, line, directory, filename, source, includeStack) == false)
+			{
+				return(false);
+			}
+			continue;
+		}
+		if ((start == std::string::npos) || (line.compare(start, 8, "#include") != 0))
+		{
+			source += line;
+			source += '\n';
+			continue;
+		}
+
+		size_t nameStart = line.find('"', start);
+		size_t nameEnd = (nameStart == std::string::npos) ? nameStart : line.find('"', nameStart + 1);
+		if (nameEnd == std::string::npos)
+		{
+			std::cout << "Bad #include in shader file:" << filename << std::endl;
+			return(false);
+		}
+		std::string included;
+		std::string includedFilename = directory + line.substr(nameStart + 1, nameEnd - nameStart - 1);
+		if (ReadSource(includedFilename.c_str(), included, includeStack) == false)
+		{
+			return(false);
+		}
+		source += included;
+	}
+
+	includeStack.pop_back();
+	return(true);
+}
+
+/***********************************************************
+ *  ReadCopy()
+ *
+ *  This method is used for reading a block that copies a
+ *  shared file into a shader, so the shader also loads
+ *  without ReadSource().  The block runs from a
+ *  // #copy "file" line to a // #endcopy line and must
+ *  match the file, which is used in its place.  A copy
+ *  that no longer matches is reported, not rejected.
+ ***********************************************************/
+bool ShaderVariants::ReadCopy(std::istream& file, const std::string& copyLine, const std::string& directory, const char* filename, std::string& source, std::vector<std::string>& includeStack)
+{
+	size_t nameStart = copyLine.find('"');
+	size_t nameEnd = (nameStart == std::string::npos) ? nameStart : copyLine.find('"', nameStart + 1);
+	if (nameEnd == std::string::npos)
+	{
+		std::cout << "Bad #copy in shader file:" << filename << std::endl;
+		return(false);
+	}
+	std::string copiedFilename = directory + copyLine.substr(nameStart + 1, nameEnd - nameStart - 1);
+
+	std::string copy;
+	std::string line;
+	bool bEnded = false;
+	while ((bEnded == false) && std::getline(file, line))
+	{
+		size_t start = line.find_first_not_of(" \t");
+		if ((start != std::string::npos) && (line.compare(start, 11, "// #endcopy") == 0))
+		{
+			bEnded = true;
+		}
+		else
+		{
+			copy += line;
+			copy += '\n';
+		}
+	}
+	if (bEnded == false)
+	{
+		std::cout << "Missing // #endcopy in shader file:" << filename << std::endl;
+		return(false);
+	}
+
+	std::string copied;
+	if (ReadSource(copiedFilename.c_str(), copied, includeStack) == false)
+	{
+		return(false);
+	}
+
+	// the files may differ in line endings only
+	copy.erase(std::remove(copy.begin(), copy.end(), '\r'), copy.end());
+	std::string expected = copied;
+	expected.erase(std::remove(expected.begin(), expected.end(), '\r'), expected.end());
+	if (copy != expected)
+	{
+		std::cout << "Shader file " << filename << " has an out of date copy of " << copiedFilename << std::endl;
+	}
+
+	source += copied;
+	return(true);
+}
+
+/***********************************************************
+ *  CompileShader()
+ *
+ *  This method is used for compiling one shader stage.
+ ***********************************************************/
+GLuint ShaderVariants::CompileShader(GLenum type, const std::string& source, const char* name)
+{
+	GLuint shaderID = glCreateShader(type);
+	const char* text = source.c_str();
+	glShaderSource(shaderID, 1, &text, NULL);
+	glCompileShader(shaderID);
+
+	GLint bCompiled = GL_FALSE;
+	glGetShaderiv(shaderID, GL_COMPILE_STATUS, &bCompiled);
+	if (bCompiled == GL_FALSE)
+	{
+		char infoLog[1024];
+		glGetShaderInfoLog(shaderID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "Shader compilation failed:" << name << ":" << infoLog << std::endl;
+		glDeleteShader(shaderID);
+		return(0);
+	}
+	return(shaderID);
+}
+
+/***********************************************************
+ *  LinkProgram()
+ *
+ *  This method is used for linking compiled shaders into a
+ *  program.  The shaders are deleted either way, as the
+ *  program keeps what it needs of them.
+ ***********************************************************/
+GLuint ShaderVariants::LinkProgram(const GLuint* shaderIDs, int shaderCount, const char* name)
+{
+	bool bCompiled = true;
+	for (int i = 0; i < shaderCount; i++)
+	{
+		bCompiled = bCompiled && (shaderIDs[i] != 0);
+	}
+	if (bCompiled == false)
+	{
+		for (int i = 0; i < shaderCount; i++)
+		{
+			glDeleteShader(shaderIDs[i]);
+		}
+		return(0);
+	}
+
+	GLuint programID = glCreateProgram();
+	for (int i = 0; i < shaderCount; i++)
+	{
+		glAttachShader(programID, shaderIDs[i]);
+	}
+	glLinkProgram(programID);
+	for (int i = 0; i < shaderCount; i++)
+	{
+		glDeleteShader(shaderIDs[i]);
+	}
+
+	GLint bLinked = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &bLinked);
+	if (bLinked == GL_FALSE)
+	{
+		char infoLog[1024];
+		glGetProgramInfoLog(programID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "Shader linking failed:" << name << ":" << infoLog << std::endl;
+		glDeleteProgram(programID);
+		return(0);
+	}
+	return(programID);
+}
+
+/***********************************************************
+ *  CompileProgram()
+ *
+ *  This method is used for building a program from a
+ *  vertex and a fragment shader file.
+ ***********************************************************/
+GLuint ShaderVariants::CompileProgram(const char* vertexFilename, const char* fragmentFilename)
+{
+	std::string vertexSource;
+	std::string fragmentSource;
+	if ((ReadSource(vertexFilename, vertexSource) == false) ||
+		(ReadSource(fragmentFilename, fragmentSource) == false))
+	{
+		return(0);
+	}
+
+	GLuint shaderIDs[2];
+	shaderIDs[0] = CompileShader(GL_VERTEX_SHADER, vertexSource, vertexFilename);
+	shaderIDs[1] = CompileShader(GL_FRAGMENT_SHADER, fragmentSource, fragmentFilename);
+	return(LinkProgram(shaderIDs, 2, fragmentFilename));
+}
@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadervariants.h
+// ============
+// compile specialized variants of the scene shaders on first use
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <istream>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+/***********************************************************
+ *  ShaderVariants
+ *
+ *  This class compiles the scene shaders again with
+ *  #defines describing the draw state, so the fragment
+ *  shader is specialized instead of branching on uniforms
+ *  for every fragment.  Each variant is compiled the first
+ *  time it is requested and then kept.  A new variant
+ *  starts with a copy of the uniform values of the program
+ *  loaded by the ShaderManager, so the lights and samplers
+ *  set up there apply to every variant.
+ ***********************************************************/
+class ShaderVariants
+{
+public:
+	// the draw state a variant is specialized for
+	struct VARIANT
+	{
+		bool bTextured;
+		bool bLit;
+		// the lights below are only used by lit variants
+		bool bDirectionalLight;
+		bool bSpotLight;
+		// point lights 0 to pointLights - 1 are active
+		int pointLights;
+		// the clustered point lights are shaded
+		bool bClusteredLights;
+		// the directional and point lights read their shadow maps
+		bool bShadows;
+	};
+
+	// constructor
+	ShaderVariants();
+	// destructor
+	~ShaderVariants();
+
+	// read the shader source files, the base program is the one
+	// the ShaderManager linked from the same files
+	bool LoadSource(const char* vertexFilename, const char* fragmentFilename, GLuint baseProgram);
+	// true once the source files were read
+	bool IsLoaded() const { return(m_fragmentSource.size() > 0); }
+	// get the program of a variant, compiling it on first use,
+	// returns the base program if it cannot be compiled
+	GLuint GetProgram(const VARIANT& variant);
+	// program loaded by the ShaderManager
+	GLuint GetBaseProgram() const { return(m_baseProgram); }
+	// number of variants compiled so far
+	int GetVariantCount() const { return((int)m_programs.size()); }
+	// delete the compiled variants
+	void Destroy();
+
+	// copy the values of the active uniforms from one program to
+	// another - leaves the target in use
+	static void CopyUniforms(GLuint fromProgram, GLuint toProgram);
+
+	// read a whole shader source file, with its #include lines and
+	// // #copy blocks replaced by the named files
+	static bool ReadSource(const char* filename, std::string& source);
+	// compile one shader stage, 0 on failure - the name only
+	// identifies the shader in the error message
+	static GLuint CompileShader(GLenum type, const std::string& source, const char* name);
+	// link compiled shaders into a program and delete the shaders,
+	// 0 on failure or when one of the shaders is 0
+	static GLuint LinkProgram(const GLuint* shaderIDs, int shaderCount, const char* name);
+	// read, compile and link a vertex and a fragment shader file,
+	// 0 on failure
+	static GLuint CompileProgram(const char* vertexFilename, const char* fragmentFilename);
+
+private:
+	// read a shader source file included by the files on the stack,
+	// false when the file is already on it
+	static bool ReadSource(const char* filename, std::string& source, std::vector<std::string>& includeStack);
+	// read a // #copy block of a shader file and check it against
+	// the copied file, which is appended to the source
+	static bool ReadCopy(std::istream& file, const std::string& copyLine, const std::string& directory, const char* filename, std::string& source, std::vector<std::string>& includeStack);
+	// pack a variant into the key of the program cache
+	static uint32_t GetKey(const VARIANT& variant);
+	// the #define lines of a variant
+	static std::string GetDefines(const VARIANT& variant);
+	// compile and link a program with the defines, 0 on failure
+	GLuint Compile(const std::string& defines);
+
+	// shader source text
+	std::string m_vertexSource;
+	std::string m_fragmentSource;
+	// program loaded by the ShaderManager
+	GLuint m_baseProgram;
+	// compiled programs by variant key, 0 when compiling failed
+	std::unordered_map<uint32_t, GLuint> m_programs;
+};
@@ -0,0 +1,605 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmaps.cpp
+// ============
+// cache the shadow maps of the scene lights and render them only on change
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShadowMaps.h"
+#include "ShaderVariants.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <iostream>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// sampler uniforms of the maps, in TARGET order
+	const char* const g_SamplerNames[ShadowMaps::TEXTURE_UNIT_COUNT] =
+	{
+		"directionalShadowMap", "pointShadowAtlas"
+	};
+	// uniform of the depth program set by BeginView()
+	const char* g_LightViewProjectionName = "lightViewProjection";
+	// near plane of the point light cube faces, must match
+	// POINT_SHADOW_NEAR_PLANE in the fragment shaders
+	const float g_PointNearPlane = 0.1f;
+	// depth offset of the casters against shadow acne
+	const float g_PolygonOffsetFactor = 2.0f;
+	const float g_PolygonOffsetUnits = 4.0f;
+	// direction and up vector of each cube face, in the order of
+	// the OpenGL cube map faces, must match the fragment shaders
+	const glm::vec3 g_FaceForward[ShadowMaps::CUBE_FACE_COUNT] =
+	{
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+	};
+	const glm::vec3 g_FaceUp[ShadowMaps::CUBE_FACE_COUNT] =
+	{
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+	};
+	// FNV-1a hash of the caster transforms
+	const uint64_t g_HashOffsetBasis = 14695981039346656037ULL;
+	const uint64_t g_HashPrime = 1099511628211ULL;
+
+	/***********************************************************
+	 *  HashBytes()
+	 *
+	 *  Add bytes to an FNV-1a hash.
+	 ***********************************************************/
+	uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * g_HashPrime;
+		}
+		return(hash);
+	}
+}
+
+/***********************************************************
+ *  ShadowMaps()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShadowMaps::ShadowMaps()
+{
+	for (int layer = 0; layer < LAYER_COUNT; layer++)
+	{
+		for (int target = 0; target < TARGET_COUNT; target++)
+		{
+			m_textureIDs[layer][target] = 0;
+			m_framebufferIDs[layer][target] = 0;
+		}
+		for (int map = 0; map < MAP_COUNT; map++)
+		{
+			m_bDirty[layer][map] = true;
+		}
+	}
+	m_program = 0;
+	m_lightViewProjectionLocation = -1;
+	for (int view = 0; view < VIEW_COUNT; view++)
+	{
+		m_viewProjections[view] = glm::mat4(1.0f);
+	}
+	m_directionalShadowMatrix = glm::mat4(1.0f);
+	m_sceneMinimum = glm::vec3(-1.0f);
+	m_sceneMaximum = glm::vec3(1.0f);
+	for (int map = 0; map < MAP_COUNT; map++)
+	{
+		m_mapLights[map].bActive = false;
+		m_mapLights[map].vector = glm::vec3(0.0f);
+		m_mapLights[map].range = 0.0f;
+	}
+	for (int i = 0; i < 4; i++)
+	{
+		m_viewport[i] = 0;
+	}
+	for (int caster = 0; caster <= CASTER_DYNAMIC; caster++)
+	{
+		for (int map = 0; map < MAP_COUNT; map++)
+		{
+			m_casterHashes[caster][map] = g_HashOffsetBasis;
+			m_casterCounts[caster][map] = 0;
+			m_frameCasterHashes[caster][map] = g_HashOffsetBasis;
+			m_frameCasterCounts[caster][map] = 0;
+		}
+	}
+	m_bCastersKnown = false;
+}
+
+/***********************************************************
+ *  ~ShadowMaps()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShadowMaps::~ShadowMaps()
+{
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for compiling the depth program and
+ *  creating the depth textures of both layers.  The final
+ *  layer compares with linear filtering, which gives each
+ *  lookup a 2x2 percentage closer filter.
+ ***********************************************************/
+bool ShadowMaps::Initialize(const char* vertexFilename, const char* fragmentFilename)
+{
+	Destroy();
+
+	m_program = ShaderVariants::CompileProgram(vertexFilename, fragmentFilename);
+	if (m_program == 0)
+	{
+		return(false);
+	}
+	m_lightViewProjectionLocation = glGetUniformLocation(m_program, g_LightViewProjectionName);
+
+	const GLsizei widths[TARGET_COUNT] = { DIRECTIONAL_MAP_SIZE, POINT_FACE_SIZE * CUBE_FACE_COUNT };
+	const GLsizei heights[TARGET_COUNT] = { DIRECTIONAL_MAP_SIZE, POINT_FACE_SIZE * LightBuffer::MAX_POINT_LIGHTS };
+	// past the edges of the directional map nothing is shadowed
+	const GLfloat borderDepth[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int layer = 0; layer < LAYER_COUNT; layer++)
+	{
+		glGenTextures(TARGET_COUNT, m_textureIDs[layer]);
+		glGenFramebuffers(TARGET_COUNT, m_framebufferIDs[layer]);
+		for (int target = 0; target < TARGET_COUNT; target++)
+		{
+			glBindTexture(GL_TEXTURE_2D, m_textureIDs[layer][target]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, widths[target], heights[target], 0,
+				GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+			glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderDepth);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferIDs[layer][target]);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_textureIDs[layer][target], 0);
+			// the maps only store depth
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+			GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+			if (status != GL_FRAMEBUFFER_COMPLETE)
+			{
+				std::cout << "Shadow map is incomplete:" << status << std::endl;
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				glBindTexture(GL_TEXTURE_2D, 0);
+				Destroy();
+				return(false);
+			}
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return(true);
+}
+
+/***********************************************************
+ *  SetSceneBounds()
+ *
+ *  This method is used for setting the box around every
+ *  caster and receiver, which the directional light's map
+ *  is fitted to.
+ ***********************************************************/
+void ShadowMaps::SetSceneBounds(const glm::vec3& minimum, const glm::vec3& maximum)
+{
+	m_sceneMinimum = minimum;
+	m_sceneMaximum = maximum;
+	if (m_mapLights[0].bActive)
+	{
+		BuildDirectionalView(m_mapLights[0].vector);
+		m_bDirty[LAYER_STATIC][0] = true;
+		m_bDirty[LAYER_FINAL][0] = true;
+	}
+}
+
+/***********************************************************
+ *  UpdateLights()
+ *
+ *  This method is used for comparing the lights with the
+ *  ones the maps were rendered for.  A light that moved or
+ *  was turned on gets both layers of its map rendered
+ *  again, the other maps are kept.
+ ***********************************************************/
+void ShadowMaps::UpdateLights(const LightBuffer::LIGHT_BLOCK& lights)
+{
+	const LightBuffer::DIRECTIONAL_LIGHT_DATA& directional = lights.directionalLight;
+	bool bActive = (directional.bActive != 0);
+	MAP_LIGHT& directionalMap = m_mapLights[0];
+	if ((bActive != directionalMap.bActive) || (bActive && (directional.direction != directionalMap.vector)))
+	{
+		directionalMap.bActive = bActive;
+		directionalMap.vector = directional.direction;
+		if (bActive)
+		{
+			BuildDirectionalView(directional.direction);
+			m_bDirty[LAYER_STATIC][0] = true;
+			m_bDirty[LAYER_FINAL][0] = true;
+		}
+	}
+
+	for (int i = 0; i < LightBuffer::MAX_POINT_LIGHTS; i++)
+	{
+		const LightBuffer::POINT_LIGHT_DATA& light = lights.pointLights[i];
+		bActive = (light.bActive != 0);
+		MAP_LIGHT& map = m_mapLights[1 + i];
+		if ((bActive != map.bActive) || (bActive && ((light.position != map.vector) || (light.range != map.range))))
+		{
+			map.bActive = bActive;
+			map.vector = light.position;
+			map.range = light.range;
+			if (bActive)
+			{
+				BuildPointViews(i, light.position, light.range);
+				m_bDirty[LAYER_STATIC][1 + i] = true;
+				m_bDirty[LAYER_FINAL][1 + i] = true;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  NeedsUpdate()
+ *
+ *  This method is used for checking whether any map of a
+ *  light that is turned on must be rendered.
+ ***********************************************************/
+bool ShadowMaps::NeedsUpdate() const
+{
+	for (int map = 0; map < MAP_COUNT; map++)
+	{
+		if (m_mapLights[map].bActive && (m_bDirty[LAYER_STATIC][map] || m_bDirty[LAYER_FINAL][map]))
+		{
+			return(true);
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  BuildDirectionalView()
+ *
+ *  This method is used for fitting an orthographic view
+ *  along the light direction around the scene box, and
+ *  the matrix turning a world position into coordinates
+ *  of the map.
+ ***********************************************************/
+void ShadowMaps::BuildDirectionalView(const glm::vec3& direction)
+{
+	glm::vec3 forward = glm::normalize(direction);
+	glm::vec3 center = (m_sceneMinimum + m_sceneMaximum) * 0.5f;
+	float radius = glm::length(m_sceneMaximum - m_sceneMinimum) * 0.5f;
+	glm::vec3 up = (std::fabs(forward.y) > 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 view = glm::lookAt(center - forward * (radius * 2.0f), center, up);
+
+	// the box of the scene corners in light space
+	glm::vec3 minimum(FLT_MAX);
+	glm::vec3 maximum(-FLT_MAX);
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 position((corner & 1) ? m_sceneMaximum.x : m_sceneMinimum.x,
+			(corner & 2) ? m_sceneMaximum.y : m_sceneMinimum.y,
+			(corner & 4) ? m_sceneMaximum.z : m_sceneMinimum.z);
+		glm::vec3 lightPosition = glm::vec3(view * glm::vec4(position, 1.0f));
+		minimum.x = std::min(minimum.x, lightPosition.x);
+		minimum.y = std::min(minimum.y, lightPosition.y);
+		minimum.z = std::min(minimum.z, lightPosition.z);
+		maximum.x = std::max(maximum.x, lightPosition.x);
+		maximum.y = std::max(maximum.y, lightPosition.y);
+		maximum.z = std::max(maximum.z, lightPosition.z);
+	}
+	// the view looks down -z
+	glm::mat4 projection = glm::ortho(minimum.x, maximum.x, minimum.y, maximum.y, -maximum.z, -minimum.z);
+	m_viewProjections[0] = projection * view;
+
+	// from normalized device coordinates to texture coordinates
+	glm::mat4 bias(0.5f);
+	bias[3] = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+	m_directionalShadowMatrix = bias * m_viewProjections[0];
+}
+
+/***********************************************************
+ *  BuildPointViews()
+ *
+ *  This method is used for computing the six 90 degree
+ *  views of a point light's cube faces, which reach as far
+ *  as the light does.
+ ***********************************************************/
+void ShadowMaps::BuildPointViews(int pointLight, const glm::vec3& position, float range)
+{
+	glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, g_PointNearPlane, std::max(range, g_PointNearPlane * 2.0f));
+	for (int face = 0; face < CUBE_FACE_COUNT; face++)
+	{
+		glm::mat4 view = glm::lookAt(position, position + g_FaceForward[face], g_FaceUp[face]);
+		m_viewProjections[1 + pointLight * CUBE_FACE_COUNT + face] = projection * view;
+	}
+}
+
+/***********************************************************
+ *  BeginUpdate()
+ *
+ *  This method is used for getting ready to render the maps.
+ *  The casters are drawn with a slope scaled depth offset,
+ *  so lit surfaces do not shadow themselves.
+ ***********************************************************/
+void ShadowMaps::BeginUpdate()
+{
+	glGetIntegerv(GL_VIEWPORT, m_viewport);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(g_PolygonOffsetFactor, g_PolygonOffsetUnits);
+	// a point light view only covers its face of the atlas
+	glEnable(GL_SCISSOR_TEST);
+}
+
+/***********************************************************
+ *  GetViewPointLight()
+ *
+ *  This method is used for finding the point light whose
+ *  cube face a view is.
+ ***********************************************************/
+int ShadowMaps::GetViewPointLight(int view)
+{
+	return((view == 0) ? -1 : (view - 1) / CUBE_FACE_COUNT);
+}
+
+/***********************************************************
+ *  BeginView()
+ *
+ *  This method is used for binding a view of a map for
+ *  drawing casters.  The static layer starts out cleared,
+ *  the final layer starts out as a copy of the static
+ *  layer, so only the dynamic casters are drawn into it.
+ ***********************************************************/
+bool ShadowMaps::BeginView(LAYER layer, int view)
+{
+	int pointLight = GetViewPointLight(view);
+	int map = 1 + pointLight;
+	if ((m_mapLights[map].bActive == false) || (m_bDirty[layer][map] == false))
+	{
+		return(false);
+	}
+
+	TARGET target = (pointLight < 0) ? TARGET_DIRECTIONAL : TARGET_POINT_ATLAS;
+	GLint x = 0;
+	GLint y = 0;
+	GLint size = DIRECTIONAL_MAP_SIZE;
+	if (pointLight >= 0)
+	{
+		size = POINT_FACE_SIZE;
+		x = ((view - 1) % CUBE_FACE_COUNT) * size;
+		y = pointLight * size;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferIDs[layer][target]);
+	glViewport(x, y, size, size);
+	glScissor(x, y, size, size);
+	if (layer == LAYER_STATIC)
+	{
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	else
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferIDs[LAYER_STATIC][target]);
+		glBlitFramebuffer(x, y, x + size, y + size, x, y, x + size, y + size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	}
+
+	glUseProgram(m_program);
+	glUniformMatrix4fv(m_lightViewProjectionLocation, 1, GL_FALSE, glm::value_ptr(m_viewProjections[view]));
+	return(true);
+}
+
+/***********************************************************
+ *  EndUpdate()
+ *
+ *  This method is used for marking every map rendered and
+ *  going back to drawing into the window.
+ ***********************************************************/
+void ShadowMaps::EndUpdate()
+{
+	for (int layer = 0; layer < LAYER_COUNT; layer++)
+	{
+		for (int map = 0; map < MAP_COUNT; map++)
+		{
+			// the map of a light turned off is rendered when it is
+			// turned on again
+			m_bDirty[layer][map] = false;
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(m_viewport[0], m_viewport[1], m_viewport[2], m_viewport[3]);
+	glDisable(GL_SCISSOR_TEST);
+	glDisable(GL_POLYGON_OFFSET_FILL);
+}
+
+/***********************************************************
+ *  HasDynamicCasters()
+ *
+ *  This method is used for checking whether the final
+ *  layer has any casters drawn over the static layer.
+ ***********************************************************/
+bool ShadowMaps::HasDynamicCasters() const
+{
+	if (m_bCastersKnown == false)
+	{
+		return(true);
+	}
+	for (int map = 0; map < MAP_COUNT; map++)
+	{
+		if (m_casterCounts[CASTER_DYNAMIC][map] > 0)
+		{
+			return(true);
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  TrackCaster()
+ *
+ *  This method is used for adding the mesh and transform of
+ *  a caster drawn this frame to the hashes of the maps it
+ *  reaches.  Every caster is inside the scene box, which
+ *  the directional light's map covers.
+ ***********************************************************/
+void ShadowMaps::TrackCaster(CASTER caster, int mesh, const glm::mat4& model, int pointLightMask)
+{
+	if (caster == CASTER_NONE)
+	{
+		return;
+	}
+	int mapMask = 1 | (pointLightMask << 1);
+	for (int map = 0; map < MAP_COUNT; map++)
+	{
+		if ((mapMask & (1 << map)) == 0)
+		{
+			continue;
+		}
+		uint64_t hash = HashBytes(m_frameCasterHashes[caster][map], &mesh, sizeof(mesh));
+		m_frameCasterHashes[caster][map] = HashBytes(hash, glm::value_ptr(model), sizeof(float) * 16);
+		m_frameCasterCounts[caster][map]++;
+	}
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for comparing the casters drawn this
+ *  frame with the last frame, map by map.  A changed static
+ *  caster rebuilds both layers of the maps it reaches, or
+ *  reached last frame, a changed dynamic caster only their
+ *  final layer.  The maps are rendered at the start of the
+ *  next frame, so a caster's shadow follows it one frame
+ *  late.
+ ***********************************************************/
+void ShadowMaps::EndFrame()
+{
+	for (int map = 0; map < MAP_COUNT; map++)
+	{
+		if (m_bCastersKnown)
+		{
+			for (int caster = CASTER_STATIC; caster <= CASTER_DYNAMIC; caster++)
+			{
+				if ((m_frameCasterHashes[caster][map] != m_casterHashes[caster][map]) ||
+					(m_frameCasterCounts[caster][map] != m_casterCounts[caster][map]))
+				{
+					// a static change also rebuilds the final layer
+					LAYER firstLayer = (caster == CASTER_STATIC) ? LAYER_STATIC : LAYER_FINAL;
+					for (int layer = firstLayer; layer < LAYER_COUNT; layer++)
+					{
+						m_bDirty[layer][map] = true;
+					}
+				}
+			}
+		}
+
+		// the maps of the first frame were rendered from its casters
+		for (int caster = 0; caster <= CASTER_DYNAMIC; caster++)
+		{
+			m_casterHashes[caster][map] = m_frameCasterHashes[caster][map];
+			m_casterCounts[caster][map] = m_frameCasterCounts[caster][map];
+			m_frameCasterHashes[caster][map] = g_HashOffsetBasis;
+			m_frameCasterCounts[caster][map] = 0;
+		}
+	}
+	m_bCastersKnown = true;
+}
+
+/***********************************************************
+ *  SetSamplerUnits()
+ *
+ *  This method is used for pointing the shadow samplers of
+ *  the program in use at their texture units.
+ ***********************************************************/
+void ShadowMaps::SetSamplerUnits(GLuint programID, int firstUnit)
+{
+	for (int i = 0; i < TEXTURE_UNIT_COUNT; i++)
+	{
+		GLint location = glGetUniformLocation(programID, g_SamplerNames[i]);
+		if (location >= 0)
+		{
+			glUniform1i(location, firstUnit + i);
+		}
+	}
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for binding the final layer of the
+ *  maps to their texture units.
+ ***********************************************************/
+void ShadowMaps::Bind(int firstUnit)
+{
+	for (int target = 0; target < TARGET_COUNT; target++)
+	{
+		glActiveTexture(GL_TEXTURE0 + firstUnit + target);
+		glBindTexture(GL_TEXTURE_2D, m_textureIDs[LAYER_FINAL][target]);
+	}
+}
+
+/***********************************************************
+ *  GetPointShadowMask()
+ *
+ *  This method is used for getting which point lights have
+ *  a shadow map, for the pointShadowMask uniform.
+ ***********************************************************/
+int ShadowMaps::GetPointShadowMask() const
+{
+	int pointShadowMask = 0;
+	for (int i = 0; i < LightBuffer::MAX_POINT_LIGHTS; i++)
+	{
+		if (m_mapLights[1 + i].bActive)
+		{
+			pointShadowMask |= (1 << i);
+		}
+	}
+	return(pointShadowMask);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the maps and the depth
+ *  program.
+ ***********************************************************/
+void ShadowMaps::Destroy()
+{
+	for (int layer = 0; layer < LAYER_COUNT; layer++)
+	{
+		for (int target = 0; target < TARGET_COUNT; target++)
+		{
+			if (m_framebufferIDs[layer][target] != 0)
+			{
+				glDeleteFramebuffers(1, &m_framebufferIDs[layer][target]);
+				m_framebufferIDs[layer][target] = 0;
+			}
+			if (m_textureIDs[layer][target] != 0)
+			{
+				glDeleteTextures(1, &m_textureIDs[layer][target]);
+				m_textureIDs[layer][target] = 0;
+			}
+		}
+		for (int map = 0; map < MAP_COUNT; map++)
+		{
+			m_bDirty[layer][map] = true;
+		}
+	}
+	if (m_program != 0)
+	{
+		glDeleteProgram(m_program);
+		m_program = 0;
+	}
+}
@@ -0,0 +1,178 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmaps.h
+// ============
+// cache the shadow maps of the scene lights and render them only on change
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "LightBuffer.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+/***********************************************************
+ *  ShadowMaps
+ *
+ *  This class holds the shadow maps of the directional
+ *  light and of the point lights - one depth map for the
+ *  directional light, and six cube faces for each point
+ *  light packed into the rows of a depth atlas.
+ *
+ *  Each map has two layers.  The static layer holds the
+ *  casters that do not move and is only rendered when the
+ *  light moves or a static caster changes.  The final
+ *  layer, which the shaders read, is a copy of the static
+ *  layer with the dynamic casters drawn over it, and is
+ *  only rebuilt when one of those changes.  While nothing
+ *  changes, no map is rendered at all.
+ *
+ *  The casters are drawn by the scene, which reports the
+ *  caster transforms of each frame with TrackCaster() so
+ *  changes are noticed at EndFrame().  The casters are
+ *  tracked for each map they reach, so a change only
+ *  renders the maps of the lights reaching that caster.
+ ***********************************************************/
+class ShadowMaps
+{
+public:
+	// size of the directional light's map
+	static const int DIRECTIONAL_MAP_SIZE = 1024;
+	// size of a point light cube face in the atlas, must match
+	// POINT_SHADOW_FACE_SIZE in the fragment shaders
+	static const int POINT_FACE_SIZE = 256;
+	static const int CUBE_FACE_COUNT = 6;
+	// maps - the directional light, then one per point light
+	static const int MAP_COUNT = 1 + LightBuffer::MAX_POINT_LIGHTS;
+	// views rendered into the maps - the directional light, then
+	// the cube faces of point light i at 1 + i * CUBE_FACE_COUNT
+	static const int VIEW_COUNT = 1 + LightBuffer::MAX_POINT_LIGHTS * CUBE_FACE_COUNT;
+	// texture units used by the directional map and the atlas
+	static const int TEXTURE_UNIT_COUNT = 2;
+
+	// how a draw takes part in the shadow maps
+	enum CASTER
+	{
+		// casts no shadow
+		CASTER_NONE = 0,
+		// drawn into the cached static layer
+		CASTER_STATIC,
+		// drawn over the static layer whenever a dynamic caster changes
+		CASTER_DYNAMIC
+	};
+
+	// the layers of every map
+	enum LAYER
+	{
+		LAYER_STATIC = 0,
+		LAYER_FINAL,
+		LAYER_COUNT
+	};
+
+	// constructor
+	ShadowMaps();
+	// destructor
+	~ShadowMaps();
+
+	// compile the depth program and create the maps
+	bool Initialize(const char* vertexFilename, const char* fragmentFilename);
+	bool IsInitialized() const { return(m_program != 0); }
+	// program drawing the casters into the maps
+	GLuint GetProgram() const { return(m_program); }
+
+	// box around the scene the directional light's map covers
+	void SetSceneBounds(const glm::vec3& minimum, const glm::vec3& maximum);
+	// compare the lights with the ones the maps were rendered for,
+	// and mark the maps of the lights that changed
+	void UpdateLights(const LightBuffer::LIGHT_BLOCK& lights);
+	// true when a map must be rendered before it is read
+	bool NeedsUpdate() const;
+	// true when the last frame drew dynamic casters, or before the
+	// casters of a frame are known
+	bool HasDynamicCasters() const;
+
+	// get ready to render the maps that need it
+	void BeginUpdate();
+	// bind a view of a layer for drawing its casters and put its
+	// view and projection into the depth program, which is left
+	// in use - false when the view does not need to be rendered
+	bool BeginView(LAYER layer, int view);
+	// point light a view belongs to, -1 for the directional light
+	static int GetViewPointLight(int view);
+	// mark the maps rendered and restore the framebuffer
+	void EndUpdate();
+
+	// add the transform of a caster drawn this frame to the maps
+	// it reaches - the directional light's map, and point light i
+	// when bit i of pointLightMask is set
+	void TrackCaster(CASTER caster, int mesh, const glm::mat4& model, int pointLightMask);
+	// compare the casters of the frame with the last frame, and
+	// mark the layers of the maps whose casters changed
+	void EndFrame();
+
+	// point the sampler uniforms of the program in use at the
+	// texture units [firstUnit, firstUnit + TEXTURE_UNIT_COUNT)
+	static void SetSamplerUnits(GLuint programID, int firstUnit);
+	// bind the final layer to the units given to SetSamplerUnits()
+	void Bind(int firstUnit);
+	// world position to coordinates of the directional light's map
+	const glm::mat4& GetDirectionalShadowMatrix() const { return(m_directionalShadowMatrix); }
+	// bit i is set when point light i has a map
+	int GetPointShadowMask() const;
+	// free the maps and the program
+	void Destroy();
+
+private:
+	// the depth textures of a layer
+	enum TARGET
+	{
+		TARGET_DIRECTIONAL = 0,
+		TARGET_POINT_ATLAS,
+		TARGET_COUNT
+	};
+
+	// the light a map was last rendered for
+	struct MAP_LIGHT
+	{
+		bool bActive;
+		// direction of the directional light, or point light position
+		glm::vec3 vector;
+		float range;
+	};
+
+	// compute the views of the directional light's map
+	void BuildDirectionalView(const glm::vec3& direction);
+	// compute the cube face views of a point light
+	void BuildPointViews(int pointLight, const glm::vec3& position, float range);
+
+	// depth textures and the framebuffers rendering into them
+	GLuint m_textureIDs[LAYER_COUNT][TARGET_COUNT];
+	GLuint m_framebufferIDs[LAYER_COUNT][TARGET_COUNT];
+	// program drawing the casters
+	GLuint m_program;
+	GLint m_lightViewProjectionLocation;
+	// light view and projection of every view
+	glm::mat4 m_viewProjections[VIEW_COUNT];
+	// world to texture coordinates of the directional map
+	glm::mat4 m_directionalShadowMatrix;
+	// scene box covered by the directional map
+	glm::vec3 m_sceneMinimum;
+	glm::vec3 m_sceneMaximum;
+	// lights the maps were rendered for
+	MAP_LIGHT m_mapLights[MAP_COUNT];
+	// maps whose layer must be rendered
+	bool m_bDirty[LAYER_COUNT][MAP_COUNT];
+	// viewport saved by BeginUpdate()
+	GLint m_viewport[4];
+	// hash and number of the casters of each kind reaching each
+	// map, for this frame while it is drawn and for the last frame
+	uint64_t m_casterHashes[CASTER_DYNAMIC + 1][MAP_COUNT];
+	int m_casterCounts[CASTER_DYNAMIC + 1][MAP_COUNT];
+	uint64_t m_frameCasterHashes[CASTER_DYNAMIC + 1][MAP_COUNT];
+	int m_frameCasterCounts[CASTER_DYNAMIC + 1][MAP_COUNT];
+	// false until the casters of a first frame were tracked
+	bool m_bCastersKnown;
+};
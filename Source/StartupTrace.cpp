@@ -0,0 +1,227 @@
+///////////////////////////////////////////////////////////////////////////////
+// startuptrace.cpp
+// ============
+// record the startup phases and write them as a Chrome trace
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StartupTrace.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+// declaration of global variables
+namespace
+{
+	struct TRACE_EVENT
+	{
+		std::string name;
+		const char* category;
+		int64_t startMicroseconds;
+		int64_t durationMicroseconds;
+		int threadIndex;
+	};
+
+	// category of the phases listed in the summary line
+	const char* const g_SummaryCategory = "main";
+
+	// launch time, static initialization runs before main()
+	const std::chrono::steady_clock::time_point g_LaunchTime = std::chrono::steady_clock::now();
+	// the thread running the static initialization is main
+	const std::thread::id g_MainThreadID = std::this_thread::get_id();
+
+	std::mutex g_TraceMutex;
+	std::vector<TRACE_EVENT> g_Events;
+	// small trace thread ids in the order the threads recorded
+	std::map<std::thread::id, int> g_ThreadIndices;
+	// no trace file is written unless one is set
+	std::string g_OutputFile;
+	std::atomic<bool> g_bRecording(true);
+
+	// escape a string for a JSON value
+	std::string EscapeJSON(const std::string& text)
+	{
+		std::string escaped;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			if ((text[i] == '"') || (text[i] == '\\'))
+			{
+				escaped += '\\';
+			}
+			escaped += text[i];
+		}
+		return(escaped);
+	}
+}
+
+/***********************************************************
+ *  Scope()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StartupTrace::Scope::Scope(const std::string& name, const char* category)
+{
+	m_category = category;
+	m_startMicroseconds = -1;
+	if (IsRecording())
+	{
+		m_name = name;
+		m_startMicroseconds = GetMicroseconds();
+	}
+}
+
+/***********************************************************
+ *  ~Scope()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StartupTrace::Scope::~Scope()
+{
+	if (m_startMicroseconds >= 0)
+	{
+		AddEvent(m_name, m_category, m_startMicroseconds, GetMicroseconds());
+	}
+}
+
+/***********************************************************
+ *  SetOutputFile()
+ *
+ *  This method is used for setting the name of the trace
+ *  file.  Without a name, the default, only the summary is
+ *  printed.
+ ***********************************************************/
+void StartupTrace::SetOutputFile(const char* filename)
+{
+	std::lock_guard<std::mutex> lock(g_TraceMutex);
+	g_OutputFile = filename;
+}
+
+/***********************************************************
+ *  GetMicroseconds()
+ *
+ *  This method is used for getting the time since the
+ *  process was launched.
+ ***********************************************************/
+int64_t StartupTrace::GetMicroseconds()
+{
+	return(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_LaunchTime).count());
+}
+
+/***********************************************************
+ *  IsRecording()
+ *
+ *  This method is used for checking whether phases are
+ *  still recorded.
+ ***********************************************************/
+bool StartupTrace::IsRecording()
+{
+	return(g_bRecording);
+}
+
+/***********************************************************
+ *  AddEvent()
+ *
+ *  This method is used for recording a finished phase on
+ *  the calling thread.
+ ***********************************************************/
+void StartupTrace::AddEvent(const std::string& name, const char* category, int64_t startMicroseconds, int64_t endMicroseconds)
+{
+	if (IsRecording() == false)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(g_TraceMutex);
+	std::thread::id threadID = std::this_thread::get_id();
+	std::map<std::thread::id, int>::iterator thread = g_ThreadIndices.find(threadID);
+	if (thread == g_ThreadIndices.end())
+	{
+		int threadIndex = (threadID == g_MainThreadID) ? 0 : (int)g_ThreadIndices.size() + 1;
+		thread = g_ThreadIndices.insert(std::make_pair(threadID, threadIndex)).first;
+	}
+
+	TRACE_EVENT event;
+	event.name = name;
+	event.category = category;
+	event.startMicroseconds = startMicroseconds;
+	event.durationMicroseconds = endMicroseconds - startMicroseconds;
+	event.threadIndex = thread->second;
+	g_Events.push_back(event);
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for ending the trace at the first
+ *  frame.  The events are written as complete ("X") events
+ *  of the Chrome trace event format, and the time to the
+ *  first frame is printed with the top level phases.
+ ***********************************************************/
+void StartupTrace::Finish()
+{
+	if (g_bRecording.exchange(false) == false)
+	{
+		return;
+	}
+	int64_t firstFrameMicroseconds = GetMicroseconds();
+
+	std::lock_guard<std::mutex> lock(g_TraceMutex);
+	if (g_OutputFile.size() > 0)
+	{
+		std::ofstream file(g_OutputFile.c_str(), std::ios::trunc);
+		if (!file)
+		{
+			std::cout << "Could not write startup trace:" << g_OutputFile << std::endl;
+		}
+		else
+		{
+			file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+			file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"main\"}}";
+			std::map<std::thread::id, int>::iterator thread;
+			for (thread = g_ThreadIndices.begin(); thread != g_ThreadIndices.end(); thread++)
+			{
+				if (thread->second != 0)
+				{
+					file << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->second
+						<< ",\"args\":{\"name\":\"worker " << thread->second << "\"}}";
+				}
+			}
+			for (size_t i = 0; i < g_Events.size(); i++)
+			{
+				const TRACE_EVENT& event = g_Events[i];
+				file << "," << std::endl << "{\"name\":\"" << EscapeJSON(event.name) << "\",\"cat\":\"" << event.category
+					<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.threadIndex
+					<< ",\"ts\":" << event.startMicroseconds << ",\"dur\":" << event.durationMicroseconds << "}";
+			}
+			file << "," << std::endl << "{\"name\":\"first frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":" << firstFrameMicroseconds << "}";
+			file << std::endl << "]}" << std::endl;
+		}
+	}
+
+	// one line with the main phases in the order they ran
+	std::cout << std::fixed << std::setprecision(1) << "Startup: " << firstFrameMicroseconds / 1000.0 << " ms to first frame (";
+	bool bFirst = true;
+	for (size_t i = 0; i < g_Events.size(); i++)
+	{
+		if (std::string(g_Events[i].category) == g_SummaryCategory)
+		{
+			std::cout << (bFirst ? "" : ", ") << g_Events[i].name << " " << g_Events[i].durationMicroseconds / 1000.0;
+			bFirst = false;
+		}
+	}
+	std::cout << ")";
+	if (g_OutputFile.size() > 0)
+	{
+		std::cout << ", trace:" << g_OutputFile;
+	}
+	std::cout << std::defaultfloat << std::setprecision(6) << std::endl;
+
+	g_Events.clear();
+}
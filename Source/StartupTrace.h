@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// startuptrace.h
+// ============
+// record the startup phases and write them as a Chrome trace
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+/***********************************************************
+ *  StartupTrace
+ *
+ *  This class records how long each phase of the startup
+ *  takes, from the launch of the process to the first
+ *  presented frame.  A one-line summary is printed, and
+ *  when an output file is set the phases are also written
+ *  as a Chrome trace JSON file, which opens in
+ *  chrome://tracing or Perfetto.  Phases can be recorded
+ *  from any thread.
+ ***********************************************************/
+class StartupTrace
+{
+public:
+	/***********************************************************
+	 *  Scope
+	 *
+	 *  Records one phase from its construction until it goes
+	 *  out of scope.
+	 ***********************************************************/
+	class Scope
+	{
+	public:
+		// start timing a phase
+		Scope(const std::string& name, const char* category);
+		// record the phase
+		~Scope();
+
+	private:
+		std::string m_name;
+		const char* m_category;
+		int64_t m_startMicroseconds;
+
+		// a phase is recorded once
+		Scope(const Scope&);
+		Scope& operator=(const Scope&);
+	};
+
+	// set the trace file written at the first frame
+	static void SetOutputFile(const char* filename);
+	// record a phase, times are microseconds since launch
+	static void AddEvent(const std::string& name, const char* category, int64_t startMicroseconds, int64_t endMicroseconds);
+	// microseconds since the process was launched
+	static int64_t GetMicroseconds();
+	// stop recording, write the trace and print the summary,
+	// called once the first frame has been presented
+	static void Finish();
+	// true until Finish() is called
+	static bool IsRecording();
+};
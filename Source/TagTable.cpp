@@ -0,0 +1,44 @@
+///////////////////////////////////////////////////////////////////////////////
+// tagtable.cpp
+// ============
+// intern texture and material tag strings as small integer handles
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TagTable.h"
+
+/***********************************************************
+ *  Intern()
+ *
+ *  This method is used for getting the handle of a tag.
+ *  A tag seen for the first time gets the next handle.
+ ***********************************************************/
+int TagTable::Intern(const std::string& tag)
+{
+	std::unordered_map<std::string, int>::iterator found = m_handles.find(tag);
+	if (found != m_handles.end())
+	{
+		return(found->second);
+	}
+
+	int handle = (int)m_names.size();
+	m_names.push_back(tag);
+	m_handles[tag] = handle;
+	return(handle);
+}
+
+/***********************************************************
+ *  Find()
+ *
+ *  This method is used for getting the handle of a tag
+ *  without adding it.
+ ***********************************************************/
+int TagTable::Find(const std::string& tag) const
+{
+	std::unordered_map<std::string, int>::const_iterator found = m_handles.find(tag);
+	if (found == m_handles.end())
+	{
+		return(INVALID_HANDLE);
+	}
+	return(found->second);
+}
@@ -0,0 +1,41 @@
+///////////////////////////////////////////////////////////////////////////////
+// tagtable.h
+// ============
+// intern texture and material tag strings as small integer handles
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/***********************************************************
+ *  TagTable
+ *
+ *  This class gives every distinct tag string a handle,
+ *  numbered from 0 in the order the tags are first seen.
+ *  Tags are resolved once while the scene is prepared, and
+ *  the handles then index plain arrays, so drawing does
+ *  not hash or compare strings.
+ ***********************************************************/
+class TagTable
+{
+public:
+	// handle of a tag that was never interned
+	static const int INVALID_HANDLE = -1;
+
+	// get the handle of a tag, adding it if it is new
+	int Intern(const std::string& tag);
+	// get the handle of a tag, INVALID_HANDLE if it is unknown
+	int Find(const std::string& tag) const;
+	// get the tag string of a handle
+	const std::string& GetName(int handle) const { return(m_names[handle]); }
+
+private:
+	// tag strings, indexed by handle
+	std::vector<std::string> m_names;
+	// handle of each tag string
+	std::unordered_map<std::string, int> m_handles;
+};
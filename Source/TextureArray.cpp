@@ -0,0 +1,376 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturearray.cpp
+// ============
+// pack scene textures of the same size and format into GL_TEXTURE_2D_ARRAYs
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureArray.h"
+#include "TextureFormat.h"
+#include "MipChain.h"
+
+#include <iostream>
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	/***********************************************************
+	 *  GetArrayChannels()
+	 *
+	 *  Channels stored in the array for an image, RGB images
+	 *  are padded to RGBA like the drivers store them.
+	 ***********************************************************/
+	int GetArrayChannels(int colorChannels)
+	{
+		return((colorChannels == 3) ? 4 : colorChannels);
+	}
+
+	/***********************************************************
+	 *  ResampleImage()
+	 *
+	 *  Bilinear resample of an image to a new size.  Only used
+	 *  for sizes within a factor of two, larger reductions are
+	 *  box filtered by a MipChain first.
+	 ***********************************************************/
+	void ResampleImage(
+		const unsigned char* source, int sourceWidth, int sourceHeight, int colorChannels,
+		unsigned char* destination, int width, int height)
+	{
+		float scaleX = (float)sourceWidth / (float)width;
+		float scaleY = (float)sourceHeight / (float)height;
+
+		for (int y = 0; y < height; y++)
+		{
+			// sample at the texel centers of the source image
+			float sourceY = std::max(((float)y + 0.5f) * scaleY - 0.5f, 0.0f);
+			int y0 = std::min((int)sourceY, sourceHeight - 1);
+			int y1 = std::min(y0 + 1, sourceHeight - 1);
+			float fy = sourceY - (float)y0;
+
+			for (int x = 0; x < width; x++)
+			{
+				float sourceX = std::max(((float)x + 0.5f) * scaleX - 0.5f, 0.0f);
+				int x0 = std::min((int)sourceX, sourceWidth - 1);
+				int x1 = std::min(x0 + 1, sourceWidth - 1);
+				float fx = sourceX - (float)x0;
+
+				for (int c = 0; c < colorChannels; c++)
+				{
+					float top = source[(y0 * sourceWidth + x0) * colorChannels + c] * (1.0f - fx) + source[(y0 * sourceWidth + x1) * colorChannels + c] * fx;
+					float bottom = source[(y1 * sourceWidth + x0) * colorChannels + c] * (1.0f - fx) + source[(y1 * sourceWidth + x1) * colorChannels + c] * fx;
+					destination[(y * width + x) * colorChannels + c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  CopyToArrayFormat()
+	 *
+	 *  Copy an image in the channel layout of its array, RGB
+	 *  images get an opaque alpha channel.
+	 ***********************************************************/
+	void CopyToArrayFormat(const unsigned char* pixels, int width, int height, int colorChannels, std::vector<unsigned char>& output)
+	{
+		size_t texels = (size_t)width * height;
+		if (colorChannels != 3)
+		{
+			output.assign(pixels, pixels + texels * colorChannels);
+			return;
+		}
+
+		output.resize(texels * 4);
+		for (size_t i = 0; i < texels; i++)
+		{
+			output[i * 4 + 0] = pixels[i * 3 + 0];
+			output[i * 4 + 1] = pixels[i * 3 + 1];
+			output[i * 4 + 2] = pixels[i * 3 + 2];
+			output[i * 4 + 3] = 255;
+		}
+	}
+}
+
+
+/***********************************************************
+ *  TextureArray()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureArray::TextureArray()
+{
+	m_maxLayerSize = 1024;
+	m_bBuilt = false;
+}
+
+/***********************************************************
+ *  ~TextureArray()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureArray::~TextureArray()
+{
+	m_layers.clear();
+}
+
+/***********************************************************
+ *  SetMaxLayerSize()
+ *
+ *  This method is used for limiting the size of the layers.
+ *  Larger images are reduced when they are added.
+ ***********************************************************/
+void TextureArray::SetMaxLayerSize(int maxLayerSize)
+{
+	m_maxLayerSize = std::max(maxLayerSize, 1);
+}
+
+/***********************************************************
+ *  AddImage()
+ *
+ *  This method is used for adding a decoded image to the
+ *  array of its size and format.  An image larger than the
+ *  layer size limit is box filtered down to the first mip
+ *  level that fits.  The image is copied so the caller can
+ *  free its data right away.
+ ***********************************************************/
+int TextureArray::AddImage(const unsigned char* pixels, int width, int height, int colorChannels)
+{
+	if (IsBuilt() || (NULL == pixels) || (width < 1) || (height < 1) || (colorChannels < 1) || (colorChannels > 4))
+	{
+		return(-1);
+	}
+
+	MipChain mipChain;
+	if ((width > m_maxLayerSize) || (height > m_maxLayerSize))
+	{
+		mipChain.Generate(pixels, width, height, colorChannels);
+		int level = 1;
+		while ((level < mipChain.GetLevelCount() - 1) &&
+			((mipChain.GetLevel(level).width > m_maxLayerSize) || (mipChain.GetLevel(level).height > m_maxLayerSize)))
+		{
+			level++;
+		}
+		pixels = mipChain.GetLevelData(level);
+		width = mipChain.GetLevel(level).width;
+		height = mipChain.GetLevel(level).height;
+	}
+
+	int bucket = FindBucket(width, height, GetArrayChannels(colorChannels));
+	if (bucket < 0)
+	{
+		return(-1);
+	}
+
+	ARRAY_LAYER layer;
+	layer.bucket = bucket;
+	layer.arrayLayer = m_buckets[bucket].layerCount++;
+	CopyToArrayFormat(pixels, width, height, colorChannels, layer.pixels);
+	m_layers.push_back(layer);
+
+	return((int)m_layers.size() - 1);
+}
+
+/***********************************************************
+ *  FindBucket()
+ *
+ *  This method is used for getting the array that holds
+ *  images of a size and format, adding it when it is the
+ *  first such image.
+ ***********************************************************/
+int TextureArray::FindBucket(int width, int height, int colorChannels)
+{
+	for (size_t i = 0; i < m_buckets.size(); i++)
+	{
+		if ((m_buckets[i].width == width) && (m_buckets[i].height == height) && (m_buckets[i].colorChannels == colorChannels))
+		{
+			GLint maxLayers = 0;
+			glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+			if (m_buckets[i].layerCount >= maxLayers)
+			{
+				std::cout << "Texture array " << width << "x" << height << " is full, " << maxLayers << " layers" << std::endl;
+				return(-1);
+			}
+			return((int)i);
+		}
+	}
+
+	ARRAY_BUCKET bucket;
+	bucket.textureID = 0;
+	bucket.width = width;
+	bucket.height = height;
+	bucket.colorChannels = colorChannels;
+	bucket.layerCount = 0;
+	m_buckets.push_back(bucket);
+
+	return((int)m_buckets.size() - 1);
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for uploading every added image into
+ *  the layer of its array texture.
+ ***********************************************************/
+bool TextureArray::Build()
+{
+	if (IsBuilt() || (m_layers.size() == 0))
+	{
+		return(false);
+	}
+
+	GLint previousTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousTexture);
+	// rows of R8 and RG8 layers are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (size_t b = 0; b < m_buckets.size(); b++)
+	{
+		ARRAY_BUCKET& bucket = m_buckets[b];
+		glGenTextures(1, &bucket.textureID);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, bucket.textureID);
+
+		// set the texture wrapping parameters
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		// R8 and RG8 layers are sampled as gray colors
+		TextureFormat::ApplySwizzle(GL_TEXTURE_2D_ARRAY, bucket.colorChannels);
+
+		GLenum format = TextureFormat::GetFormat(bucket.colorChannels);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, TextureFormat::GetInternalFormat(bucket.colorChannels),
+			bucket.width, bucket.height, bucket.layerCount, 0, format, GL_UNSIGNED_BYTE, NULL);
+
+		for (size_t i = 0; i < m_layers.size(); i++)
+		{
+			if (m_layers[i].bucket != (int)b)
+			{
+				continue;
+			}
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, m_layers[i].arrayLayer, bucket.width, bucket.height, 1, format, GL_UNSIGNED_BYTE, m_layers[i].pixels.data());
+
+			// the copy is not needed after the upload
+			std::vector<unsigned char>().swap(m_layers[i].pixels);
+		}
+
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+		std::cout << "Built texture array: " << bucket.layerCount << " layers of " << bucket.width << "x" << bucket.height << " " << TextureFormat::GetName(bucket.colorChannels) << std::endl;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, (GLuint)previousTexture);
+	m_bBuilt = true;
+
+	return(true);
+}
+
+/***********************************************************
+ *  UpdateImage()
+ *
+ *  This method is used for replacing the image stored in a
+ *  layer of a built array.  An image of another size is
+ *  box filtered to within twice the layer size and then
+ *  resampled to it.  The image must keep the format of its
+ *  array.  The mipmaps of every layer of the array are
+ *  generated again.
+ ***********************************************************/
+bool TextureArray::UpdateImage(int layer, const unsigned char* pixels, int width, int height, int colorChannels)
+{
+	if ((IsBuilt() == false) || (layer < 0) || (layer >= (int)m_layers.size()) ||
+		(NULL == pixels) || (width < 1) || (height < 1) || (colorChannels < 1) || (colorChannels > 4))
+	{
+		return(false);
+	}
+
+	const ARRAY_BUCKET& bucket = m_buckets[m_layers[layer].bucket];
+	if (GetArrayChannels(colorChannels) != bucket.colorChannels)
+	{
+		std::cout << "Image no longer matches the " << TextureFormat::GetName(bucket.colorChannels) << " texture array of its layer" << std::endl;
+		return(false);
+	}
+
+	// the smallest mip level that is still at least the layer size
+	MipChain mipChain;
+	if ((width >= bucket.width * 2) && (height >= bucket.height * 2))
+	{
+		mipChain.Generate(pixels, width, height, colorChannels);
+		int level = 1;
+		while ((level < mipChain.GetLevelCount() - 1) &&
+			(mipChain.GetLevel(level + 1).width >= bucket.width) && (mipChain.GetLevel(level + 1).height >= bucket.height))
+		{
+			level++;
+		}
+		pixels = mipChain.GetLevelData(level);
+		width = mipChain.GetLevel(level).width;
+		height = mipChain.GetLevel(level).height;
+	}
+
+	std::vector<unsigned char> converted;
+	CopyToArrayFormat(pixels, width, height, colorChannels, converted);
+	if ((width != bucket.width) || (height != bucket.height))
+	{
+		std::vector<unsigned char> resampled((size_t)bucket.width * bucket.height * bucket.colorChannels);
+		ResampleImage(converted.data(), width, height, bucket.colorChannels, resampled.data(), bucket.width, bucket.height);
+		converted.swap(resampled);
+	}
+
+	// the array may be bound to the active unit for drawing,
+	// so put back whatever was bound there
+	GLint previousTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, bucket.textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, m_layers[layer].arrayLayer, bucket.width, bucket.height, 1,
+		TextureFormat::GetFormat(bucket.colorChannels), GL_UNSIGNED_BYTE, converted.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, (GLuint)previousTexture);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the array textures.
+ ***********************************************************/
+void TextureArray::Destroy()
+{
+	for (size_t i = 0; i < m_buckets.size(); i++)
+	{
+		if (m_buckets[i].textureID != 0)
+		{
+			glDeleteTextures(1, &m_buckets[i].textureID);
+		}
+	}
+	m_buckets.clear();
+	m_layers.clear();
+	m_bBuilt = false;
+}
+
+/***********************************************************
+ *  GetLayerBytes()
+ *
+ *  This method is used for getting the GPU memory used by
+ *  one layer, including its mipmaps.
+ ***********************************************************/
+size_t TextureArray::GetLayerBytes(int layer) const
+{
+	const ARRAY_BUCKET& bucket = m_buckets[m_layers[layer].bucket];
+	size_t total = 0;
+	int width = bucket.width;
+	int height = bucket.height;
+	while ((width > 0) && (height > 0))
+	{
+		total += (size_t)width * height * bucket.colorChannels;
+		if ((width == 1) && (height == 1))
+		{
+			break;
+		}
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	return(total);
+}
@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturearray.h
+// ============
+// pack scene textures of the same size and format into GL_TEXTURE_2D_ARRAYs
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstddef>
+
+/***********************************************************
+ *  TextureArray
+ *
+ *  This class collects decoded images and packs the ones
+ *  with the same size and format into the layers of one
+ *  array texture, so no image is resampled to fit another
+ *  and R8 and RG8 images keep their smaller formats.
+ *  Images larger than the layer size limit are reduced to
+ *  the first mip level that fits.  The arrays take turns on
+ *  one texture unit and materials pick their texture by
+ *  layer handle.
+ ***********************************************************/
+class TextureArray
+{
+public:
+	// constructor
+	TextureArray();
+	// destructor
+	~TextureArray();
+
+	// set the largest width and height used for the layers
+	void SetMaxLayerSize(int maxLayerSize);
+	// add an image and return the handle of its layer, or -1 if
+	// the arrays were already built or the matching one is full
+	int AddImage(const unsigned char* pixels, int width, int height, int colorChannels);
+	// upload all of the added images into their array textures
+	bool Build();
+	// replace the image of a layer after the arrays were built
+	bool UpdateImage(int layer, const unsigned char* pixels, int width, int height, int colorChannels);
+	// free the array textures
+	void Destroy();
+
+	bool IsBuilt() const { return(m_bBuilt); }
+	int GetLayerCount() const { return((int)m_layers.size()); }
+	// array texture holding a layer, 0 until built
+	GLuint GetTextureID(int layer) const { return(m_buckets[m_layers[layer].bucket].textureID); }
+	// index of a layer within its array texture
+	int GetArrayLayer(int layer) const { return(m_layers[layer].arrayLayer); }
+	// GPU memory used by a layer, including its mipmaps
+	size_t GetLayerBytes(int layer) const;
+
+private:
+	// one array texture, holding the images of one size and format
+	struct ARRAY_BUCKET
+	{
+		// array texture, 0 until built
+		GLuint textureID;
+		int width;
+		int height;
+		// 1 for R8, 2 for RG8 and 4 for RGBA8
+		int colorChannels;
+		int layerCount;
+	};
+
+	struct ARRAY_LAYER
+	{
+		// copy of the image in the format of its array, freed
+		// after the build
+		std::vector<unsigned char> pixels;
+		int bucket;
+		int arrayLayer;
+	};
+
+	// find or add the array for a size and format, -1 when full
+	int FindBucket(int width, int height, int colorChannels);
+
+	// arrays by size and format
+	std::vector<ARRAY_BUCKET> m_buckets;
+	// images added to the arrays, indexed by layer handle
+	std::vector<ARRAY_LAYER> m_layers;
+	// largest allowed layer width and height
+	int m_maxLayerSize;
+	// true once the array textures are uploaded
+	bool m_bBuilt;
+};
@@ -0,0 +1,382 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturebenchmark.cpp
+// ============
+// command line benchmarks for the texture loading paths
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureBenchmark.h"
+#include "TextureContainer.h"
+#include "TextureDecodePool.h"
+#include "MipChain.h"
+#include "ImageDecoder.h"
+
+#include <GL/glew.h>
+#include "GLFW/glfw3.h"
+
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// hidden window that owns the benchmark context
+	GLFWwindow* g_BenchmarkWindow = nullptr;
+	// each measurement is repeated and the median is reported
+	const int g_Repetitions = 5;
+
+	// milliseconds elapsed since a start time
+	double ElapsedMilliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	// median of a list of measurements
+	double Median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return(values[values.size() / 2]);
+	}
+
+	// nearest rank percentile of sorted measurements
+	double Percentile(const std::vector<double>& sortedValues, double percent)
+	{
+		size_t rank = (size_t)std::ceil(percent / 100.0 * sortedValues.size());
+		return(sortedValues[std::min(std::max(rank, (size_t)1), sortedValues.size()) - 1]);
+	}
+
+	// image file loaded into memory for the decoder benchmark
+	struct BENCHMARK_FILE
+	{
+		std::string name;
+		// lower case file extension, used to group the results
+		std::string format;
+		std::vector<unsigned char> bytes;
+	};
+
+	// average of the color channels of the 1x1 level of the
+	// bound texture, used to compare the brightness of the
+	// smallest mip level between the two paths
+	float ReadSmallestLevelAverage(int levelCount, int colorChannels)
+	{
+		unsigned char texel[4] = { 0, 0, 0, 0 };
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glGetTexImage(GL_TEXTURE_2D, levelCount - 1, (colorChannels == 4) ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, texel);
+		return((texel[0] + texel[1] + texel[2]) / 3.0f);
+	}
+}
+
+/***********************************************************
+ *  CreateHiddenContext()
+ *
+ *  This method is used for creating an invisible window so
+ *  the benchmarks have an OpenGL context to upload into.
+ ***********************************************************/
+bool TextureBenchmark::CreateHiddenContext()
+{
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	g_BenchmarkWindow = glfwCreateWindow(64, 64, "Texture Benchmark", NULL, NULL);
+	if (NULL == g_BenchmarkWindow)
+	{
+		std::cout << "Failed to create GLFW window for the benchmark" << std::endl;
+		glfwTerminate();
+		return(false);
+	}
+	glfwMakeContextCurrent(g_BenchmarkWindow);
+
+	GLenum GLEWInitResult = glewInit();
+	if (GLEW_OK != GLEWInitResult)
+	{
+		std::cerr << glewGetErrorString(GLEWInitResult) << std::endl;
+		DestroyHiddenContext();
+		return(false);
+	}
+
+	std::cout << "INFO: OpenGL Renderer: " << glGetString(GL_RENDERER) << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  DestroyHiddenContext()
+ *
+ *  This method is used for destroying the hidden window.
+ ***********************************************************/
+void TextureBenchmark::DestroyHiddenContext()
+{
+	if (NULL != g_BenchmarkWindow)
+	{
+		glfwDestroyWindow(g_BenchmarkWindow);
+		g_BenchmarkWindow = NULL;
+	}
+	glfwTerminate();
+}
+
+/***********************************************************
+ *  RunMipmapBenchmark()
+ *
+ *  This method is used for timing the two ways a decoded
+ *  image gets its mip chain: glTexImage2D() followed by
+ *  glGenerateMipmap(), and MipChain::Generate() followed by
+ *  MipChain::Upload().  glFinish() is called before each
+ *  timer stops so the driver work is included.  The
+ *  brightness of the 1x1 level shows the gamma-space
+ *  darkening of the driver path.
+ ***********************************************************/
+int TextureBenchmark::RunMipmapBenchmark(const char* directory)
+{
+	if (CreateHiddenContext() == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	std::cout << "Mipmap benchmark, CPU path uses " << MipChain::GetInstructionSet()
+		<< ", median of " << g_Repetitions << " runs" << std::endl;
+	std::cout << std::left << std::setw(28) << "image" << std::right
+		<< std::setw(12) << "size"
+		<< std::setw(12) << "driver ms"
+		<< std::setw(12) << "build ms"
+		<< std::setw(12) << "upload ms"
+		<< std::setw(12) << "cpu ms"
+		<< std::setw(10) << "driver 1x1"
+		<< std::setw(10) << "cpu 1x1" << std::endl;
+
+	GLuint textureID = 0;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	double driverTotal = 0.0;
+	double cpuTotal = 0.0;
+	int imageCount = 0;
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error))
+	{
+		if ((entry.is_regular_file() == false) || (TextureContainer::IsImageFile(entry.path().string()) == false))
+		{
+			continue;
+		}
+
+		std::vector<unsigned char> fileBytes;
+		if (TextureDecodePool::ReadImageFile(entry.path().string().c_str(), fileBytes) == false)
+		{
+			continue;
+		}
+		int width = 0;
+		int height = 0;
+		int colorChannels = 0;
+		unsigned char* image = ImageDecoder::DecodeImage(fileBytes.data(), fileBytes.size(), width, height, colorChannels);
+		if (NULL == image)
+		{
+			continue;
+		}
+		if ((colorChannels != 3) && (colorChannels != 4))
+		{
+			ImageDecoder::FreeImage(image);
+			continue;
+		}
+		GLenum internalFormat = (colorChannels == 4) ? GL_RGBA8 : GL_RGB8;
+		GLenum format = (colorChannels == 4) ? GL_RGBA : GL_RGB;
+
+		std::vector<double> driverTimes;
+		std::vector<double> buildTimes;
+		std::vector<double> uploadTimes;
+		float driverAverage = 0.0f;
+		float cpuAverage = 0.0f;
+		int levelCount = 0;
+		for (int run = 0; run < g_Repetitions; run++)
+		{
+			// driver path, the way the textures were always loaded
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, image);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glFinish();
+			driverTimes.push_back(ElapsedMilliseconds(start));
+
+			// CPU path, building is done on the decode threads in the
+			// scene so it is reported apart from the upload
+			start = std::chrono::steady_clock::now();
+			MipChain mipChain;
+			mipChain.Generate(image, width, height, colorChannels);
+			buildTimes.push_back(ElapsedMilliseconds(start));
+			levelCount = mipChain.GetLevelCount();
+			driverAverage = ReadSmallestLevelAverage(levelCount, colorChannels);
+
+			start = std::chrono::steady_clock::now();
+			mipChain.Upload(image, internalFormat, format);
+			glFinish();
+			uploadTimes.push_back(ElapsedMilliseconds(start));
+			cpuAverage = ReadSmallestLevelAverage(levelCount, colorChannels);
+		}
+		ImageDecoder::FreeImage(image);
+
+		double driverTime = Median(driverTimes);
+		double buildTime = Median(buildTimes);
+		double uploadTime = Median(uploadTimes);
+		driverTotal += driverTime;
+		cpuTotal += buildTime + uploadTime;
+		imageCount++;
+
+		std::string size = std::to_string(width) + "x" + std::to_string(height);
+		std::cout << std::left << std::setw(28) << entry.path().filename().string() << std::right
+			<< std::setw(12) << size << std::fixed << std::setprecision(2)
+			<< std::setw(12) << driverTime
+			<< std::setw(12) << buildTime
+			<< std::setw(12) << uploadTime
+			<< std::setw(12) << buildTime + uploadTime
+			<< std::setw(10) << std::setprecision(1) << driverAverage
+			<< std::setw(10) << cpuAverage << std::endl;
+	}
+
+	glDeleteTextures(1, &textureID);
+	DestroyHiddenContext();
+
+	if (imageCount == 0)
+	{
+		std::cout << "No images found in:" << directory << std::endl;
+		return(EXIT_FAILURE);
+	}
+	std::cout << std::fixed << std::setprecision(2) << "Total for " << imageCount << " images: driver "
+		<< driverTotal << " ms, cpu " << cpuTotal << " ms" << std::endl;
+	return(EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *  RunDecoderBenchmark()
+ *
+ *  This method is used for decoding every image file in a
+ *  directory with each built in decoder backend.  The files
+ *  are read into memory first so only the decoding is
+ *  timed.  The results are grouped by backend and file
+ *  format, with the throughput measured on the compressed
+ *  input and the latency percentiles of single decodes.
+ ***********************************************************/
+int TextureBenchmark::RunDecoderBenchmark(const char* directory)
+{
+	std::vector<BENCHMARK_FILE> files;
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error))
+	{
+		if ((entry.is_regular_file() == false) || (TextureContainer::IsImageFile(entry.path().string()) == false))
+		{
+			continue;
+		}
+
+		BENCHMARK_FILE file;
+		if (TextureDecodePool::ReadImageFile(entry.path().string().c_str(), file.bytes) == false)
+		{
+			continue;
+		}
+		file.name = entry.path().filename().string();
+		file.format = entry.path().extension().string().substr(1);
+		for (size_t i = 0; i < file.format.size(); i++)
+		{
+			file.format[i] = (char)tolower((unsigned char)file.format[i]);
+		}
+		if (file.format == "jpeg")
+		{
+			file.format = "jpg";
+		}
+		files.push_back(file);
+	}
+	if (files.size() == 0)
+	{
+		std::cout << "No images found in:" << directory << std::endl;
+		return(EXIT_FAILURE);
+	}
+	std::sort(files.begin(), files.end(), [](const BENCHMARK_FILE& a, const BENCHMARK_FILE& b) { return(a.format < b.format); });
+
+	std::cout << "Decoder benchmark, " << files.size() << " images, " << g_Repetitions << " decodes each" << std::endl;
+	std::cout << std::left << std::setw(12) << "backend" << std::setw(8) << "format" << std::right
+		<< std::setw(8) << "files"
+		<< std::setw(10) << "in MB"
+		<< std::setw(10) << "MB/s"
+		<< std::setw(10) << "Mpix/s"
+		<< std::setw(10) << "p50 ms"
+		<< std::setw(10) << "p90 ms"
+		<< std::setw(10) << "p99 ms"
+		<< std::setw(10) << "max ms" << std::endl;
+
+	int failures = 0;
+	for (int backend = 0; backend < ImageDecoder::DECODER_BACKEND_COUNT; backend++)
+	{
+		const ImageDecoder* pDecoder = ImageDecoder::GetBackend((ImageDecoder::DECODER_BACKEND)backend);
+		if (NULL == pDecoder)
+		{
+			continue;
+		}
+
+		// the files are sorted, so each format is one run of files
+		size_t first = 0;
+		while (first < files.size())
+		{
+			size_t last = first;
+			while ((last < files.size()) && (files[last].format == files[first].format))
+			{
+				last++;
+			}
+
+			std::vector<double> latencies;
+			size_t fileCount = 0;
+			double inputBytes = 0.0;
+			double pixels = 0.0;
+			for (size_t i = first; i < last; i++)
+			{
+				const BENCHMARK_FILE& file = files[i];
+				if (pDecoder->CanDecode(file.bytes.data(), file.bytes.size()) == false)
+				{
+					continue;
+				}
+				fileCount++;
+				for (int run = 0; run < g_Repetitions; run++)
+				{
+					int width = 0;
+					int height = 0;
+					int colorChannels = 0;
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					unsigned char* image = pDecoder->Decode(file.bytes.data(), file.bytes.size(), width, height, colorChannels);
+					double latency = ElapsedMilliseconds(start);
+					if (NULL == image)
+					{
+						std::cout << "Could not decode image with " << pDecoder->GetName() << ":" << file.name << std::endl;
+						failures++;
+						break;
+					}
+					ImageDecoder::FreeImage(image);
+					latencies.push_back(latency);
+					inputBytes += (double)file.bytes.size();
+					pixels += (double)width * height;
+				}
+			}
+
+			if (latencies.size() > 0)
+			{
+				double totalSeconds = 0.0;
+				for (size_t i = 0; i < latencies.size(); i++)
+				{
+					totalSeconds += latencies[i] / 1000.0;
+				}
+				std::sort(latencies.begin(), latencies.end());
+
+				std::cout << std::left << std::setw(12) << pDecoder->GetName() << std::setw(8) << files[first].format << std::right
+					<< std::setw(8) << fileCount << std::fixed << std::setprecision(2)
+					<< std::setw(10) << inputBytes / g_Repetitions / (1024.0 * 1024.0)
+					<< std::setw(10) << inputBytes / (1024.0 * 1024.0) / totalSeconds
+					<< std::setw(10) << pixels / 1000000.0 / totalSeconds
+					<< std::setw(10) << Percentile(latencies, 50.0)
+					<< std::setw(10) << Percentile(latencies, 90.0)
+					<< std::setw(10) << Percentile(latencies, 99.0)
+					<< std::setw(10) << latencies.back() << std::endl;
+			}
+			first = last;
+		}
+	}
+
+	return((failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,33 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturebenchmark.h
+// ============
+// command line benchmarks for the texture loading paths
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+/***********************************************************
+ *  TextureBenchmark
+ *
+ *  This class runs the texture loading benchmarks that are
+ *  started from the command line.  Each benchmark prints a
+ *  table of results and returns the process exit code; the
+ *  ones that need OpenGL create their own hidden window.
+ ***********************************************************/
+class TextureBenchmark
+{
+public:
+	// compare glGenerateMipmap() with the CPU mip chain for
+	// every image in a directory
+	static int RunMipmapBenchmark(const char* directory);
+	// decode every image in a directory with each image
+	// decoder backend and report throughput and latency
+	static int RunDecoderBenchmark(const char* directory);
+
+private:
+	// create a hidden window with a current OpenGL context
+	static bool CreateHiddenContext();
+	// destroy the hidden window
+	static void DestroyHiddenContext();
+};
@@ -0,0 +1,489 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecompressor.cpp
+// ============
+// block compress texture images on the CPU and cache them on disk
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCompressor.h"
+#include "TextureContainer.h"
+#include "TextureFormat.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <cstdio>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// part of every cache file name, change it whenever the
+	// encoder output changes so stale cache files are not used
+	const char* g_EncoderSettings = "bcn1";
+	const char* g_CacheExtension = ".gltex";
+
+	// the texels of a 4x4 block, four channels each
+	typedef unsigned char BLOCK_TEXELS[16][4];
+
+	/***********************************************************
+	 *  LoadBlock()
+	 *
+	 *  Copy the texels of a block out of an image.  Blocks on
+	 *  the right and bottom edges repeat the last column and
+	 *  row, which keeps them out of the endpoint fit.
+	 ***********************************************************/
+	void LoadBlock(const unsigned char* pixels, int width, int height, int colorChannels, int blockX, int blockY, BLOCK_TEXELS& texels)
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			int sourceY = std::min(blockY * 4 + y, height - 1);
+			for (int x = 0; x < 4; x++)
+			{
+				int sourceX = std::min(blockX * 4 + x, width - 1);
+				const unsigned char* source = pixels + ((size_t)sourceY * width + sourceX) * colorChannels;
+				unsigned char* texel = texels[y * 4 + x];
+				for (int c = 0; c < 4; c++)
+				{
+					texel[c] = (c < colorChannels) ? source[c] : 255;
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  PackColor565()
+	 *
+	 *  Round an 8-bit RGB color to the 5:6:5 endpoint format.
+	 ***********************************************************/
+	uint16_t PackColor565(const float color[3])
+	{
+		int red = (int)std::floor(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		int green = (int)std::floor(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+		int blue = (int)std::floor(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		return((uint16_t)((red << 11) | (green << 5) | blue));
+	}
+
+	/***********************************************************
+	 *  UnpackColor565()
+	 *
+	 *  Expand a 5:6:5 endpoint to 8 bits per channel, the way
+	 *  the GPU decodes it.
+	 ***********************************************************/
+	void UnpackColor565(uint16_t packed, int color[3])
+	{
+		int red = (packed >> 11) & 31;
+		int green = (packed >> 5) & 63;
+		int blue = packed & 31;
+		color[0] = (red << 3) | (red >> 2);
+		color[1] = (green << 2) | (green >> 4);
+		color[2] = (blue << 3) | (blue >> 2);
+	}
+
+	/***********************************************************
+	 *  EncodeColorEndpoints()
+	 *
+	 *  Write a four color BC1 block for two endpoints, picking
+	 *  the closest palette entry for each texel.  Returns the
+	 *  squared error of the block.
+	 ***********************************************************/
+	int EncodeColorEndpoints(const BLOCK_TEXELS& texels, const float endpoint0[3], const float endpoint1[3], unsigned char* output)
+	{
+		uint16_t color0 = PackColor565(endpoint0);
+		uint16_t color1 = PackColor565(endpoint1);
+		// four color mode needs the first endpoint to be larger
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		int palette[4][3];
+		UnpackColor565(color0, palette[0]);
+		UnpackColor565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		uint32_t indices = 0;
+		int totalError = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int bestIndex = 0;
+			int bestError = 0x7fffffff;
+			// equal endpoints only have one usable color
+			int entries = (color0 == color1) ? 1 : 4;
+			for (int entry = 0; entry < entries; entry++)
+			{
+				int error = 0;
+				for (int c = 0; c < 3; c++)
+				{
+					int difference = (int)texels[i][c] - palette[entry][c];
+					error += difference * difference;
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					bestIndex = entry;
+				}
+			}
+			indices |= (uint32_t)bestIndex << (i * 2);
+			totalError += bestError;
+		}
+
+		output[0] = (unsigned char)(color0 & 0xFF);
+		output[1] = (unsigned char)(color0 >> 8);
+		output[2] = (unsigned char)(color1 & 0xFF);
+		output[3] = (unsigned char)(color1 >> 8);
+		for (int i = 0; i < 4; i++)
+		{
+			output[4 + i] = (unsigned char)((indices >> (i * 8)) & 0xFF);
+		}
+		return(totalError);
+	}
+
+	/***********************************************************
+	 *  EncodeColorBlock()
+	 *
+	 *  Encode the RGB channels of a block as BC1.  The
+	 *  endpoints start at the extremes of the texels along the
+	 *  principal axis of their colors, then are refitted once
+	 *  by least squares to the chosen palette entries.
+	 ***********************************************************/
+	void EncodeColorBlock(const BLOCK_TEXELS& texels, unsigned char* output)
+	{
+		float mean[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				mean[c] += texels[i][c] / 16.0f;
+			}
+		}
+
+		// covariance: rr, rg, rb, gg, gb, bb
+		float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+		{
+			float r = texels[i][0] - mean[0];
+			float g = texels[i][1] - mean[1];
+			float b = texels[i][2] - mean[2];
+			covariance[0] += r * r;
+			covariance[1] += r * g;
+			covariance[2] += r * b;
+			covariance[3] += g * g;
+			covariance[4] += g * b;
+			covariance[5] += b * b;
+		}
+
+		// power iteration for the principal axis
+		float axis[3] = { 1.0f, 1.0f, 1.0f };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[3];
+			next[0] = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+			next[1] = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+			next[2] = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+			float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+			if (length < 1e-6f)
+			{
+				break;
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				axis[c] = next[c] / length;
+			}
+		}
+
+		float minimum = 0.0f;
+		float maximum = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float projection = 0.0f;
+			for (int c = 0; c < 3; c++)
+			{
+				projection += (texels[i][c] - mean[c]) * axis[c];
+			}
+			minimum = std::min(minimum, projection);
+			maximum = std::max(maximum, projection);
+		}
+
+		float endpoint0[3];
+		float endpoint1[3];
+		for (int c = 0; c < 3; c++)
+		{
+			endpoint0[c] = mean[c] + axis[c] * maximum;
+			endpoint1[c] = mean[c] + axis[c] * minimum;
+		}
+		int error = EncodeColorEndpoints(texels, endpoint0, endpoint1, output);
+		if (error == 0)
+		{
+			return;
+		}
+
+		// refit the endpoints to the palette weights of each texel
+		static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		uint32_t indices = output[4] | (output[5] << 8) | (output[6] << 16) | ((uint32_t)output[7] << 24);
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		float ax[3] = { 0.0f, 0.0f, 0.0f };
+		float bx[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+		{
+			float weight = weights[(indices >> (i * 2)) & 3];
+			aa += weight * weight;
+			ab += weight * (1.0f - weight);
+			bb += (1.0f - weight) * (1.0f - weight);
+			for (int c = 0; c < 3; c++)
+			{
+				ax[c] += weight * texels[i][c];
+				bx[c] += (1.0f - weight) * texels[i][c];
+			}
+		}
+		float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f)
+		{
+			return;
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			endpoint0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+			endpoint1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+		}
+
+		unsigned char refined[8];
+		if (EncodeColorEndpoints(texels, endpoint0, endpoint1, refined) < error)
+		{
+			std::copy(refined, refined + 8, output);
+		}
+	}
+
+	/***********************************************************
+	 *  EncodeSingleChannelBlock()
+	 *
+	 *  Encode one channel of a block in the eight value BC4
+	 *  format, also used for the alpha of BC3 and for both
+	 *  channels of BC5.
+	 ***********************************************************/
+	void EncodeSingleChannelBlock(const BLOCK_TEXELS& texels, int channel, unsigned char* output)
+	{
+		int minimum = 255;
+		int maximum = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			minimum = std::min(minimum, (int)texels[i][channel]);
+			maximum = std::max(maximum, (int)texels[i][channel]);
+		}
+
+		// palette entries 2 to 7 interpolate from the first to the second endpoint
+		int palette[8];
+		palette[0] = maximum;
+		palette[1] = minimum;
+		for (int i = 1; i < 7; i++)
+		{
+			palette[i + 1] = ((7 - i) * maximum + i * minimum) / 7;
+		}
+
+		uint64_t indices = 0;
+		if (maximum != minimum)
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				int bestIndex = 0;
+				int bestError = 256;
+				for (int entry = 0; entry < 8; entry++)
+				{
+					int error = std::abs((int)texels[i][channel] - palette[entry]);
+					if (error < bestError)
+					{
+						bestError = error;
+						bestIndex = entry;
+					}
+				}
+				indices |= (uint64_t)bestIndex << (i * 3);
+			}
+		}
+
+		output[0] = (unsigned char)maximum;
+		output[1] = (unsigned char)minimum;
+		for (int i = 0; i < 6; i++)
+		{
+			output[2 + i] = (unsigned char)((indices >> (i * 8)) & 0xFF);
+		}
+	}
+
+	/***********************************************************
+	 *  GetBlockBytes()
+	 *
+	 *  Bytes of one 4x4 block of a compressed format.
+	 ***********************************************************/
+	size_t GetBlockBytes(GLenum internalFormat)
+	{
+		switch (internalFormat)
+		{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RED_RGTC1:
+			return(8);
+		default:
+			return(16);
+		}
+	}
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking that the driver can
+ *  sample the block formats.  BC4 and BC5 are core since
+ *  OpenGL 3.0; BC1 and BC3 need the S3TC extension.
+ ***********************************************************/
+bool TextureCompressor::IsSupported()
+{
+	return(GLEW_EXT_texture_compression_s3tc ? true : false);
+}
+
+/***********************************************************
+ *  ChooseFormat()
+ *
+ *  This method is used for choosing the block format for an
+ *  image.  Gray images use the single and dual channel
+ *  formats, and color images only pay for alpha when a
+ *  texel is not opaque.
+ ***********************************************************/
+GLenum TextureCompressor::ChooseFormat(const unsigned char* pixels, int width, int height, int colorChannels)
+{
+	if (colorChannels == 1)
+	{
+		return(GL_COMPRESSED_RED_RGTC1);
+	}
+	if (colorChannels == 2)
+	{
+		return(GL_COMPRESSED_RG_RGTC2);
+	}
+	if (colorChannels == 4)
+	{
+		size_t texels = (size_t)width * height;
+		for (size_t i = 0; i < texels; i++)
+		{
+			if (pixels[i * 4 + 3] != 255)
+			{
+				return(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+			}
+		}
+	}
+	return(GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+}
+
+/***********************************************************
+ *  GetLevelBytes()
+ *
+ *  This method is used for getting the size of a level in
+ *  a block format, partial blocks count as whole blocks.
+ ***********************************************************/
+size_t TextureCompressor::GetLevelBytes(GLenum internalFormat, int width, int height)
+{
+	size_t blocks = (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4);
+	return(blocks * GetBlockBytes(internalFormat));
+}
+
+/***********************************************************
+ *  CompressLevel()
+ *
+ *  This method is used for encoding every block of a level
+ *  into the output, which must hold GetLevelBytes() bytes.
+ ***********************************************************/
+void TextureCompressor::CompressLevel(GLenum internalFormat, const SOURCE_LEVEL& level, int colorChannels, unsigned char* output)
+{
+	int blocksX = (level.width + 3) / 4;
+	int blocksY = (level.height + 3) / 4;
+	for (int blockY = 0; blockY < blocksY; blockY++)
+	{
+		for (int blockX = 0; blockX < blocksX; blockX++)
+		{
+			BLOCK_TEXELS texels;
+			LoadBlock(level.pixels, level.width, level.height, colorChannels, blockX, blockY, texels);
+
+			switch (internalFormat)
+			{
+			case GL_COMPRESSED_RED_RGTC1:
+				EncodeSingleChannelBlock(texels, 0, output);
+				break;
+			case GL_COMPRESSED_RG_RGTC2:
+				EncodeSingleChannelBlock(texels, 0, output);
+				EncodeSingleChannelBlock(texels, 1, output + 8);
+				break;
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+				// the alpha block comes first
+				EncodeSingleChannelBlock(texels, 3, output);
+				EncodeColorBlock(texels, output + 8);
+				break;
+			default:
+				EncodeColorBlock(texels, output);
+				break;
+			}
+			output += GetBlockBytes(internalFormat);
+		}
+	}
+}
+
+/***********************************************************
+ *  WriteContainer()
+ *
+ *  This method is used for compressing every mip level of
+ *  an image and writing the blocks as a texture container.
+ *  The container keeps the uncompressed pixel format of the
+ *  image, so the swizzle of gray textures is still set.
+ ***********************************************************/
+bool TextureCompressor::WriteContainer(const char* filename, uint64_t sourceHash, const std::vector<SOURCE_LEVEL>& levels, int colorChannels)
+{
+	if ((levels.size() == 0) || (colorChannels < 1) || (colorChannels > 4))
+	{
+		return(false);
+	}
+
+	GLenum internalFormat = ChooseFormat(levels[0].pixels, levels[0].width, levels[0].height, colorChannels);
+
+	std::vector<std::vector<unsigned char> > compressed(levels.size());
+	std::vector<const unsigned char*> levelData;
+	std::vector<TextureContainer::CONTAINER_LEVEL> containerLevels;
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		compressed[i].resize(GetLevelBytes(internalFormat, levels[i].width, levels[i].height));
+		CompressLevel(internalFormat, levels[i], colorChannels, compressed[i].data());
+
+		TextureContainer::CONTAINER_LEVEL level;
+		level.width = levels[i].width;
+		level.height = levels[i].height;
+		level.offset = 0;
+		level.size = compressed[i].size();
+		containerLevels.push_back(level);
+		levelData.push_back(compressed[i].data());
+	}
+
+	TextureContainer::CONTAINER_HEADER header;
+	header.width = levels[0].width;
+	header.height = levels[0].height;
+	header.internalFormat = internalFormat;
+	header.format = TextureFormat::GetFormat(colorChannels);
+	header.type = GL_UNSIGNED_BYTE;
+	header.sourceHash = sourceHash;
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(filename).parent_path(), error);
+	return(TextureContainer::Write(filename, header, containerLevels, levelData));
+}
+
+/***********************************************************
+ *  GetCacheFilename()
+ *
+ *  This method is used for getting the cache file of image
+ *  contents.  Identical images share one cache file, and a
+ *  new encoder version does not read the old files.
+ ***********************************************************/
+std::string TextureCompressor::GetCacheFilename(const std::string& directory, uint64_t contentHash)
+{
+	char hash[17];
+	snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)contentHash);
+	return(directory + "/" + hash + "." + g_EncoderSettings + g_CacheExtension);
+}
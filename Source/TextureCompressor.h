@@ -0,0 +1,51 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecompressor.h
+// ============
+// block compress texture images on the CPU and cache them on disk
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/***********************************************************
+ *  TextureCompressor
+ *
+ *  This class encodes decoded images into the BCn block
+ *  formats the GPU samples directly: BC1 for opaque color,
+ *  BC3 for color with alpha, BC4 for gray and BC5 for gray
+ *  with alpha.  The result is written as a texture
+ *  container in a cache directory, named after the image
+ *  contents hash and the encoder settings, so the encoding
+ *  only runs the first time an image is loaded.
+ ***********************************************************/
+class TextureCompressor
+{
+public:
+	// pixels of one mip level to compress
+	struct SOURCE_LEVEL
+	{
+		const unsigned char* pixels;
+		int width;
+		int height;
+	};
+
+	// true when the driver can sample every block format used
+	static bool IsSupported();
+	// block format for an image, chosen from its channels and alpha
+	static GLenum ChooseFormat(const unsigned char* pixels, int width, int height, int colorChannels);
+	// bytes of a level compressed in a block format
+	static size_t GetLevelBytes(GLenum internalFormat, int width, int height);
+	// compress one level, can run on any thread
+	static void CompressLevel(GLenum internalFormat, const SOURCE_LEVEL& level, int colorChannels, unsigned char* output);
+	// compress every level and write them as a container file
+	static bool WriteContainer(const char* filename, uint64_t sourceHash, const std::vector<SOURCE_LEVEL>& levels, int colorChannels);
+	// cache file for image contents, keyed by hash and encoder settings
+	static std::string GetCacheFilename(const std::string& directory, uint64_t contentHash);
+};
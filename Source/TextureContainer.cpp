@@ -0,0 +1,615 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecontainer.cpp
+// ============
+// baked texture container - pre-flipped, pre-mipmapped texture data that is
+// memory mapped and uploaded to OpenGL without decoding
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureContainer.h"
+#include "TextureDecodePool.h"
+#include "MipChain.h"
+#include "ImageDecoder.h"
+#include "TextureFormat.h"
+#include "TextureCompressor.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	const char g_ContainerMagic[4] = { 'G', 'L', 'T', 'X' };
+	const uint32_t g_ContainerVersion = 1;
+	// name of the directory next to the image files holding the containers
+	const char* g_BakedDirectoryName = "baked";
+	const char* g_ContainerExtension = ".gltex";
+	// numbers the temporary files of Write(), so writers on
+	// different threads never share one
+	std::atomic<unsigned int> g_TemporaryFileCounter(0);
+}
+
+/***********************************************************
+ *  MappedFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MappedFile::MappedFile()
+{
+	m_pData = NULL;
+	m_size = 0;
+#ifdef _WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#else
+	m_fileDescriptor = -1;
+#endif
+}
+
+/***********************************************************
+ *  ~MappedFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping a whole file read-only
+ *  into the address space of the process.
+ ***********************************************************/
+bool MappedFile::Open(const char* filename)
+{
+	Close();
+
+#ifdef _WIN32
+	m_hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		return(false);
+	}
+
+	LARGE_INTEGER fileSize;
+	if ((GetFileSizeEx((HANDLE)m_hFile, &fileSize) == FALSE) || (fileSize.QuadPart == 0))
+	{
+		Close();
+		return(false);
+	}
+
+	m_hMapping = CreateFileMappingA((HANDLE)m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping == NULL)
+	{
+		Close();
+		return(false);
+	}
+
+	m_pData = (const unsigned char*)MapViewOfFile((HANDLE)m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	m_size = (size_t)fileSize.QuadPart;
+#else
+	m_fileDescriptor = open(filename, O_RDONLY);
+	if (m_fileDescriptor < 0)
+	{
+		return(false);
+	}
+
+	struct stat fileStat;
+	if ((fstat(m_fileDescriptor, &fileStat) != 0) || (fileStat.st_size == 0))
+	{
+		Close();
+		return(false);
+	}
+
+	void* pMapping = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+	if (pMapping == MAP_FAILED)
+	{
+		Close();
+		return(false);
+	}
+	m_pData = (const unsigned char*)pMapping;
+	m_size = (size_t)fileStat.st_size;
+#endif
+
+	if (NULL == m_pData)
+	{
+		Close();
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for unmapping the mapped file.
+ ***********************************************************/
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (NULL != m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+	if (NULL != m_hMapping)
+	{
+		CloseHandle((HANDLE)m_hMapping);
+		m_hMapping = NULL;
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle((HANDLE)m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (NULL != m_pData)
+	{
+		munmap((void*)m_pData, m_size);
+	}
+	if (m_fileDescriptor >= 0)
+	{
+		close(m_fileDescriptor);
+		m_fileDescriptor = -1;
+	}
+#endif
+	m_pData = NULL;
+	m_size = 0;
+}
+
+/***********************************************************
+ *  TextureContainer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureContainer::TextureContainer()
+{
+	m_pHeader = NULL;
+	m_pLevels = NULL;
+}
+
+/***********************************************************
+ *  ~TextureContainer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureContainer::~TextureContainer()
+{
+	m_pHeader = NULL;
+	m_pLevels = NULL;
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping a baked container file
+ *  into memory and checking that all of its mip levels
+ *  are inside the file.
+ ***********************************************************/
+bool TextureContainer::Open(const char* filename)
+{
+	m_pHeader = NULL;
+	m_pLevels = NULL;
+
+	if (m_file.Open(filename) == false)
+	{
+		return(false);
+	}
+
+	const unsigned char* pData = m_file.GetData();
+	size_t size = m_file.GetSize();
+	if (size < sizeof(CONTAINER_HEADER))
+	{
+		m_file.Close();
+		return(false);
+	}
+
+	const CONTAINER_HEADER* pHeader = (const CONTAINER_HEADER*)pData;
+	size_t levelTableEnd = sizeof(CONTAINER_HEADER) + pHeader->levelCount * sizeof(CONTAINER_LEVEL);
+	if ((memcmp(pHeader->magic, g_ContainerMagic, sizeof(g_ContainerMagic)) != 0) ||
+		(pHeader->version != g_ContainerVersion) ||
+		(pHeader->levelCount == 0) ||
+		(levelTableEnd > size))
+	{
+		std::cout << "Invalid baked texture container:" << filename << std::endl;
+		m_file.Close();
+		return(false);
+	}
+
+	const CONTAINER_LEVEL* pLevels = (const CONTAINER_LEVEL*)(pData + sizeof(CONTAINER_HEADER));
+	bool bCompressed = TextureFormat::IsCompressed(pHeader->internalFormat);
+	uint32_t levelWidth = pHeader->width;
+	uint32_t levelHeight = pHeader->height;
+	for (uint32_t i = 0; i < pHeader->levelCount; i++)
+	{
+		// each level halves the one above it and stops at 1x1,
+		// and holds exactly the bytes its dimensions need
+		uint64_t expectedSize = 0;
+		if (bCompressed)
+		{
+			expectedSize = TextureCompressor::GetLevelBytes(pHeader->internalFormat, levelWidth, levelHeight);
+		}
+		else if (pHeader->type == GL_UNSIGNED_BYTE)
+		{
+			expectedSize = (uint64_t)levelWidth * levelHeight * TextureFormat::GetColorChannels(pHeader->format);
+		}
+
+		if (((i > 0) && (pLevels[i - 1].width == 1) && (pLevels[i - 1].height == 1)) ||
+			(pLevels[i].width != levelWidth) ||
+			(pLevels[i].height != levelHeight) ||
+			(pLevels[i].size != expectedSize) ||
+			(expectedSize == 0))
+		{
+			std::cout << "Invalid level " << i << " in baked texture container:" << filename << std::endl;
+			m_file.Close();
+			return(false);
+		}
+
+		// compare without adding so a huge offset cannot wrap
+		if ((pLevels[i].offset < levelTableEnd) ||
+			(pLevels[i].offset > size) ||
+			(pLevels[i].size > size - pLevels[i].offset))
+		{
+			std::cout << "Truncated baked texture container:" << filename << std::endl;
+			m_file.Close();
+			return(false);
+		}
+
+		levelWidth = std::max(levelWidth / 2, 1u);
+		levelHeight = std::max(levelHeight / 2, 1u);
+	}
+
+	m_pHeader = pHeader;
+	m_pLevels = pLevels;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for uploading every mip level from
+ *  the mapped file into the currently bound GL_TEXTURE_2D.
+ ***********************************************************/
+void TextureContainer::Upload() const
+{
+	if (NULL == m_pHeader)
+	{
+		return;
+	}
+
+	// rows of RGB data are tightly packed in the container
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (uint32_t i = 0; i < m_pHeader->levelCount; i++)
+	{
+		if (IsCompressed())
+		{
+			glCompressedTexImage2D(
+				GL_TEXTURE_2D,
+				i,
+				m_pHeader->internalFormat,
+				m_pLevels[i].width,
+				m_pLevels[i].height,
+				0,
+				(GLsizei)m_pLevels[i].size,
+				GetLevelData(i));
+		}
+		else
+		{
+			glTexImage2D(
+				GL_TEXTURE_2D,
+				i,
+				m_pHeader->internalFormat,
+				m_pLevels[i].width,
+				m_pLevels[i].height,
+				0,
+				m_pHeader->format,
+				m_pHeader->type,
+				GetLevelData(i));
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_pHeader->levelCount - 1);
+}
+
+/***********************************************************
+ *  IsCompressed()
+ *
+ *  This method is used for checking whether the container
+ *  holds block compressed levels, which are uploaded with
+ *  glCompressedTexImage2D().
+ ***********************************************************/
+bool TextureContainer::IsCompressed() const
+{
+	return((NULL != m_pHeader) && TextureFormat::IsCompressed(m_pHeader->internalFormat));
+}
+
+/***********************************************************
+ *  GetTotalBytes()
+ *
+ *  This method is used for getting the size of all of the
+ *  mip levels stored in the container.
+ ***********************************************************/
+size_t TextureContainer::GetTotalBytes() const
+{
+	size_t total = 0;
+	if (NULL != m_pHeader)
+	{
+		for (uint32_t i = 0; i < m_pHeader->levelCount; i++)
+		{
+			total += (size_t)m_pLevels[i].size;
+		}
+	}
+	return(total);
+}
+
+/***********************************************************
+ *  Write()
+ *
+ *  This method is used for writing a container file.  The
+ *  level data follows the level table, each level 16 byte
+ *  aligned.  The file is written under a temporary name and
+ *  renamed, so a reader never maps a partly written file.
+ *  The temporary name holds the writing thread and a count,
+ *  as the decode pool and the streaming pool can write the
+ *  same container at once.
+ ***********************************************************/
+bool TextureContainer::Write(const char* filename, CONTAINER_HEADER header, std::vector<CONTAINER_LEVEL> levels, const std::vector<const unsigned char*>& levelData)
+{
+	memcpy(header.magic, g_ContainerMagic, sizeof(g_ContainerMagic));
+	header.version = g_ContainerVersion;
+	header.levelCount = (uint32_t)levels.size();
+
+	uint64_t offset = sizeof(CONTAINER_HEADER) + levels.size() * sizeof(CONTAINER_LEVEL);
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		offset = (offset + 15) & ~(uint64_t)15;
+		levels[i].offset = offset;
+		offset += levels[i].size;
+	}
+
+	std::string temporaryFilename = std::string(filename) + "." +
+		std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." +
+		std::to_string(g_TemporaryFileCounter++) + ".tmp";
+	{
+		std::ofstream file(temporaryFilename.c_str(), std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			return(false);
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)levels.data(), levels.size() * sizeof(CONTAINER_LEVEL));
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			static const char padding[16] = { 0 };
+			std::streamoff position = file.tellp();
+			file.write(padding, (std::streamsize)(levels[i].offset - (uint64_t)position));
+			file.write((const char*)levelData[i], (std::streamsize)levels[i].size);
+		}
+		if (!file)
+		{
+			file.close();
+			std::remove(temporaryFilename.c_str());
+			return(false);
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryFilename, filename, error);
+	if (error)
+	{
+		std::remove(temporaryFilename.c_str());
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  Bake()
+ *
+ *  This method is used for decoding an image file, flipping
+ *  it for OpenGL, building the full mip chain and writing
+ *  the result into a container file.
+ ***********************************************************/
+bool TextureContainer::Bake(const char* sourceFilename, const char* containerFilename)
+{
+	std::vector<unsigned char> fileBytes;
+	if (TextureDecodePool::ReadImageFile(sourceFilename, fileBytes) == false)
+	{
+		std::cout << "Could not read image:" << sourceFilename << std::endl;
+		return(false);
+	}
+
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+	unsigned char* image = ImageDecoder::DecodeImage(fileBytes.data(), fileBytes.size(), width, height, colorChannels);
+	if (NULL == image)
+	{
+		std::cout << "Could not decode image:" << sourceFilename << std::endl;
+		return(false);
+	}
+	// store the container in the format the texture is uploaded with
+	image = TextureFormat::PackImage(image, width, height, colorChannels);
+
+	// build every mip level down to 1x1
+	MipChain mipChain;
+	mipChain.Generate(image, width, height, colorChannels);
+
+	std::vector<const unsigned char*> levelData;
+	std::vector<CONTAINER_LEVEL> levels;
+	for (int i = 0; i < mipChain.GetLevelCount(); i++)
+	{
+		CONTAINER_LEVEL level;
+		level.offset = 0;
+		if (i == 0)
+		{
+			level.width = width;
+			level.height = height;
+			level.size = (uint64_t)width * height * colorChannels;
+			levelData.push_back(image);
+		}
+		else
+		{
+			level.width = mipChain.GetLevel(i).width;
+			level.height = mipChain.GetLevel(i).height;
+			level.size = mipChain.GetLevel(i).size;
+			levelData.push_back(mipChain.GetLevelData(i));
+		}
+		levels.push_back(level);
+	}
+
+	CONTAINER_HEADER header;
+	header.width = width;
+	header.height = height;
+	header.internalFormat = TextureFormat::GetInternalFormat(colorChannels);
+	header.format = TextureFormat::GetFormat(colorChannels);
+	header.type = GL_UNSIGNED_BYTE;
+	header.sourceHash = TextureDecodePool::HashImageBytes(fileBytes);
+
+	bool bWritten = Write(containerFilename, header, levels, levelData);
+	ImageDecoder::FreeImage(image);
+	if (bWritten == false)
+	{
+		std::cout << "Could not write baked texture:" << containerFilename << std::endl;
+		return(false);
+	}
+
+	std::cout << "Baked texture:" << sourceFilename << " -> " << containerFilename << ", levels:" << levels.size() << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  BakeDirectory()
+ *
+ *  This method is used for baking every image file in the
+ *  source directory.  Images whose container is newer than
+ *  the image are skipped, so the build step only decodes
+ *  the images that changed.  Returns the number of failed
+ *  images.
+ ***********************************************************/
+int TextureContainer::BakeDirectory(const char* sourceDirectory, const char* containerDirectory)
+{
+	std::error_code error;
+	std::filesystem::create_directories(containerDirectory, error);
+
+	int failures = 0;
+	int skipped = 0;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(sourceDirectory, error))
+	{
+		if (entry.is_regular_file() == false)
+		{
+			continue;
+		}
+
+		if (IsImageFile(entry.path().string()) == false)
+		{
+			continue;
+		}
+
+		std::filesystem::path containerPath = std::filesystem::path(containerDirectory) / entry.path().filename();
+		containerPath += g_ContainerExtension;
+		if (IsContainerCurrent(entry.path(), containerPath))
+		{
+			skipped++;
+			continue;
+		}
+		if (Bake(entry.path().string().c_str(), containerPath.string().c_str()) == false)
+		{
+			failures++;
+		}
+	}
+
+	if (skipped > 0)
+	{
+		std::cout << "Baked textures up to date:" << skipped << std::endl;
+	}
+
+	return(failures);
+}
+
+/***********************************************************
+ *  IsImageFile()
+ *
+ *  This method is used for checking whether a file has one
+ *  of the image extensions that can be decoded.
+ ***********************************************************/
+bool TextureContainer::IsImageFile(const std::string& filename)
+{
+	std::string extension = std::filesystem::path(filename).extension().string();
+	for (size_t i = 0; i < extension.size(); i++)
+	{
+		extension[i] = (char)tolower((unsigned char)extension[i]);
+	}
+	return((extension == ".jpg") || (extension == ".jpeg") || (extension == ".png") ||
+		(extension == ".bmp") || (extension == ".tga"));
+}
+
+/***********************************************************
+ *  FindBakedContainer()
+ *
+ *  This method is used for finding the baked container for
+ *  an image file.  Containers are kept in a "baked" folder
+ *  next to the image file and are only used when they are
+ *  newer than the image file.
+ ***********************************************************/
+bool TextureContainer::FindBakedContainer(const char* sourceFilename, std::string& containerFilename)
+{
+	std::filesystem::path sourcePath(sourceFilename);
+	std::filesystem::path containerPath = sourcePath.parent_path() / g_BakedDirectoryName / sourcePath.filename();
+	containerPath += g_ContainerExtension;
+
+	// a stale container is ignored so edited images are picked up
+	if (IsContainerCurrent(sourcePath, containerPath) == false)
+	{
+		return(false);
+	}
+
+	containerFilename = containerPath.string();
+	return(true);
+}
+
+/***********************************************************
+ *  IsContainerCurrent()
+ *
+ *  This method is used for checking that a container exists
+ *  and is not older than the image file it was baked from.
+ ***********************************************************/
+bool TextureContainer::IsContainerCurrent(const std::filesystem::path& sourcePath, const std::filesystem::path& containerPath)
+{
+	std::error_code error;
+	std::filesystem::file_time_type containerTime = std::filesystem::last_write_time(containerPath, error);
+	if (error)
+	{
+		return(false);
+	}
+
+	std::filesystem::file_time_type sourceTime = std::filesystem::last_write_time(sourcePath, error);
+	return(error || (sourceTime <= containerTime));
+}
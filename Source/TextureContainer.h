@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecontainer.h
+// ============
+// baked texture container - pre-flipped, pre-mipmapped texture data that is
+// memory mapped and uploaded to OpenGL without decoding
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  This class maps a whole file read-only into memory.
+ ***********************************************************/
+class MappedFile
+{
+public:
+	// constructor
+	MappedFile();
+	// destructor
+	~MappedFile();
+
+	// map the file into memory
+	bool Open(const char* filename);
+	// unmap the file
+	void Close();
+
+	const unsigned char* GetData() const { return(m_pData); }
+	size_t GetSize() const { return(m_size); }
+
+private:
+	const unsigned char* m_pData;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#else
+	int m_fileDescriptor;
+#endif
+
+	// the mapping cannot be copied
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+
+/***********************************************************
+ *  TextureContainer
+ *
+ *  This class reads and writes the baked texture container
+ *  format.  A container holds every mip level of a texture,
+ *  already flipped for OpenGL and stored in the format it
+ *  is uploaded with, so loading it is a memory map followed
+ *  by one glTexImage2D() call per mip level.
+ ***********************************************************/
+class TextureContainer
+{
+public:
+	// constructor
+	TextureContainer();
+	// destructor
+	~TextureContainer();
+
+	struct CONTAINER_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+		uint32_t internalFormat;
+		uint32_t format;
+		uint32_t type;
+		// hash of the source image file contents
+		uint64_t sourceHash;
+	};
+
+	struct CONTAINER_LEVEL
+	{
+		uint32_t width;
+		uint32_t height;
+		// offset of the level data from the start of the file
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	// map a baked container file into memory and validate it
+	bool Open(const char* filename);
+	// upload every mip level into the bound GL_TEXTURE_2D
+	void Upload() const;
+	// true when the levels hold compressed blocks
+	bool IsCompressed() const;
+
+	const CONTAINER_HEADER& GetHeader() const { return(*m_pHeader); }
+	const CONTAINER_LEVEL& GetLevel(uint32_t level) const { return(m_pLevels[level]); }
+	const unsigned char* GetLevelData(uint32_t level) const { return(m_file.GetData() + m_pLevels[level].offset); }
+	// GPU memory used by all of the mip levels
+	size_t GetTotalBytes() const;
+
+	// write a container file from the data of every mip level,
+	// the magic, version, level count and offsets are filled in
+	static bool Write(const char* filename, CONTAINER_HEADER header, std::vector<CONTAINER_LEVEL> levels, const std::vector<const unsigned char*>& levelData);
+	// decode an image file, build its mip chain and write a container
+	static bool Bake(const char* sourceFilename, const char* containerFilename);
+	// bake every image file in a directory into a container directory
+	static int BakeDirectory(const char* sourceDirectory, const char* containerDirectory);
+	// path of the baked container for an image file, if it is up to date
+	static bool FindBakedContainer(const char* sourceFilename, std::string& containerFilename);
+	// true when the file extension is one of the decodable image types
+	static bool IsImageFile(const std::string& filename);
+
+private:
+	// true when the container exists and is not older than the image
+	static bool IsContainerCurrent(const std::filesystem::path& sourcePath, const std::filesystem::path& containerPath);
+
+	MappedFile m_file;
+	const CONTAINER_HEADER* m_pHeader;
+	const CONTAINER_LEVEL* m_pLevels;
+};
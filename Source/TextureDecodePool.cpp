@@ -0,0 +1,538 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturedecodepool.cpp
+// ============
+// decode texture image files on worker threads ahead of the OpenGL upload
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureDecodePool.h"
+#include "TextureContainer.h"
+#include "MipChain.h"
+#include "ImageDecoder.h"
+#include "StartupTrace.h"
+#include "TextureFormat.h"
+#include "TextureCompressor.h"
+
+#include <fstream>
+#include <filesystem>
+
+/***********************************************************
+ *  TextureDecodePool()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureDecodePool::TextureDecodePool()
+{
+	m_outstandingJobs = 0;
+	m_bShutdown = false;
+	m_bGenerateMipmaps = false;
+}
+
+/***********************************************************
+ *  ~TextureDecodePool()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureDecodePool::~TextureDecodePool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bShutdown = true;
+	}
+	m_jobQueued.notify_all();
+
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+
+	Reset();
+}
+
+/***********************************************************
+ *  StartWorkers()
+ *
+ *  This method is used for starting one worker thread per
+ *  hardware thread the first time an image is queued.
+ ***********************************************************/
+void TextureDecodePool::StartWorkers()
+{
+	if (m_workers.size() > 0)
+	{
+		return;
+	}
+
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+	{
+		threadCount = 2;
+	}
+
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		m_workers.push_back(std::thread(&TextureDecodePool::WorkerThread, this));
+	}
+}
+
+/***********************************************************
+ *  QueueImage()
+ *
+ *  This method is used for queueing an image file to be
+ *  decoded by the worker threads.
+ ***********************************************************/
+int TextureDecodePool::QueueImage(const char* filename)
+{
+	StartWorkers();
+
+	DECODE_JOB job;
+	job.filename = filename;
+	job.contentHash = 0;
+	job.image = NULL;
+	job.container = NULL;
+	job.mipChain = NULL;
+	job.width = 0;
+	job.height = 0;
+	job.colorChannels = 0;
+	job.sourceChannels = 0;
+	job.duplicateOf = -1;
+	job.bAlreadyLoaded = false;
+	job.bSuccess = false;
+
+	int jobIndex = -1;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		jobIndex = (int)m_jobs.size();
+		m_jobs.push_back(job);
+		m_pendingJobs.push_back(jobIndex);
+		m_outstandingJobs++;
+	}
+	m_jobQueued.notify_one();
+
+	return(jobIndex);
+}
+
+/***********************************************************
+ *  MarkImageLoaded()
+ *
+ *  This method is used for telling the workers that images
+ *  with the passed in contents do not need to be decoded.
+ ***********************************************************/
+void TextureDecodePool::MarkImageLoaded(uint64_t contentHash)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_claimedHashes[contentHash] = -1;
+}
+
+/***********************************************************
+ *  SetGenerateMipmaps()
+ *
+ *  This method is used for choosing whether the workers
+ *  build the mip levels of each decoded image, so they do
+ *  not have to be generated by the driver.  It applies to
+ *  the jobs that start decoding afterwards.
+ ***********************************************************/
+void TextureDecodePool::SetGenerateMipmaps(bool bGenerate)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_bGenerateMipmaps = bGenerate;
+}
+
+/***********************************************************
+ *  SetCompressionCache()
+ *
+ *  This method is used for choosing whether the workers
+ *  block compress the decoded images.  The compressed mip
+ *  chain is written to the cache directory and loaded from
+ *  it the next time, an empty directory turns it off.
+ ***********************************************************/
+void TextureDecodePool::SetCompressionCache(const std::string& directory)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_compressionCache = directory;
+}
+
+/***********************************************************
+ *  WaitForFinishedImage()
+ *
+ *  This method is used for waiting until the next queued
+ *  job is finished.  Jobs are returned in the order that
+ *  they finish, not the order that they were queued.
+ ***********************************************************/
+int TextureDecodePool::WaitForFinishedImage()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_outstandingJobs == 0)
+	{
+		return(-1);
+	}
+
+	m_jobFinished.wait(lock, [this] { return(m_finishedJobs.size() > 0); });
+
+	int jobIndex = m_finishedJobs.front();
+	m_finishedJobs.pop_front();
+	m_outstandingJobs--;
+
+	return(jobIndex);
+}
+
+/***********************************************************
+ *  PollFinishedImage()
+ *
+ *  This method is used for collecting a finished job
+ *  without blocking.  Returns -1 when no job has finished.
+ ***********************************************************/
+int TextureDecodePool::PollFinishedImage()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_finishedJobs.size() == 0)
+	{
+		return(-1);
+	}
+
+	int jobIndex = m_finishedJobs.front();
+	m_finishedJobs.pop_front();
+	m_outstandingJobs--;
+
+	return(jobIndex);
+}
+
+/***********************************************************
+ *  HasOutstandingImages()
+ *
+ *  This method is used for checking whether any queued job
+ *  has not been collected yet.
+ ***********************************************************/
+bool TextureDecodePool::HasOutstandingImages()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return(m_outstandingJobs > 0);
+}
+
+/***********************************************************
+ *  GetJob()
+ *
+ *  This method is used for getting a queued job.  The
+ *  results are only valid after the job was returned from
+ *  WaitForFinishedImage().
+ ***********************************************************/
+TextureDecodePool::DECODE_JOB& TextureDecodePool::GetJob(int jobIndex)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return(m_jobs[jobIndex]);
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  This method is used for freeing the decoded image data
+ *  once all the queued jobs have been collected.
+ ***********************************************************/
+void TextureDecodePool::Reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; i < m_jobs.size(); i++)
+	{
+		if (NULL != m_jobs[i].image)
+		{
+			ImageDecoder::FreeImage(m_jobs[i].image);
+			m_jobs[i].image = NULL;
+		}
+		if (NULL != m_jobs[i].container)
+		{
+			delete m_jobs[i].container;
+			m_jobs[i].container = NULL;
+		}
+		if (NULL != m_jobs[i].mipChain)
+		{
+			delete m_jobs[i].mipChain;
+			m_jobs[i].mipChain = NULL;
+		}
+	}
+	m_jobs.clear();
+	m_finishedJobs.clear();
+	m_claimedHashes.clear();
+}
+
+/***********************************************************
+ *  WorkerThread()
+ *
+ *  This method is the main loop of each worker thread.
+ ***********************************************************/
+void TextureDecodePool::WorkerThread()
+{
+	while (true)
+	{
+		int jobIndex = -1;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobQueued.wait(lock, [this] { return(m_bShutdown || (m_pendingJobs.size() > 0)); });
+			if (m_bShutdown)
+			{
+				return;
+			}
+			jobIndex = m_pendingJobs.front();
+			m_pendingJobs.pop_front();
+		}
+
+		DecodeJob(jobIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_finishedJobs.push_back(jobIndex);
+		}
+		m_jobFinished.notify_all();
+	}
+}
+
+/***********************************************************
+ *  DecodeJob()
+ *
+ *  This method is used for reading, hashing and decoding
+ *  the image file of a single job.  Image contents that
+ *  another job already claimed are not decoded again, and
+ *  images with a baked container are mapped, not decoded.
+ ***********************************************************/
+void TextureDecodePool::DecodeJob(int jobIndex)
+{
+	std::string filename;
+	std::string compressionCache;
+	bool bGenerateMipmaps = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		filename = m_jobs[jobIndex].filename;
+		compressionCache = m_compressionCache;
+		bGenerateMipmaps = m_bGenerateMipmaps;
+	}
+	StartupTrace::Scope trace("Decode " + filename, "texture");
+
+	// prefer the baked container - its header holds the source hash
+	// so the image file itself does not need to be read at all
+	std::vector<unsigned char> fileBytes;
+	TextureContainer* pContainer = NULL;
+	std::string containerFilename;
+	if (TextureContainer::FindBakedContainer(filename.c_str(), containerFilename))
+	{
+		pContainer = new TextureContainer();
+		if (pContainer->Open(containerFilename.c_str()) == false)
+		{
+			delete pContainer;
+			pContainer = NULL;
+		}
+	}
+
+	uint64_t contentHash = 0;
+	if (NULL != pContainer)
+	{
+		contentHash = pContainer->GetHeader().sourceHash;
+	}
+	else if (ReadImageFile(filename.c_str(), fileBytes))
+	{
+		contentHash = HashImageBytes(fileBytes);
+	}
+	else
+	{
+		return;
+	}
+
+	int duplicateOf = -1;
+	bool bAlreadyLoaded = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs[jobIndex].contentHash = contentHash;
+
+		std::unordered_map<uint64_t, int>::iterator claimed = m_claimedHashes.find(contentHash);
+		if (claimed != m_claimedHashes.end())
+		{
+			duplicateOf = claimed->second;
+			bAlreadyLoaded = (claimed->second == -1);
+		}
+		else
+		{
+			m_claimedHashes[contentHash] = jobIndex;
+		}
+	}
+
+	DECODE_JOB result;
+	result.image = NULL;
+	result.container = NULL;
+	result.mipChain = NULL;
+	result.width = 0;
+	result.height = 0;
+	result.colorChannels = 0;
+	result.sourceChannels = 0;
+	result.bSuccess = true;
+
+	// a compressed copy of these contents replaces the baked container,
+	// or is compressed from its levels the first time it is missing
+	std::string cacheFilename;
+	if ((duplicateOf == -1) && (bAlreadyLoaded == false) && (compressionCache.size() > 0))
+	{
+		cacheFilename = TextureCompressor::GetCacheFilename(compressionCache, contentHash);
+		TextureContainer* pCompressed = OpenCachedContainer(cacheFilename);
+		if ((NULL == pCompressed) && (NULL != pContainer) && (pContainer->IsCompressed() == false))
+		{
+			std::vector<TextureCompressor::SOURCE_LEVEL> levels;
+			for (uint32_t i = 0; i < pContainer->GetHeader().levelCount; i++)
+			{
+				TextureCompressor::SOURCE_LEVEL level;
+				level.pixels = pContainer->GetLevelData(i);
+				level.width = pContainer->GetLevel(i).width;
+				level.height = pContainer->GetLevel(i).height;
+				levels.push_back(level);
+			}
+			int colorChannels = TextureFormat::GetColorChannels(pContainer->GetHeader().format);
+			if (TextureCompressor::WriteContainer(cacheFilename.c_str(), contentHash, levels, colorChannels))
+			{
+				pCompressed = OpenCachedContainer(cacheFilename);
+			}
+		}
+		if (NULL != pCompressed)
+		{
+			delete pContainer;
+			pContainer = pCompressed;
+		}
+	}
+
+	// only the first job with these contents decodes the image
+	if ((duplicateOf != -1) || bAlreadyLoaded)
+	{
+		delete pContainer;
+	}
+	else if (NULL != pContainer)
+	{
+		result.container = pContainer;
+		result.width = pContainer->GetHeader().width;
+		result.height = pContainer->GetHeader().height;
+		result.colorChannels = TextureFormat::GetColorChannels(pContainer->GetHeader().format);
+		result.sourceChannels = result.colorChannels;
+	}
+	else
+	{
+		result.image = ImageDecoder::DecodeImage(
+			fileBytes.data(),
+			fileBytes.size(),
+			result.width,
+			result.height,
+			result.colorChannels);
+		result.bSuccess = (NULL != result.image);
+		// store grayscale images in fewer channels and RGB as RGBA
+		result.sourceChannels = result.colorChannels;
+		result.image = TextureFormat::PackImage(result.image, result.width, result.height, result.colorChannels);
+
+		// compressed textures always carry their mip levels
+		if (result.bSuccess && (bGenerateMipmaps || (cacheFilename.size() > 0)))
+		{
+			result.mipChain = new MipChain();
+			result.mipChain->Generate(result.image, result.width, result.height, result.colorChannels);
+		}
+
+		if (result.bSuccess && (cacheFilename.size() > 0))
+		{
+			std::vector<TextureCompressor::SOURCE_LEVEL> levels;
+			TextureCompressor::SOURCE_LEVEL level;
+			level.pixels = result.image;
+			level.width = result.width;
+			level.height = result.height;
+			levels.push_back(level);
+			for (int i = 1; i < result.mipChain->GetLevelCount(); i++)
+			{
+				level.pixels = result.mipChain->GetLevelData(i);
+				level.width = result.mipChain->GetLevel(i).width;
+				level.height = result.mipChain->GetLevel(i).height;
+				levels.push_back(level);
+			}
+
+			if (TextureCompressor::WriteContainer(cacheFilename.c_str(), contentHash, levels, result.colorChannels))
+			{
+				result.container = OpenCachedContainer(cacheFilename);
+			}
+			// the compressed container replaces the decoded pixels
+			if (NULL != result.container)
+			{
+				ImageDecoder::FreeImage(result.image);
+				result.image = NULL;
+				delete result.mipChain;
+				result.mipChain = NULL;
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	DECODE_JOB& job = m_jobs[jobIndex];
+	job.image = result.image;
+	job.container = result.container;
+	job.mipChain = result.mipChain;
+	job.width = result.width;
+	job.height = result.height;
+	job.colorChannels = result.colorChannels;
+	job.sourceChannels = result.sourceChannels;
+	job.duplicateOf = duplicateOf;
+	job.bAlreadyLoaded = bAlreadyLoaded;
+	job.bSuccess = result.bSuccess;
+}
+
+/***********************************************************
+ *  OpenCachedContainer()
+ *
+ *  Map a container from the compression cache, returns
+ *  NULL when the file is not cached yet or is invalid.
+ ***********************************************************/
+TextureContainer* TextureDecodePool::OpenCachedContainer(const std::string& filename)
+{
+	std::error_code error;
+	if (std::filesystem::exists(filename, error) == false)
+	{
+		return(NULL);
+	}
+
+	TextureContainer* pContainer = new TextureContainer();
+	if (pContainer->Open(filename.c_str()) == false)
+	{
+		delete pContainer;
+		return(NULL);
+	}
+	return(pContainer);
+}
+
+/***********************************************************
+ *  ReadImageFile()
+ *
+ *  Read the raw bytes of an image file into memory so they
+ *  can be hashed and then decoded without a second read.
+ ***********************************************************/
+bool TextureDecodePool::ReadImageFile(const char* filename, std::vector<unsigned char>& bytes)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		return(false);
+	}
+
+	std::streamsize size = file.tellg();
+	file.seekg(0, std::ios::beg);
+	bytes.resize((size_t)size);
+	if ((size > 0) && !file.read((char*)bytes.data(), size))
+	{
+		return(false);
+	}
+
+	return(size > 0);
+}
+
+/***********************************************************
+ *  HashImageBytes()
+ *
+ *  64-bit FNV-1a hash of the image file contents, used as
+ *  the key of the texture cache.
+ ***********************************************************/
+uint64_t TextureDecodePool::HashImageBytes(const std::vector<unsigned char>& bytes)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < bytes.size(); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return(hash);
+}
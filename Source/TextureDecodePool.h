@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturedecodepool.h
+// ============
+// decode texture image files on worker threads ahead of the OpenGL upload
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+class TextureContainer;
+class MipChain;
+
+/***********************************************************
+ *  TextureDecodePool
+ *
+ *  This class owns a pool of worker threads that read, hash
+ *  and decode image files in parallel.  The OpenGL thread
+ *  queues the image files and then collects each decoded
+ *  image as soon as it is finished to upload it.  Images
+ *  with an up to date baked container are memory mapped
+ *  instead of being decoded.
+ ***********************************************************/
+class TextureDecodePool
+{
+public:
+	// constructor
+	TextureDecodePool();
+	// destructor
+	~TextureDecodePool();
+
+	struct DECODE_JOB
+	{
+		std::string filename;
+		// hash of the image file contents
+		uint64_t contentHash;
+		// decoded pixel data, NULL if not decoded by this job
+		unsigned char* image;
+		// mapped baked container, used instead of decoding the image
+		TextureContainer* container;
+		// mip levels built from the decoded image, or NULL
+		MipChain* mipChain;
+		int width;
+		int height;
+		// channels of the pixel data, after TextureFormat::PackImage()
+		int colorChannels;
+		// channels of the image file as it was decoded
+		int sourceChannels;
+		// index of the job decoding the same image contents,
+		// or -1 when this job decoded the image itself
+		int duplicateOf;
+		// true when the image contents were already loaded
+		bool bAlreadyLoaded;
+		// true when the file was read and decoded successfully
+		bool bSuccess;
+	};
+
+	// queue an image file for decoding and return the job index
+	int QueueImage(const char* filename);
+	// skip decoding of images with these contents - already loaded
+	void MarkImageLoaded(uint64_t contentHash);
+	// build the mip levels of decoded images on the worker threads
+	void SetGenerateMipmaps(bool bGenerate);
+	// block compress decoded images, cached in this directory
+	void SetCompressionCache(const std::string& directory);
+	// wait for the next finished job, returns -1 when none are left
+	int WaitForFinishedImage();
+	// get the next finished job without waiting, -1 if none is finished
+	int PollFinishedImage();
+	// true while queued jobs have not been collected
+	bool HasOutstandingImages();
+	// get a queued job by index
+	DECODE_JOB& GetJob(int jobIndex);
+	// free all decoded image data and forget the finished jobs
+	void Reset();
+
+	// read the raw bytes of an image file into memory
+	static bool ReadImageFile(const char* filename, std::vector<unsigned char>& bytes);
+	// 64-bit FNV-1a hash of the image file contents
+	static uint64_t HashImageBytes(const std::vector<unsigned char>& bytes);
+
+private:
+	// worker threads used for decoding
+	std::vector<std::thread> m_workers;
+	// guards all of the job bookkeeping below
+	std::mutex m_mutex;
+	// signalled when a job is queued or the pool shuts down
+	std::condition_variable m_jobQueued;
+	// signalled when a job has finished decoding
+	std::condition_variable m_jobFinished;
+	// all jobs queued since the last reset
+	std::deque<DECODE_JOB> m_jobs;
+	// jobs waiting for a worker
+	std::deque<int> m_pendingJobs;
+	// jobs finished but not yet collected
+	std::deque<int> m_finishedJobs;
+	// image contents already claimed by a job or already loaded
+	std::unordered_map<uint64_t, int> m_claimedHashes;
+	// jobs queued but not yet collected
+	int m_outstandingJobs;
+	// true when the workers should exit
+	bool m_bShutdown;
+	// true when the workers build the mip levels of decoded images
+	bool m_bGenerateMipmaps;
+	// directory of the compressed texture cache, empty when disabled
+	std::string m_compressionCache;
+
+	// start the worker threads on first use
+	void StartWorkers();
+	// worker thread main loop
+	void WorkerThread();
+	// read, hash and decode the image for a single job
+	void DecodeJob(int jobIndex);
+	// map a container from the compression cache if it exists
+	static TextureContainer* OpenCachedContainer(const std::string& filename);
+};
@@ -0,0 +1,283 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureformat.cpp
+// ============
+// choose the smallest OpenGL pixel format for decoded texture images
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureFormat.h"
+#include "ImageDecoder.h"
+
+#include <cstdlib>
+
+// declaration of global variables
+namespace
+{
+	// largest difference between the color channels of a texel
+	// still treated as gray, covers the chroma rounding of JPEG
+	const int g_GrayTolerance = 2;
+
+	/***********************************************************
+	 *  IsGrayTexel()
+	 *
+	 *  True when the red, green and blue values of a texel are
+	 *  within the gray tolerance of each other.
+	 ***********************************************************/
+	bool IsGrayTexel(const unsigned char* texel)
+	{
+		return((abs(texel[0] - texel[1]) <= g_GrayTolerance) &&
+			(abs(texel[1] - texel[2]) <= g_GrayTolerance) &&
+			(abs(texel[0] - texel[2]) <= g_GrayTolerance));
+	}
+}
+
+/***********************************************************
+ *  GetInternalFormat()
+ *
+ *  This method is used for getting the sized internal
+ *  format a texture with the channel count is stored in.
+ ***********************************************************/
+GLenum TextureFormat::GetInternalFormat(int colorChannels)
+{
+	switch (colorChannels)
+	{
+	case 1:
+		return(GL_R8);
+	case 2:
+		return(GL_RG8);
+	case 3:
+		return(GL_RGB8);
+	default:
+		return(GL_RGBA8);
+	}
+}
+
+/***********************************************************
+ *  GetFormat()
+ *
+ *  This method is used for getting the pixel transfer
+ *  format of image data with the channel count.
+ ***********************************************************/
+GLenum TextureFormat::GetFormat(int colorChannels)
+{
+	switch (colorChannels)
+	{
+	case 1:
+		return(GL_RED);
+	case 2:
+		return(GL_RG);
+	case 3:
+		return(GL_RGB);
+	default:
+		return(GL_RGBA);
+	}
+}
+
+/***********************************************************
+ *  GetColorChannels()
+ *
+ *  This method is used for getting the channel count of a
+ *  pixel transfer format, such as one stored in a baked
+ *  container.
+ ***********************************************************/
+int TextureFormat::GetColorChannels(GLenum format)
+{
+	switch (format)
+	{
+	case GL_RED:
+		return(1);
+	case GL_RG:
+		return(2);
+	case GL_RGB:
+		return(3);
+	default:
+		return(4);
+	}
+}
+
+/***********************************************************
+ *  GetName()
+ *
+ *  This method is used for getting the name of the internal
+ *  format for the load log.
+ ***********************************************************/
+const char* TextureFormat::GetName(int colorChannels)
+{
+	switch (colorChannels)
+	{
+	case 1:
+		return("R8");
+	case 2:
+		return("RG8");
+	case 3:
+		return("RGB8");
+	default:
+		return("RGBA8");
+	}
+}
+
+/***********************************************************
+ *  GetInternalFormatName()
+ *
+ *  This method is used for getting the name of an internal
+ *  format for the load log.
+ ***********************************************************/
+const char* TextureFormat::GetInternalFormatName(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_R8:
+		return("R8");
+	case GL_RG8:
+		return("RG8");
+	case GL_RGB8:
+		return("RGB8");
+	case GL_RGBA8:
+		return("RGBA8");
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		return("BC1");
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return("BC3");
+	case GL_COMPRESSED_RED_RGTC1:
+		return("BC4");
+	case GL_COMPRESSED_RG_RGTC2:
+		return("BC5");
+	default:
+		return("unknown");
+	}
+}
+
+/***********************************************************
+ *  IsCompressed()
+ *
+ *  This method is used for checking whether an internal
+ *  format is one of the block compressed formats.
+ ***********************************************************/
+bool TextureFormat::IsCompressed(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RED_RGTC1:
+	case GL_COMPRESSED_RG_RGTC2:
+		return(true);
+	default:
+		return(false);
+	}
+}
+
+/***********************************************************
+ *  GetBytesPerPixel()
+ *
+ *  This method is used for getting the GPU memory used by a
+ *  texel.  Drivers store RGB8 textures with four bytes per
+ *  texel, so RGB8 costs as much as RGBA8.
+ ***********************************************************/
+int TextureFormat::GetBytesPerPixel(int colorChannels)
+{
+	return((colorChannels == 3) ? 4 : colorChannels);
+}
+
+/***********************************************************
+ *  ApplySwizzle()
+ *
+ *  This method is used for setting the swizzle of the bound
+ *  texture.  R8 textures read as (r, r, r, 1) and RG8
+ *  textures as (r, r, r, g), so a grayscale texture samples
+ *  the same as the RGB image it came from.  Other formats
+ *  get the identity swizzle, since a texture can be reused
+ *  for an image of another format.
+ ***********************************************************/
+void TextureFormat::ApplySwizzle(GLenum target, int colorChannels)
+{
+	GLint swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+	if (colorChannels == 1)
+	{
+		swizzle[1] = GL_RED;
+		swizzle[2] = GL_RED;
+		swizzle[3] = GL_ONE;
+	}
+	else if (colorChannels == 2)
+	{
+		swizzle[1] = GL_RED;
+		swizzle[2] = GL_RED;
+		swizzle[3] = GL_GREEN;
+	}
+	glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+}
+
+/***********************************************************
+ *  PackImage()
+ *
+ *  This method is used for converting decoded pixels to the
+ *  smallest layout that keeps the image:
+ *    - gray RGB and gray opaque RGBA images become R8
+ *    - gray RGBA images with alpha become RG8
+ *    - color RGB images are expanded to RGBA8, which the
+ *      GPU stores anyway, so the upload is a plain copy
+ *  Returns the pixels to upload, in a buffer released with
+ *  ImageDecoder::FreeImage().
+ ***********************************************************/
+unsigned char* TextureFormat::PackImage(unsigned char* pixels, int width, int height, int& colorChannels)
+{
+	if ((NULL == pixels) || (colorChannels < 3))
+	{
+		return(pixels);
+	}
+
+	size_t texels = (size_t)width * height;
+	bool bGray = true;
+	bool bOpaque = true;
+	for (size_t i = 0; (i < texels) && bGray; i++)
+	{
+		const unsigned char* texel = pixels + i * colorChannels;
+		bGray = IsGrayTexel(texel);
+		if ((colorChannels == 4) && (texel[3] != 255))
+		{
+			bOpaque = false;
+		}
+	}
+	if ((bGray == false) && (colorChannels == 4))
+	{
+		return(pixels);
+	}
+
+	int packedChannels = 4;
+	if (bGray)
+	{
+		packedChannels = bOpaque ? 1 : 2;
+	}
+
+	// stb_image allocates with malloc(), see ImageDecoder::FreeImage()
+	unsigned char* packed = (unsigned char*)malloc(texels * packedChannels);
+	if (NULL == packed)
+	{
+		return(pixels);
+	}
+
+	for (size_t i = 0; i < texels; i++)
+	{
+		const unsigned char* source = pixels + i * colorChannels;
+		unsigned char* destination = packed + i * packedChannels;
+		if (packedChannels == 4)
+		{
+			destination[0] = source[0];
+			destination[1] = source[1];
+			destination[2] = source[2];
+			destination[3] = 255;
+		}
+		else
+		{
+			destination[0] = (unsigned char)((source[0] + source[1] + source[2] + 1) / 3);
+			if (packedChannels == 2)
+			{
+				destination[1] = source[3];
+			}
+		}
+	}
+
+	ImageDecoder::FreeImage(pixels);
+	colorChannels = packedChannels;
+	return(packed);
+}
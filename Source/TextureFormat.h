@@ -0,0 +1,48 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureformat.h
+// ============
+// choose the smallest OpenGL pixel format for decoded texture images
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+
+/***********************************************************
+ *  TextureFormat
+ *
+ *  This class maps the channel count of a decoded image to
+ *  the OpenGL format it is uploaded with.  Grayscale images
+ *  are stored as R8, and grayscale images with alpha as
+ *  RG8, with a texture swizzle so the shaders still sample
+ *  gray RGB colors.  RGB images are repacked to RGBA so the
+ *  upload is aligned and the driver does not have to
+ *  convert the texels itself.
+ ***********************************************************/
+class TextureFormat
+{
+public:
+	// sized internal format for a channel count
+	static GLenum GetInternalFormat(int colorChannels);
+	// pixel transfer format for a channel count
+	static GLenum GetFormat(int colorChannels);
+	// channel count of a pixel transfer format
+	static int GetColorChannels(GLenum format);
+	// name of the internal format, used in the load log
+	static const char* GetName(int colorChannels);
+	// name of any internal format, including the compressed ones
+	static const char* GetInternalFormatName(GLenum internalFormat);
+	// true for the block compressed internal formats
+	static bool IsCompressed(GLenum internalFormat);
+	// GPU bytes used by one texel, RGB8 is padded to four bytes
+	static int GetBytesPerPixel(int colorChannels);
+	// set the swizzle of the bound texture for a channel count
+	static void ApplySwizzle(GLenum target, int colorChannels);
+	// convert decoded pixels to the smallest format that keeps
+	// them unchanged, can run on any thread; the pixels passed
+	// in are freed when a converted copy is returned
+	static unsigned char* PackImage(unsigned char* pixels, int width, int height, int& colorChannels);
+};
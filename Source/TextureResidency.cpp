@@ -0,0 +1,488 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureresidency.cpp
+// ============
+// keep the GPU memory used by textures within a budget by dropping mip levels
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureResidency.h"
+
+#include <iostream>
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// textures are not reduced below this width or height
+	const int g_MinResidentSize = 64;
+
+	/***********************************************************
+	 *  GetBytesPerPixel()
+	 *
+	 *  Bytes used by one texel of an uncompressed format.
+	 ***********************************************************/
+	size_t GetBytesPerPixel(GLenum internalFormat)
+	{
+		switch (internalFormat)
+		{
+		case GL_R8:
+			return(1);
+		case GL_RG8:
+			return(2);
+		default:
+			// drivers pad RGB8 texels to four bytes
+			return(4);
+		}
+	}
+
+	/***********************************************************
+	 *  GetLevelSize()
+	 *
+	 *  Width or height of a mip level.
+	 ***********************************************************/
+	int GetLevelSize(int size, int level)
+	{
+		return(std::max(size >> level, 1));
+	}
+}
+
+/***********************************************************
+ *  TextureResidency()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureResidency::TextureResidency()
+{
+	m_budgetBytes = 0;
+	m_residentBytes = 0;
+	m_frame = 1;
+	m_bCopySupported = false;
+	m_bQueriedSupport = false;
+	// restores are uploaded mid frame, keep the mipmaps off the driver
+	m_restorePool.SetGenerateMipmaps(true);
+}
+
+/***********************************************************
+ *  ~TextureResidency()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureResidency::~TextureResidency()
+{
+	// wait for the restores still decoding before freeing them
+	while (m_restorePool.WaitForFinishedImage() != -1)
+	{
+	}
+	m_restorePool.Reset();
+}
+
+/***********************************************************
+ *  SetCompressionCache()
+ *
+ *  This method is used for choosing whether the restored
+ *  images are block compressed like the original textures.
+ ***********************************************************/
+void TextureResidency::SetCompressionCache(const std::string& directory)
+{
+	m_restorePool.SetCompressionCache(directory);
+}
+
+/***********************************************************
+ *  SetGenerateMipmaps()
+ *
+ *  This method is used for choosing whether the mipmaps of
+ *  the restored images are built on the decode threads or
+ *  by the driver, the same way as the original textures.
+ ***********************************************************/
+void TextureResidency::SetGenerateMipmaps(bool bGenerate)
+{
+	m_restorePool.SetGenerateMipmaps(bGenerate);
+}
+
+/***********************************************************
+ *  SetBudget()
+ *
+ *  This method is used for setting the GPU memory budget
+ *  for the tracked textures.  It is applied on the next
+ *  call to EnforceBudget().
+ ***********************************************************/
+void TextureResidency::SetBudget(size_t budgetBytes)
+{
+	m_budgetBytes = budgetBytes;
+}
+
+/***********************************************************
+ *  Track()
+ *
+ *  This method is used for starting to track a loaded
+ *  texture.  The size of each mip level is read back from
+ *  OpenGL, so any internal format can be tracked.
+ ***********************************************************/
+void TextureResidency::Track(GLuint textureID, const std::string& filename)
+{
+	if ((textureID == 0) || (m_textures.find(textureID) != m_textures.end()))
+	{
+		return;
+	}
+
+	GLint previousTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	RESIDENT_TEXTURE texture;
+	texture.filename = filename;
+	texture.droppedLevels = 0;
+	texture.lastUse = m_frame;
+	texture.bRestoreRequested = false;
+	texture.restoreJob = -1;
+
+	GLint value = 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &value);
+	texture.internalFormat = (GLenum)value;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &texture.width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &texture.height);
+
+	GLint maxLevel = 0;
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+	for (int level = 0; level <= maxLevel; level++)
+	{
+		GLint width = 0;
+		GLint height = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+		if ((width == 0) || (height == 0))
+		{
+			break;
+		}
+
+		GLint bCompressed = GL_FALSE;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &bCompressed);
+		if (bCompressed == GL_TRUE)
+		{
+			GLint compressedSize = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &compressedSize);
+			texture.levelBytes.push_back((size_t)compressedSize);
+		}
+		else
+		{
+			texture.levelBytes.push_back((size_t)width * height * GetBytesPerPixel(texture.internalFormat));
+		}
+
+		if ((width == 1) && (height == 1))
+		{
+			break;
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, (GLuint)previousTexture);
+
+	m_residentBytes += GetTextureBytes(texture);
+	m_textures[textureID] = texture;
+}
+
+/***********************************************************
+ *  Untrack()
+ *
+ *  This method is used for stopping tracking of a texture
+ *  that is about to be deleted.
+ ***********************************************************/
+bool TextureResidency::Untrack(GLuint textureID)
+{
+	std::unordered_map<GLuint, RESIDENT_TEXTURE>::iterator tracked = m_textures.find(textureID);
+	if (tracked == m_textures.end())
+	{
+		return(false);
+	}
+
+	m_residentBytes -= GetTextureBytes(tracked->second);
+	if (tracked->second.restoreJob != -1)
+	{
+		// the decoded image is discarded when it is collected
+		m_restoreJobs[tracked->second.restoreJob] = 0;
+	}
+	m_textures.erase(tracked);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Touch()
+ *
+ *  This method is used for marking a texture as drawn in
+ *  the current frame.  A reduced texture is queued to be
+ *  restored to full size.
+ ***********************************************************/
+void TextureResidency::Touch(GLuint textureID)
+{
+	std::unordered_map<GLuint, RESIDENT_TEXTURE>::iterator tracked = m_textures.find(textureID);
+	if (tracked != m_textures.end())
+	{
+		tracked->second.lastUse = m_frame;
+		if (tracked->second.droppedLevels > 0)
+		{
+			tracked->second.bRestoreRequested = true;
+		}
+	}
+}
+
+/***********************************************************
+ *  EnforceBudget()
+ *
+ *  This method is used once per frame for dropping the top
+ *  mip level of the least recently used textures until the
+ *  budget is met, and for queueing the restore of the
+ *  referenced textures that fit in the budget again.  The
+ *  textures reallocated at a smaller size are returned so
+ *  their slots can be updated.
+ ***********************************************************/
+void TextureResidency::EnforceBudget(std::vector<TEXTURE_REPLACEMENT>& replaced)
+{
+	if (m_bQueriedSupport == false)
+	{
+		m_bCopySupported = (GLEW_ARB_copy_image || GLEW_VERSION_4_3) && (GLEW_ARB_texture_storage || GLEW_VERSION_4_3);
+		m_bQueriedSupport = true;
+		if ((m_bCopySupported == false) && (m_budgetBytes > 0))
+		{
+			std::cout << "Texture budget: image copies are not supported, the budget is not enforced" << std::endl;
+		}
+	}
+
+	// without image copies a dropped level cannot be released,
+	// so reducing textures would cost quality and free nothing
+	while (m_bCopySupported && (m_budgetBytes > 0) && (m_residentBytes > m_budgetBytes))
+	{
+		// prefer textures that were not drawn in the last frame,
+		// then the ones drawn earliest, then the largest
+		std::unordered_map<GLuint, RESIDENT_TEXTURE>::iterator victim = m_textures.end();
+		std::unordered_map<GLuint, RESIDENT_TEXTURE>::iterator it;
+		for (it = m_textures.begin(); it != m_textures.end(); it++)
+		{
+			const RESIDENT_TEXTURE& texture = it->second;
+			int nextLevel = texture.droppedLevels + 1;
+			if ((nextLevel >= (int)texture.levelBytes.size()) ||
+				(GetLevelSize(texture.width, nextLevel) < g_MinResidentSize) ||
+				(GetLevelSize(texture.height, nextLevel) < g_MinResidentSize) ||
+				(texture.restoreJob != -1))
+			{
+				continue;
+			}
+			if ((victim == m_textures.end()) ||
+				(texture.lastUse < victim->second.lastUse) ||
+				((texture.lastUse == victim->second.lastUse) && (GetTextureBytes(texture) > GetTextureBytes(victim->second))))
+			{
+				victim = it;
+			}
+		}
+		if (victim == m_textures.end())
+		{
+			break;
+		}
+
+		GLuint oldID = victim->first;
+		RESIDENT_TEXTURE texture = victim->second;
+		m_textures.erase(victim);
+
+		GLuint textureID = oldID;
+		size_t previousBytes = GetTextureBytes(texture);
+		if (DropLevel(textureID, texture) == false)
+		{
+			// keep the texture tracked, but do not try it again this frame
+			m_textures[oldID] = texture;
+			break;
+		}
+		m_residentBytes = m_residentBytes - previousBytes + GetTextureBytes(texture);
+		m_textures[textureID] = texture;
+
+		if (textureID != oldID)
+		{
+			TEXTURE_REPLACEMENT replacement;
+			replacement.oldID = oldID;
+			replacement.newID = textureID;
+			replaced.push_back(replacement);
+		}
+
+		std::cout << "Texture budget: reduced " << texture.filename << " to " << GetLevelSize(texture.width, texture.droppedLevels) << "x" << GetLevelSize(texture.height, texture.droppedLevels) << ", resident " << (m_residentBytes / 1024) << " KB" << std::endl;
+	}
+
+	// restore the reduced textures that were drawn, if they fit
+	std::unordered_map<GLuint, RESIDENT_TEXTURE>::iterator it;
+	for (it = m_textures.begin(); it != m_textures.end(); it++)
+	{
+		RESIDENT_TEXTURE& texture = it->second;
+		if ((texture.bRestoreRequested == false) || (texture.restoreJob != -1))
+		{
+			continue;
+		}
+
+		size_t fullBytes = 0;
+		for (size_t i = 0; i < texture.levelBytes.size(); i++)
+		{
+			fullBytes += texture.levelBytes[i];
+		}
+		if ((m_budgetBytes > 0) && (m_residentBytes - GetTextureBytes(texture) + fullBytes > m_budgetBytes))
+		{
+			// still does not fit, wait until the texture is drawn again
+		}
+		else
+		{
+			texture.restoreJob = m_restorePool.QueueImage(texture.filename.c_str());
+			m_restoreJobs[texture.restoreJob] = it->first;
+		}
+		texture.bRestoreRequested = false;
+	}
+
+	m_frame++;
+}
+
+/***********************************************************
+ *  DropLevel()
+ *
+ *  This method is used for dropping the top resident mip
+ *  level of a texture.  The remaining levels are copied
+ *  into a new, smaller texture so the memory is released.
+ *  It needs image copies and immutable texture storage.
+ ***********************************************************/
+bool TextureResidency::DropLevel(GLuint& textureID, RESIDENT_TEXTURE& texture)
+{
+	int firstLevel = texture.droppedLevels + 1;
+	int levelCount = (int)texture.levelBytes.size() - firstLevel;
+	if ((levelCount < 1) || (m_bCopySupported == false))
+	{
+		return(false);
+	}
+
+	GLint previousTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+
+	GLint swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+	GLuint smallerID = 0;
+	glGenTextures(1, &smallerID);
+	glBindTexture(GL_TEXTURE_2D, smallerID);
+	glTexStorage2D(GL_TEXTURE_2D, levelCount, texture.internalFormat,
+		GetLevelSize(texture.width, firstLevel), GetLevelSize(texture.height, firstLevel));
+
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// keep the swizzle of R8 and RG8 textures
+	glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+	glBindTexture(GL_TEXTURE_2D, (GLuint)previousTexture);
+
+	// level 0 of the current texture is the first resident level
+	for (int i = 0; i < levelCount; i++)
+	{
+		glCopyImageSubData(
+			textureID, GL_TEXTURE_2D, i + 1, 0, 0, 0,
+			smallerID, GL_TEXTURE_2D, i, 0, 0, 0,
+			GetLevelSize(texture.width, firstLevel + i), GetLevelSize(texture.height, firstLevel + i), 1);
+	}
+
+	textureID = smallerID;
+	texture.droppedLevels = firstLevel;
+
+	return(true);
+}
+
+/***********************************************************
+ *  PollRestoredImage()
+ *
+ *  This method is used for collecting the decoded image of
+ *  a texture being restored, without waiting.  The image
+ *  stays valid until the next call.  Returns NULL when no
+ *  image is ready.
+ ***********************************************************/
+const TextureDecodePool::DECODE_JOB* TextureResidency::PollRestoredImage(GLuint& textureID)
+{
+	// the images of the finished batch are freed once all are collected
+	if ((m_restoreJobs.size() == 0) && (m_restorePool.HasOutstandingImages() == false))
+	{
+		m_restorePool.Reset();
+		return(NULL);
+	}
+
+	int jobIndex = m_restorePool.PollFinishedImage();
+	while (jobIndex != -1)
+	{
+		std::unordered_map<int, GLuint>::iterator restore = m_restoreJobs.find(jobIndex);
+		textureID = (restore != m_restoreJobs.end()) ? restore->second : 0;
+		if (restore != m_restoreJobs.end())
+		{
+			m_restoreJobs.erase(restore);
+		}
+
+		const TextureDecodePool::DECODE_JOB& job = m_restorePool.GetJob(jobIndex);
+		std::unordered_map<GLuint, RESIDENT_TEXTURE>::iterator tracked = m_textures.find(textureID);
+		if (tracked != m_textures.end())
+		{
+			tracked->second.restoreJob = -1;
+			if ((NULL != job.image) || (NULL != job.container))
+			{
+				return(&job);
+			}
+			std::cout << "Could not restore image:" << job.filename << std::endl;
+		}
+		jobIndex = m_restorePool.PollFinishedImage();
+	}
+
+	return(NULL);
+}
+
+/***********************************************************
+ *  FinishRestore()
+ *
+ *  This method is used for replacing a reduced texture with
+ *  the full size texture uploaded from the restored image.
+ ***********************************************************/
+void TextureResidency::FinishRestore(GLuint oldID, GLuint newID)
+{
+	std::unordered_map<GLuint, RESIDENT_TEXTURE>::iterator tracked = m_textures.find(oldID);
+	if (tracked == m_textures.end())
+	{
+		return;
+	}
+
+	std::string filename = tracked->second.filename;
+	Untrack(oldID);
+	Track(newID, filename);
+	m_textures[newID].lastUse = m_frame;
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  This method is used for stopping tracking of all of the
+ *  textures.  Restores still decoding are discarded.
+ ***********************************************************/
+void TextureResidency::Reset()
+{
+	std::unordered_map<int, GLuint>::iterator restore;
+	for (restore = m_restoreJobs.begin(); restore != m_restoreJobs.end(); restore++)
+	{
+		restore->second = 0;
+	}
+	m_textures.clear();
+	m_residentBytes = 0;
+}
+
+/***********************************************************
+ *  GetTextureBytes()
+ *
+ *  This method is used for getting the bytes used by the
+ *  resident levels of a texture.
+ ***********************************************************/
+size_t TextureResidency::GetTextureBytes(const RESIDENT_TEXTURE& texture) const
+{
+	size_t total = 0;
+	for (size_t i = texture.droppedLevels; i < texture.levelBytes.size(); i++)
+	{
+		total += texture.levelBytes[i];
+	}
+	return(total);
+}
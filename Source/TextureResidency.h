@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureresidency.h
+// ============
+// keep the GPU memory used by textures within a budget by dropping mip levels
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureDecodePool.h"
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+/***********************************************************
+ *  TextureResidency
+ *
+ *  This class tracks how many bytes each texture uses on
+ *  the GPU.  When the total is over the budget, the top mip
+ *  levels of the least recently used textures are dropped
+ *  by reallocating them at a smaller size.  A reduced
+ *  texture that is referenced again is decoded from its
+ *  image file in the background and restored once the
+ *  budget has room for it.
+ ***********************************************************/
+class TextureResidency
+{
+public:
+	// constructor
+	TextureResidency();
+	// destructor
+	~TextureResidency();
+
+	// a texture that was reallocated and must replace the old one
+	struct TEXTURE_REPLACEMENT
+	{
+		GLuint oldID;
+		GLuint newID;
+	};
+
+	// set the budget in bytes, 0 for no limit
+	void SetBudget(size_t budgetBytes);
+	// block compress the restored images, cached in this directory
+	void SetCompressionCache(const std::string& directory);
+	// build the mipmaps of the restored images on the decode threads
+	void SetGenerateMipmaps(bool bGenerate);
+	size_t GetBudget() const { return(m_budgetBytes); }
+	// GPU memory currently used by the tracked textures
+	size_t GetResidentBytes() const { return(m_residentBytes); }
+
+	// start tracking a loaded texture and the file it came from
+	void Track(GLuint textureID, const std::string& filename);
+	// stop tracking a texture, returns false if it was not tracked
+	bool Untrack(GLuint textureID);
+	// mark a texture as used by the current frame
+	void Touch(GLuint textureID);
+	// drop mip levels until the budget is met, queue the restore
+	// of referenced textures, and advance to the next frame
+	void EnforceBudget(std::vector<TEXTURE_REPLACEMENT>& replaced);
+	// get a decoded image for a restore, NULL when none is ready
+	const TextureDecodePool::DECODE_JOB* PollRestoredImage(GLuint& textureID);
+	// record that a texture was restored into a new full size texture
+	void FinishRestore(GLuint oldID, GLuint newID);
+	// stop tracking all textures
+	void Reset();
+
+private:
+	struct RESIDENT_TEXTURE
+	{
+		std::string filename;
+		GLenum internalFormat;
+		// size of level 0 of the full texture
+		int width;
+		int height;
+		// bytes used by each level of the full mip chain
+		std::vector<size_t> levelBytes;
+		// number of top levels that are not resident
+		int droppedLevels;
+		// frame the texture was last drawn in
+		uint64_t lastUse;
+		// true when the texture was drawn while reduced
+		bool bRestoreRequested;
+		// restore job in the decode pool, or -1
+		int restoreJob;
+	};
+
+	// bytes used by the resident levels of a texture
+	size_t GetTextureBytes(const RESIDENT_TEXTURE& texture) const;
+	// drop the top resident level of a texture
+	bool DropLevel(GLuint& textureID, RESIDENT_TEXTURE& texture);
+
+	// tracked textures, keyed by texture ID
+	std::unordered_map<GLuint, RESIDENT_TEXTURE> m_textures;
+	// decodes the image files of textures being restored
+	TextureDecodePool m_restorePool;
+	// texture ID of each queued restore job
+	std::unordered_map<int, GLuint> m_restoreJobs;
+	// budget in bytes, 0 for no limit
+	size_t m_budgetBytes;
+	// sum of the resident bytes of all tracked textures
+	size_t m_residentBytes;
+	// frame counter, advanced by EnforceBudget()
+	uint64_t m_frame;
+	// true when levels can be copied into a smaller texture
+	bool m_bCopySupported;
+	bool m_bQueriedSupport;
+};
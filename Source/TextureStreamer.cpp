@@ -0,0 +1,545 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturestreamer.cpp
+// ============
+// stream textures in the background - a loader thread with a shared OpenGL
+// context uploads decoded images through pixel buffer objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureStreamer.h"
+#include "TextureContainer.h"
+#include "MipChain.h"
+#include "ImageDecoder.h"
+#include "TextureFormat.h"
+
+#include "GLFW/glfw3.h"
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+/***********************************************************
+ *  TextureStreamer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureStreamer::TextureStreamer()
+{
+	m_pLoaderWindow = NULL;
+	m_outstandingTextures = 0;
+	m_bShutdown = false;
+	m_activeJobs = 0;
+}
+
+/***********************************************************
+ *  ~TextureStreamer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureStreamer::~TextureStreamer()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for creating the hidden window that
+ *  shares objects with the current context and starting
+ *  the loader thread that makes it current.
+ ***********************************************************/
+bool TextureStreamer::Start()
+{
+	if (NULL != m_pLoaderWindow)
+	{
+		return(true);
+	}
+
+	GLFWwindow* pMainWindow = glfwGetCurrentContext();
+	if (NULL == pMainWindow)
+	{
+		return(false);
+	}
+
+	// the context version hints set at startup are still active
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	m_pLoaderWindow = glfwCreateWindow(1, 1, "texture loader", NULL, pMainWindow);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (NULL == m_pLoaderWindow)
+	{
+		std::cout << "Failed to create the texture streaming context" << std::endl;
+		return(false);
+	}
+
+	m_bShutdown = false;
+	m_loaderThread = std::thread(&TextureStreamer::LoaderThread, this);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for stopping the loader thread and
+ *  freeing any uploads that were never collected.  A
+ *  texture handed to the render thread belongs to it, the
+ *  others are deleted here, as nothing else knows of them.
+ ***********************************************************/
+void TextureStreamer::Stop()
+{
+	if (NULL == m_pLoaderWindow)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bShutdown = true;
+	}
+	m_requestQueued.notify_all();
+	m_loaderThread.join();
+
+	while (m_uploaded.size() > 0)
+	{
+		STREAMED_TEXTURE& texture = m_uploaded.front();
+		if (NULL != texture.fence)
+		{
+			glDeleteSync(texture.fence);
+		}
+		m_uploaded.pop_front();
+	}
+	m_requests.clear();
+	m_outstandingTextures = 0;
+
+	// every uploaded texture is in the streamed map, including the
+	// ones only waiting in the uploaded queue
+	std::unordered_map<uint64_t, STREAMED_TEXTURE>::iterator streamed;
+	for (streamed = m_streamedTextures.begin(); streamed != m_streamedTextures.end(); streamed++)
+	{
+		GLuint textureID = streamed->second.textureID;
+		if ((textureID != 0) && (m_collectedTextures.find(textureID) == m_collectedTextures.end()))
+		{
+			glDeleteTextures(1, &textureID);
+		}
+	}
+	m_streamedTextures.clear();
+	m_collectedTextures.clear();
+	m_jobSlots.clear();
+	m_duplicateJobs.clear();
+	m_activeJobs = 0;
+
+	glfwDestroyWindow(m_pLoaderWindow);
+	m_pLoaderWindow = NULL;
+}
+
+/***********************************************************
+ *  QueueTexture()
+ *
+ *  This method is used for queueing an image file to be
+ *  streamed into the passed in texture slot.
+ ***********************************************************/
+void TextureStreamer::QueueTexture(const char* filename, int slot)
+{
+	STREAM_REQUEST request;
+	request.filename = filename;
+	request.slot = slot;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back(request);
+		m_outstandingTextures++;
+	}
+	m_requestQueued.notify_one();
+}
+
+/***********************************************************
+ *  SetGenerateMipmaps()
+ *
+ *  This method is used for choosing whether the mipmaps of
+ *  the streamed textures are built on the decode threads.
+ ***********************************************************/
+void TextureStreamer::SetGenerateMipmaps(bool bGenerate)
+{
+	m_decodePool.SetGenerateMipmaps(bGenerate);
+}
+
+/***********************************************************
+ *  SetCompressionCache()
+ *
+ *  This method is used for choosing whether the streamed
+ *  textures are block compressed on the decode threads.
+ ***********************************************************/
+void TextureStreamer::SetCompressionCache(const std::string& directory)
+{
+	m_decodePool.SetCompressionCache(directory);
+}
+
+/***********************************************************
+ *  PollResidentTexture()
+ *
+ *  This method is used for getting a streamed texture whose
+ *  upload fence has signalled.  It never blocks; textures
+ *  that failed to load are returned with an ID of 0.
+ ***********************************************************/
+bool TextureStreamer::PollResidentTexture(STREAMED_TEXTURE& texture)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::deque<STREAMED_TEXTURE>::iterator uploaded;
+	for (uploaded = m_uploaded.begin(); uploaded != m_uploaded.end(); uploaded++)
+	{
+		bool bResident = true;
+		if (NULL != uploaded->fence)
+		{
+			GLenum result = glClientWaitSync(uploaded->fence, 0, 0);
+			bResident = ((result == GL_ALREADY_SIGNALED) || (result == GL_CONDITION_SATISFIED));
+			if (bResident)
+			{
+				glDeleteSync(uploaded->fence);
+				uploaded->fence = NULL;
+			}
+		}
+
+		if (bResident)
+		{
+			texture = *uploaded;
+			if (texture.textureID != 0)
+			{
+				m_collectedTextures.insert(texture.textureID);
+			}
+			m_uploaded.erase(uploaded);
+			m_outstandingTextures--;
+			return(true);
+		}
+	}
+
+	return(false);
+}
+
+/***********************************************************
+ *  IsIdle()
+ *
+ *  This method is used for checking whether every queued
+ *  texture has been collected by the render thread.
+ ***********************************************************/
+bool TextureStreamer::IsIdle()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return(m_outstandingTextures == 0);
+}
+
+/***********************************************************
+ *  LoaderThread()
+ *
+ *  This method is the main loop of the loader thread.  It
+ *  feeds requests to the decode pool and uploads each image
+ *  as soon as it has been decoded.
+ ***********************************************************/
+void TextureStreamer::LoaderThread()
+{
+	glfwMakeContextCurrent(m_pLoaderWindow);
+
+	while (true)
+	{
+		std::deque<STREAM_REQUEST> requests;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_requestQueued.wait(lock, [this] { return(m_bShutdown || (m_requests.size() > 0) || (m_activeJobs > 0)); });
+			if (m_bShutdown)
+			{
+				break;
+			}
+			requests.swap(m_requests);
+		}
+
+		// a new batch starts once the previous one is fully uploaded
+		if ((m_activeJobs == 0) && (requests.size() > 0))
+		{
+			m_decodePool.Reset();
+			m_jobSlots.clear();
+
+			std::unordered_map<uint64_t, STREAMED_TEXTURE>::iterator streamed;
+			for (streamed = m_streamedTextures.begin(); streamed != m_streamedTextures.end(); streamed++)
+			{
+				if (streamed->second.textureID != 0)
+				{
+					m_decodePool.MarkImageLoaded(streamed->first);
+				}
+			}
+		}
+		for (size_t i = 0; i < requests.size(); i++)
+		{
+			int jobIndex = m_decodePool.QueueImage(requests[i].filename.c_str());
+			m_jobSlots[jobIndex] = requests[i].slot;
+			m_activeJobs++;
+		}
+
+		int jobIndex = m_decodePool.WaitForFinishedImage();
+		if (jobIndex == -1)
+		{
+			continue;
+		}
+		m_activeJobs--;
+
+		TextureDecodePool::DECODE_JOB& job = m_decodePool.GetJob(jobIndex);
+		int slot = m_jobSlots[jobIndex];
+		if (job.bSuccess == false)
+		{
+			std::cout << "Could not load image:" << job.filename << std::endl;
+			PublishTexture(slot, 0, 0, 0);
+
+			// jobs sharing these contents fail as well
+			if ((job.duplicateOf == -1) && (job.contentHash != 0))
+			{
+				STREAMED_TEXTURE failed;
+				failed.slot = slot;
+				failed.textureID = 0;
+				failed.contentHash = job.contentHash;
+				failed.byteSize = 0;
+				failed.fence = NULL;
+				m_streamedTextures[job.contentHash] = failed;
+			}
+		}
+		else if (job.bAlreadyLoaded)
+		{
+			const STREAMED_TEXTURE& streamed = m_streamedTextures[job.contentHash];
+			PublishTexture(slot, streamed.textureID, streamed.contentHash, streamed.byteSize);
+		}
+		else if (job.duplicateOf != -1)
+		{
+			m_duplicateJobs.push_back(jobIndex);
+		}
+		else
+		{
+			size_t byteSize = 0;
+			GLuint textureID = UploadThroughPBO(job, byteSize);
+
+			// the decoded data is no longer needed once it is in the PBO
+			if (NULL != job.image)
+			{
+				ImageDecoder::FreeImage(job.image);
+				job.image = NULL;
+			}
+			if (NULL != job.container)
+			{
+				delete job.container;
+				job.container = NULL;
+			}
+			if (NULL != job.mipChain)
+			{
+				delete job.mipChain;
+				job.mipChain = NULL;
+			}
+
+			STREAMED_TEXTURE streamed;
+			streamed.slot = slot;
+			streamed.textureID = textureID;
+			streamed.contentHash = job.contentHash;
+			streamed.byteSize = byteSize;
+			streamed.fence = NULL;
+			m_streamedTextures[job.contentHash] = streamed;
+
+			PublishTexture(slot, textureID, job.contentHash, byteSize);
+		}
+
+		PublishDuplicates();
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
+
+/***********************************************************
+ *  UploadThroughPBO()
+ *
+ *  This method is used for copying the decoded image into a
+ *  pixel buffer object and creating the texture from it,
+ *  so the driver can transfer the data asynchronously.
+ ***********************************************************/
+GLuint TextureStreamer::UploadThroughPBO(const TextureDecodePool::DECODE_JOB& job, size_t& byteSize)
+{
+	byteSize = 0;
+	if ((job.colorChannels < 1) || (job.colorChannels > 4))
+	{
+		std::cout << "Not implemented to handle image with " << job.colorChannels << " channels" << std::endl;
+		return(0);
+	}
+
+	// grayscale textures are stored in one or two channels
+	GLenum internalFormat = TextureFormat::GetInternalFormat(job.colorChannels);
+	GLenum format = TextureFormat::GetFormat(job.colorChannels);
+
+	// lay out every level that will be uploaded inside the PBO
+	std::vector<size_t> levelOffsets;
+	size_t bufferSize = 0;
+	if (NULL != job.container)
+	{
+		for (uint32_t i = 0; i < job.container->GetHeader().levelCount; i++)
+		{
+			levelOffsets.push_back(bufferSize);
+			bufferSize += (size_t)job.container->GetLevel(i).size;
+		}
+	}
+	else
+	{
+		levelOffsets.push_back(0);
+		bufferSize = (size_t)job.width * job.height * job.colorChannels;
+		if (NULL != job.mipChain)
+		{
+			for (int i = 1; i < job.mipChain->GetLevelCount(); i++)
+			{
+				levelOffsets.push_back(bufferSize);
+				bufferSize += job.mipChain->GetLevel(i).size;
+			}
+		}
+	}
+
+	GLuint pixelBuffer = 0;
+	glGenBuffers(1, &pixelBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bufferSize, NULL, GL_STREAM_DRAW);
+
+	unsigned char* pMapped = (unsigned char*)glMapBufferRange(
+		GL_PIXEL_UNPACK_BUFFER, 0, bufferSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (NULL == pMapped)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &pixelBuffer);
+		return(0);
+	}
+	if (NULL != job.container)
+	{
+		for (uint32_t i = 0; i < job.container->GetHeader().levelCount; i++)
+		{
+			memcpy(pMapped + levelOffsets[i], job.container->GetLevelData(i), (size_t)job.container->GetLevel(i).size);
+		}
+	}
+	else
+	{
+		memcpy(pMapped, job.image, (size_t)job.width * job.height * job.colorChannels);
+		for (size_t i = 1; i < levelOffsets.size(); i++)
+		{
+			memcpy(pMapped + levelOffsets[i], job.mipChain->GetLevelData((int)i), job.mipChain->GetLevel((int)i).size);
+		}
+	}
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	GLuint textureID = 0;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	TextureFormat::ApplySwizzle(GL_TEXTURE_2D, job.colorChannels);
+
+	// the texture data pointers are offsets into the bound PBO
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (NULL != job.container)
+	{
+		// the container may hold compressed blocks instead of pixels
+		GLenum containerFormat = job.container->GetHeader().internalFormat;
+		for (uint32_t i = 0; i < job.container->GetHeader().levelCount; i++)
+		{
+			const TextureContainer::CONTAINER_LEVEL& level = job.container->GetLevel(i);
+			if (job.container->IsCompressed())
+			{
+				glCompressedTexImage2D(GL_TEXTURE_2D, i, containerFormat, level.width, level.height, 0, (GLsizei)level.size, (const void*)levelOffsets[i]);
+			}
+			else
+			{
+				glTexImage2D(GL_TEXTURE_2D, i, containerFormat, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, (const void*)levelOffsets[i]);
+			}
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, job.container->GetHeader().levelCount - 1);
+	}
+	else if (NULL != job.mipChain)
+	{
+		// the decode threads already built the mipmaps
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, job.width, job.height, 0, format, GL_UNSIGNED_BYTE, (const void*)0);
+		for (size_t i = 1; i < levelOffsets.size(); i++)
+		{
+			const MipChain::MIP_LEVEL& level = job.mipChain->GetLevel((int)i);
+			glTexImage2D(GL_TEXTURE_2D, (GLint)i, internalFormat, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, (const void*)levelOffsets[i]);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levelOffsets.size() - 1);
+	}
+	else
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, job.width, job.height, 0, format, GL_UNSIGNED_BYTE, (const void*)0);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	// the buffer is released by the driver once the upload is done
+	glDeleteBuffers(1, &pixelBuffer);
+
+	if (NULL != job.container)
+		byteSize = job.container->GetTotalBytes();
+	else if (NULL != job.mipChain)
+		byteSize = bufferSize;
+	else
+		byteSize = bufferSize * 4 / 3;
+
+	std::cout << "Streamed image:" << job.filename << ", width:" << job.width << ", height:" << job.height << ", channels:" << job.colorChannels << std::endl;
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  PublishTexture()
+ *
+ *  This method is used for handing an uploaded texture to
+ *  the render thread together with a fence that signals
+ *  when the upload commands have completed.
+ ***********************************************************/
+void TextureStreamer::PublishTexture(int slot, GLuint textureID, uint64_t contentHash, size_t byteSize)
+{
+	STREAMED_TEXTURE texture;
+	texture.slot = slot;
+	texture.textureID = textureID;
+	texture.contentHash = contentHash;
+	texture.byteSize = byteSize;
+	texture.fence = NULL;
+
+	if (textureID != 0)
+	{
+		texture.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		// the fence must reach the GPU for the other context to see it
+		glFlush();
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_uploaded.push_back(texture);
+}
+
+/***********************************************************
+ *  PublishDuplicates()
+ *
+ *  This method is used for publishing the jobs that share
+ *  the image contents of a job that has now been uploaded.
+ ***********************************************************/
+void TextureStreamer::PublishDuplicates()
+{
+	std::deque<int>::iterator duplicate = m_duplicateJobs.begin();
+	while (duplicate != m_duplicateJobs.end())
+	{
+		TextureDecodePool::DECODE_JOB& job = m_decodePool.GetJob(*duplicate);
+		std::unordered_map<uint64_t, STREAMED_TEXTURE>::iterator streamed = m_streamedTextures.find(job.contentHash);
+
+		// failed uploads are recorded with a texture ID of 0
+		if (streamed != m_streamedTextures.end())
+		{
+			PublishTexture(m_jobSlots[*duplicate], streamed->second.textureID, streamed->second.contentHash, streamed->second.byteSize);
+			duplicate = m_duplicateJobs.erase(duplicate);
+		}
+		else
+		{
+			duplicate++;
+		}
+	}
+}
@@ -0,0 +1,118 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturestreamer.h
+// ============
+// stream textures in the background - a loader thread with a shared OpenGL
+// context uploads decoded images through pixel buffer objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureDecodePool.h"
+
+#include <GL/glew.h>
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+struct GLFWwindow;
+
+/***********************************************************
+ *  TextureStreamer
+ *
+ *  This class loads textures without blocking the render
+ *  thread.  Images are decoded by a TextureDecodePool and
+ *  uploaded on a loader thread that owns a hidden window
+ *  sharing objects with the main OpenGL context.  Every
+ *  upload goes through a pixel buffer object and is guarded
+ *  by a fence; the render thread only starts using a
+ *  texture once its fence has signalled.
+ ***********************************************************/
+class TextureStreamer
+{
+public:
+	// constructor
+	TextureStreamer();
+	// destructor
+	~TextureStreamer();
+
+	struct STREAMED_TEXTURE
+	{
+		// texture slot the texture was requested for
+		int slot;
+		GLuint textureID;
+		uint64_t contentHash;
+		size_t byteSize;
+		// signalled when the upload is complete on the GPU
+		GLsync fence;
+	};
+
+	// create the shared context and start the loader thread,
+	// must be called on the thread owning the current context
+	bool Start();
+	// stop the loader thread and destroy the shared context
+	void Stop();
+	// queue an image file to be streamed into a texture slot
+	void QueueTexture(const char* filename, int slot);
+	// build mipmaps on the decode threads instead of the driver
+	void SetGenerateMipmaps(bool bGenerate);
+	// block compress textures on the decode threads, cached in a directory
+	void SetCompressionCache(const std::string& directory);
+	// get the next streamed texture that is resident on the GPU
+	bool PollResidentTexture(STREAMED_TEXTURE& texture);
+	// true when every queued texture has been collected
+	bool IsIdle();
+
+private:
+	struct STREAM_REQUEST
+	{
+		std::string filename;
+		int slot;
+	};
+
+	// hidden window owning the loader thread context
+	GLFWwindow* m_pLoaderWindow;
+	// background thread uploading the decoded images
+	std::thread m_loaderThread;
+	// guards the request and completion queues
+	std::mutex m_mutex;
+	// signalled when a request is queued or the loader stops
+	std::condition_variable m_requestQueued;
+	// requests not yet handed to the decode pool
+	std::deque<STREAM_REQUEST> m_requests;
+	// uploads waiting for their fence to signal
+	std::deque<STREAMED_TEXTURE> m_uploaded;
+	// requests queued but not yet collected
+	int m_outstandingTextures;
+	// textures handed to the render thread, which then owns them
+	std::unordered_set<GLuint> m_collectedTextures;
+	// true when the loader thread should exit
+	bool m_bShutdown;
+
+	// the following members are only used by the loader thread
+	// decode workers feeding the loader thread
+	TextureDecodePool m_decodePool;
+	// texture slots of the jobs in the decode pool
+	std::unordered_map<int, int> m_jobSlots;
+	// textures already streamed, keyed by content hash
+	std::unordered_map<uint64_t, STREAMED_TEXTURE> m_streamedTextures;
+	// jobs waiting for the job decoding the same image contents
+	std::deque<int> m_duplicateJobs;
+	// jobs queued in the decode pool but not yet uploaded
+	int m_activeJobs;
+
+	// loader thread main loop
+	void LoaderThread();
+	// upload a decoded image through a pixel buffer object
+	GLuint UploadThroughPBO(const TextureDecodePool::DECODE_JOB& job, size_t& byteSize);
+	// hand a finished texture to the render thread
+	void PublishTexture(int slot, GLuint textureID, uint64_t contentHash, size_t byteSize);
+	// resolve the duplicate jobs whose image contents are now uploaded
+	void PublishDuplicates();
+};
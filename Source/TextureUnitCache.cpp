@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureunitcache.cpp
+// ============
+// bind textures to OpenGL texture units on demand with LRU eviction
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureUnitCache.h"
+
+/***********************************************************
+ *  TextureUnitCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureUnitCache::TextureUnitCache()
+{
+	m_firstUnit = 0;
+	m_useCounter = 0;
+	m_bindCount = 0;
+	m_hitCount = 0;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for choosing the range of texture
+ *  units that the cache manages.
+ ***********************************************************/
+void TextureUnitCache::Initialize(int firstUnit, int unitCount)
+{
+	m_firstUnit = firstUnit;
+	m_units.resize(unitCount > 0 ? unitCount : 1);
+	Reset();
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for making a texture resident on one
+ *  of the managed units.  A resident texture only refreshes
+ *  its use time; otherwise it replaces the texture on the
+ *  least recently used unit.
+ ***********************************************************/
+int TextureUnitCache::Bind(GLenum target, GLuint textureID)
+{
+	if (m_units.size() == 0)
+	{
+		return(-1);
+	}
+	m_useCounter++;
+
+	std::unordered_map<GLuint, int>::iterator resident = m_residentTextures.find(textureID);
+	if ((resident != m_residentTextures.end()) && (m_units[resident->second].target == target))
+	{
+		m_units[resident->second].lastUse = m_useCounter;
+		m_hitCount++;
+		return(m_firstUnit + resident->second);
+	}
+
+	// evict the least recently used unit
+	int index = 0;
+	for (int i = 1; i < (int)m_units.size(); i++)
+	{
+		if (m_units[i].lastUse < m_units[index].lastUse)
+		{
+			index = i;
+		}
+	}
+
+	TEXTURE_UNIT& unit = m_units[index];
+	if (unit.textureID != 0)
+	{
+		m_residentTextures.erase(unit.textureID);
+		// unbind a texture of another target so it is not left on the unit
+		if ((unit.target != target) && (unit.target != 0))
+		{
+			glActiveTexture(GL_TEXTURE0 + m_firstUnit + index);
+			glBindTexture(unit.target, 0);
+		}
+	}
+
+	glActiveTexture(GL_TEXTURE0 + m_firstUnit + index);
+	glBindTexture(target, textureID);
+	m_bindCount++;
+
+	unit.textureID = textureID;
+	unit.target = target;
+	unit.lastUse = m_useCounter;
+	m_residentTextures[textureID] = index;
+
+	return(m_firstUnit + index);
+}
+
+/***********************************************************
+ *  Invalidate()
+ *
+ *  This method is used for forgetting a texture that was
+ *  deleted, or whose contents must be bound again.
+ ***********************************************************/
+void TextureUnitCache::Invalidate(GLuint textureID)
+{
+	std::unordered_map<GLuint, int>::iterator resident = m_residentTextures.find(textureID);
+	if (resident != m_residentTextures.end())
+	{
+		m_units[resident->second].textureID = 0;
+		m_units[resident->second].lastUse = 0;
+		m_residentTextures.erase(resident);
+	}
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  This method is used for forgetting every binding.
+ ***********************************************************/
+void TextureUnitCache::Reset()
+{
+	for (size_t i = 0; i < m_units.size(); i++)
+	{
+		m_units[i].textureID = 0;
+		m_units[i].target = 0;
+		m_units[i].lastUse = 0;
+	}
+	m_residentTextures.clear();
+	m_useCounter = 0;
+}
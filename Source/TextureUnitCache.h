@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureunitcache.h
+// ============
+// bind textures to OpenGL texture units on demand with LRU eviction
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+/***********************************************************
+ *  TextureUnitCache
+ *
+ *  This class tracks which texture is bound to each of a
+ *  range of texture units.  Binding a texture that is
+ *  already resident on a unit costs no OpenGL calls;
+ *  otherwise the least recently used unit is replaced.
+ ***********************************************************/
+class TextureUnitCache
+{
+public:
+	// constructor
+	TextureUnitCache();
+
+	// use the texture units [firstUnit, firstUnit + unitCount)
+	void Initialize(int firstUnit, int unitCount);
+	// make a texture resident on a unit and return that unit
+	int Bind(GLenum target, GLuint textureID);
+	// forget a texture that was deleted or replaced
+	void Invalidate(GLuint textureID);
+	// forget every binding
+	void Reset();
+
+	int GetUnitCount() const { return((int)m_units.size()); }
+	// number of Bind() calls that needed an OpenGL bind
+	uint64_t GetBindCount() const { return(m_bindCount); }
+	// number of Bind() calls that found the texture resident
+	uint64_t GetHitCount() const { return(m_hitCount); }
+
+private:
+	struct TEXTURE_UNIT
+	{
+		GLuint textureID;
+		GLenum target;
+		// value of the use counter when the unit was last used
+		uint64_t lastUse;
+	};
+
+	// first texture unit managed by the cache
+	int m_firstUnit;
+	// state of each managed texture unit
+	std::vector<TEXTURE_UNIT> m_units;
+	// unit index of each resident texture
+	std::unordered_map<GLuint, int> m_residentTextures;
+	// increases with every Bind() call
+	uint64_t m_useCounter;
+	uint64_t m_bindCount;
+	uint64_t m_hitCount;
+};
@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturewatcher.cpp
+// ============
+// report image files that change in the textures directory while running
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureWatcher.h"
+
+#include <iostream>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <climits>
+#endif
+
+// declaration of global variables
+namespace
+{
+#ifndef __linux__
+	// time between two scans of the watched directory
+	const std::chrono::milliseconds g_ScanInterval(500);
+#endif
+}
+
+/***********************************************************
+ *  TextureWatcher()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureWatcher::TextureWatcher()
+{
+#ifdef __linux__
+	m_inotifyFD = -1;
+	m_watchDescriptor = -1;
+#else
+	m_bWatching = false;
+#endif
+}
+
+/***********************************************************
+ *  ~TextureWatcher()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureWatcher::~TextureWatcher()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting to watch a directory.
+ *  Only changes made after this call are reported.
+ ***********************************************************/
+bool TextureWatcher::Start(const char* directory)
+{
+	Stop();
+	m_directory = directory;
+
+#ifdef __linux__
+	m_inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotifyFD < 0)
+	{
+		std::cout << "Could not start watching textures: inotify unavailable" << std::endl;
+		return(false);
+	}
+	// editors either rewrite the file or rename a new file over it
+	m_watchDescriptor = inotify_add_watch(m_inotifyFD, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (m_watchDescriptor < 0)
+	{
+		std::cout << "Could not watch directory:" << directory << std::endl;
+		Stop();
+		return(false);
+	}
+#else
+	std::error_code error;
+	std::filesystem::directory_iterator entry(directory, error);
+	if (error)
+	{
+		std::cout << "Could not watch directory:" << directory << std::endl;
+		return(false);
+	}
+	for (; entry != std::filesystem::directory_iterator(); entry++)
+	{
+		if (entry->is_regular_file(error))
+		{
+			m_writeTimes[entry->path().filename().string()] = entry->last_write_time(error);
+		}
+	}
+	m_lastScan = std::chrono::steady_clock::now();
+	m_bWatching = true;
+#endif
+
+	std::cout << "Watching for texture changes in:" << directory << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for stopping watching the directory.
+ ***********************************************************/
+void TextureWatcher::Stop()
+{
+#ifdef __linux__
+	if (m_inotifyFD >= 0)
+	{
+		close(m_inotifyFD);
+		m_inotifyFD = -1;
+		m_watchDescriptor = -1;
+	}
+#else
+	m_writeTimes.clear();
+	m_bWatching = false;
+#endif
+	m_changedFiles.clear();
+}
+
+/***********************************************************
+ *  PollChangedFile()
+ *
+ *  This method is used for getting the next changed file
+ *  without blocking.  A file changed several times since
+ *  the last poll is only reported once.
+ ***********************************************************/
+bool TextureWatcher::PollChangedFile(std::string& filename)
+{
+	if (m_changedFiles.size() == 0)
+	{
+		ReadChanges();
+	}
+	if (m_changedFiles.size() == 0)
+	{
+		return(false);
+	}
+
+	filename = m_directory + "/" + m_changedFiles.front();
+	m_changedFiles.erase(m_changedFiles.begin());
+	return(true);
+}
+
+/***********************************************************
+ *  ReadChanges()
+ *
+ *  This method is used for collecting the names of the
+ *  files that changed since it was last called.
+ ***********************************************************/
+void TextureWatcher::ReadChanges()
+{
+#ifdef __linux__
+	if (m_inotifyFD < 0)
+	{
+		return;
+	}
+
+	alignas(struct inotify_event) char buffer[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+	ssize_t length = read(m_inotifyFD, buffer, sizeof(buffer));
+	while (length > 0)
+	{
+		ssize_t offset = 0;
+		while (offset < length)
+		{
+			const struct inotify_event* event = (const struct inotify_event*)(buffer + offset);
+			if ((event->len > 0) && ((event->mask & IN_ISDIR) == 0))
+			{
+				AddChangedFile(event->name);
+			}
+			offset += sizeof(struct inotify_event) + event->len;
+		}
+		length = read(m_inotifyFD, buffer, sizeof(buffer));
+	}
+#else
+	if ((m_bWatching == false) || (std::chrono::steady_clock::now() - m_lastScan < g_ScanInterval))
+	{
+		return;
+	}
+	m_lastScan = std::chrono::steady_clock::now();
+
+	std::error_code error;
+	std::filesystem::directory_iterator entry(m_directory, error);
+	for (; (!error) && (entry != std::filesystem::directory_iterator()); entry.increment(error))
+	{
+		if (entry->is_regular_file(error) == false)
+		{
+			continue;
+		}
+		std::string name = entry->path().filename().string();
+		std::filesystem::file_time_type writeTime = entry->last_write_time(error);
+		std::unordered_map<std::string, std::filesystem::file_time_type>::iterator known = m_writeTimes.find(name);
+		if ((known == m_writeTimes.end()) || (known->second != writeTime))
+		{
+			m_writeTimes[name] = writeTime;
+			AddChangedFile(name);
+		}
+	}
+#endif
+}
+
+/***********************************************************
+ *  AddChangedFile()
+ *
+ *  This method is used for queueing a changed file name.
+ ***********************************************************/
+void TextureWatcher::AddChangedFile(const std::string& name)
+{
+	if (std::find(m_changedFiles.begin(), m_changedFiles.end(), name) == m_changedFiles.end())
+	{
+		m_changedFiles.push_back(name);
+	}
+}
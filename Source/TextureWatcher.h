@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturewatcher.h
+// ============
+// report image files that change in the textures directory while running
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <filesystem>
+
+/***********************************************************
+ *  TextureWatcher
+ *
+ *  This class watches a directory of texture images and
+ *  reports each file that was written or replaced, so the
+ *  texture can be reloaded without restarting.  Linux uses
+ *  inotify; other platforms compare the file modification
+ *  times a few times per second.
+ ***********************************************************/
+class TextureWatcher
+{
+public:
+	// constructor
+	TextureWatcher();
+	// destructor
+	~TextureWatcher();
+
+	// start watching a directory, returns false on failure
+	bool Start(const char* directory);
+	// stop watching
+	void Stop();
+	// get the next changed file as "<directory>/<name>" without
+	// waiting, returns false when no file has changed
+	bool PollChangedFile(std::string& filename);
+
+private:
+	// collect the changes reported since the last poll
+	void ReadChanges();
+	// add a changed file name unless it is already pending
+	void AddChangedFile(const std::string& name);
+
+	// watched directory, as passed to Start()
+	std::string m_directory;
+	// names of the changed files not yet returned
+	std::vector<std::string> m_changedFiles;
+#ifdef __linux__
+	// inotify instance and the watch on the directory
+	int m_inotifyFD;
+	int m_watchDescriptor;
+#else
+	// last modification time of each file in the directory
+	std::unordered_map<std::string, std::filesystem::file_time_type> m_writeTimes;
+	// time of the last directory scan
+	std::chrono::steady_clock::time_point m_lastScan;
+	bool m_bWatching;
+#endif
+};
@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.cpp
+// ============
+// resolve shader uniform locations once per program by hashed name
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UniformCache.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+/***********************************************************
+ *  UniformCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UniformCache::UniformCache()
+{
+	m_programID = 0;
+}
+
+/***********************************************************
+ *  Resolve()
+ *
+ *  This method is used for reading the location of every
+ *  active uniform of a program.  Array uniforms are listed
+ *  by OpenGL with a "[0]" suffix, and are also stored under
+ *  the plain name so either spelling can be used.
+ ***********************************************************/
+bool UniformCache::Resolve(GLuint programID)
+{
+	m_programID = programID;
+	m_locations.clear();
+	if (programID == 0)
+	{
+		return(false);
+	}
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<char> name(maxNameLength + 1);
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(programID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+
+		// members of uniform blocks have no location
+		GLint location = glGetUniformLocation(programID, name.data());
+		if (location < 0)
+		{
+			continue;
+		}
+
+		std::string uniformName(name.data(), length);
+		uint64_t hash = HashName(uniformName.c_str());
+#ifndef NDEBUG
+		if (m_locations.find(hash) != m_locations.end())
+		{
+			std::cout << "Uniform name hash collision:" << uniformName << std::endl;
+		}
+#endif
+		m_locations[hash] = location;
+
+		if ((uniformName.size() > 3) && (uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0))
+		{
+			m_locations[HashName(uniformName.substr(0, uniformName.size() - 3).c_str())] = location;
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetLocation()
+ *
+ *  This method is used for getting the location of a
+ *  uniform.  A name missing from the linked program is
+ *  reported in debug builds, since it is either misspelled
+ *  or optimized out by the shader compiler.  Specialized
+ *  shaders that drop a uniform pass bRequired as false.
+ ***********************************************************/
+GLint UniformCache::GetLocation(const UNIFORM_NAME& uniform, bool bRequired) const
+{
+	std::unordered_map<uint64_t, GLint>::const_iterator found = m_locations.find(uniform.hash);
+	if (found == m_locations.end())
+	{
+#ifndef NDEBUG
+		if (bRequired)
+		{
+			std::cout << "Uniform not found in shader program " << m_programID << ":" << uniform.name << std::endl;
+		}
+#endif
+		return(-1);
+	}
+	return(found->second);
+}
@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.h
+// ============
+// resolve shader uniform locations once per program by hashed name
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <cstdint>
+
+/***********************************************************
+ *  UniformCache
+ *
+ *  This class reads the location of every active uniform
+ *  of a linked program once, keyed by a 64-bit FNV-1a hash
+ *  of its name.  The names are hashed at compile time, so
+ *  the draw code holds plain locations and sets uniforms
+ *  without glGetUniformLocation() or string building.
+ ***********************************************************/
+class UniformCache
+{
+public:
+	// 64-bit FNV-1a hash of a uniform name
+	static constexpr uint64_t HashName(const char* name, uint64_t hash = 14695981039346656037ULL)
+	{
+		return((*name == 0) ? hash : HashName(name + 1, (hash ^ (uint64_t)(unsigned char)*name) * 1099511628211ULL));
+	}
+
+	// a uniform name and its hash, both known at compile time
+	struct UNIFORM_NAME
+	{
+		const char* name;
+		uint64_t hash;
+
+		constexpr UNIFORM_NAME(const char* uniformName)
+			: name(uniformName), hash(HashName(uniformName))
+		{
+		}
+	};
+
+	// constructor
+	UniformCache();
+
+	// read the locations of the active uniforms of a linked program
+	bool Resolve(GLuint programID);
+	// get the location of a uniform, -1 when the program does not
+	// use it - debug builds report missing names that are required
+	GLint GetLocation(const UNIFORM_NAME& uniform, bool bRequired = true) const;
+	// program the locations were read from, 0 before Resolve()
+	GLuint GetProgram() const { return(m_programID); }
+
+	// set a uniform of the program in use by location
+	static void SetInt(GLint location, int value) { glUniform1i(location, value); }
+	static void SetBool(GLint location, bool value) { glUniform1i(location, value ? 1 : 0); }
+	static void SetFloat(GLint location, float value) { glUniform1f(location, value); }
+	static void SetVec2(GLint location, const glm::vec2& value) { glUniform2f(location, value.x, value.y); }
+	static void SetVec3(GLint location, const glm::vec3& value) { glUniform3f(location, value.x, value.y, value.z); }
+	static void SetVec4(GLint location, const glm::vec4& value) { glUniform4f(location, value.x, value.y, value.z, value.w); }
+	static void SetMat4(GLint location, const glm::mat4& value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+
+private:
+	// program the locations were read from
+	GLuint m_programID;
+	// location of each active uniform, by name hash
+	std::unordered_map<uint64_t, GLint> m_locations;
+};
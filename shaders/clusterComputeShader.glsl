@@ -0,0 +1,77 @@
+#version 430 core
+// builds the light list of each cluster for ClusteredLights,
+// one invocation per cluster
+layout (local_size_x = 64) in;
+
+// must match ClusteredLights::GRID_X/Y/Z and MAX_LIGHTS_PER_CLUSTER
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define CLUSTER_COUNT (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+// two texels per light: position and range, color
+uniform samplerBuffer clusterLightData;
+uniform int lightCount;
+uniform mat4 view;
+uniform mat4 inverseProjection;
+// near and far plane distances
+uniform vec2 depthRange;
+
+// offset and length of the light list of each cluster
+layout (rg32ui, binding = 0) uniform writeonly uimageBuffer clusterLightGrid;
+// light indices, MAX_LIGHTS_PER_CLUSTER for every cluster
+layout (r32ui, binding = 1) uniform writeonly uimageBuffer clusterLightIndices;
+
+// view space point at a distance in front of the camera on the
+// line through a normalized device x and y
+vec3 PointAtDepth(vec2 ndc, float depth)
+{
+    vec4 nearPoint = inverseProjection * vec4(ndc, -1.0, 1.0);
+    vec4 farPoint = inverseProjection * vec4(ndc, 1.0, 1.0);
+    vec3 a = nearPoint.xyz / nearPoint.w;
+    vec3 b = farPoint.xyz / farPoint.w;
+    float t = (-depth - a.z) / (b.z - a.z);
+    return mix(a, b, t);
+}
+
+void main()
+{
+    int cluster = int(gl_GlobalInvocationID.x);
+    if(cluster >= CLUSTER_COUNT)
+    {
+        return;
+    }
+    int x = cluster % CLUSTER_GRID_X;
+    int y = (cluster / CLUSTER_GRID_X) % CLUSTER_GRID_Y;
+    int z = cluster / (CLUSTER_GRID_X * CLUSTER_GRID_Y);
+
+    // view space box around the cluster
+    float sliceNear = depthRange.x * pow(depthRange.y / depthRange.x, float(z) / CLUSTER_GRID_Z);
+    float sliceFar = depthRange.x * pow(depthRange.y / depthRange.x, float(z + 1) / CLUSTER_GRID_Z);
+    vec3 boxMin = vec3(3.0e38);
+    vec3 boxMax = vec3(-3.0e38);
+    for(int corner = 0; corner < 8; corner++)
+    {
+        vec2 ndc = vec2(-1.0) + 2.0 * vec2(x + (corner & 1), y + ((corner >> 1) & 1)) / vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y);
+        vec3 point = PointAtDepth(ndc, ((corner & 4) != 0) ? sliceFar : sliceNear);
+        boxMin = min(boxMin, point);
+        boxMax = max(boxMax, point);
+    }
+
+    int first = cluster * MAX_LIGHTS_PER_CLUSTER;
+    int count = 0;
+    for(int light = 0; (light < lightCount) && (count < MAX_LIGHTS_PER_CLUSTER); light++)
+    {
+        vec4 positionRange = texelFetch(clusterLightData, light * 2);
+        vec3 center = (view * vec4(positionRange.xyz, 1.0)).xyz;
+        // distance from the light to the closest point of the box
+        vec3 offset = clamp(center, boxMin, boxMax) - center;
+        if(dot(offset, offset) <= positionRange.w * positionRange.w)
+        {
+            imageStore(clusterLightIndices, first + count, uvec4(light));
+            count++;
+        }
+    }
+    imageStore(clusterLightGrid, cluster, uvec4(first, count, 0, 0));
+}
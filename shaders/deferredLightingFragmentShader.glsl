@@ -0,0 +1,112 @@
+#version 330 core
+out vec4 fragmentColor;
+
+// lights, shadows and the shared lighting functions
+#include "lighting.glsl"
+
+uniform bool bUseLighting=false;
+// G-buffer written by gbufferFragmentShader.glsl
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform usampler2D gMaterial;
+uniform sampler2D gDepth;
+// the material buffer, two texels per material laid out as the
+// material block: diffuse color and shininess, specular color
+uniform samplerBuffer materialData;
+// turns the window position and depth back into a world position
+uniform mat4 inverseViewProjection;
+// the point light added by this pass, or -1 for the pass adding
+// the ambient, directional, spot and clustered lights
+uniform int pointLightIndex = -1;
+
+// material and position of the surface, read from the G-buffer in main()
+Material material;
+vec3 fragmentPosition;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    // nothing was drawn at this pixel
+    if(depth == 1.0f)
+    {
+        discard;
+    }
+    // the first pass stores the depth of the opaque surfaces, which
+    // the transparent draws after the lighting are tested against
+    gl_FragDepth = depth;
+
+    vec4 albedo = texelFetch(gAlbedo, texel, 0);
+    int materialIndex = int(texelFetch(gMaterial, texel, 0).r);
+    vec4 diffuseShininess = texelFetch(materialData, materialIndex * 2);
+    material.diffuseColor = diffuseShininess.xyz;
+    material.specularColor = texelFetch(materialData, materialIndex * 2 + 1).xyz;
+    material.shininess = diffuseShininess.w;
+
+    if(bUseLighting == false)
+    {
+        fragmentColor = (pointLightIndex < 0) ? vec4(albedo.rgb, 1.0f) : vec4(0.0f);
+        return;
+    }
+
+    // world position from the window position and the depth
+    vec2 ndc = gl_FragCoord.xy / vec2(textureSize(gDepth, 0)) * 2.0f - 1.0f;
+    vec4 position = inverseViewProjection * vec4(ndc, depth * 2.0f - 1.0f, 1.0f);
+    fragmentPosition = position.xyz / position.w;
+
+    // properties
+    vec3 norm = normalize(texelFetch(gNormal, texel, 0).xyz);
+    vec3 viewDir = normalize(viewPosition - fragmentPosition);
+
+    // the passes are added together, so each light is summed the same
+    // way as in the forward shader and the results match it
+    LightSum sum = LightSum(vec3(0.0f), vec3(0.0f), vec3(0.0f), vec3(0.0f));
+    if(pointLightIndex < 0)
+    {
+        // directional lighting
+        if(directionalLight.bActive == true)
+        {
+            // the shadow only takes away the direct light
+            float shadow = 1.0f;
+            if(bUseShadows == true)
+            {
+                shadow = CalcDirectionalShadow(fragmentPosition);
+            }
+            AccumulateLight(sum, normalize(-directionalLight.direction), directionalLight.ambient,
+                directionalLight.diffuse * shadow, directionalLight.specular * shadow, true, norm, viewDir, material.shininess);
+        }
+        // spot light
+        if(spotLight.bActive == true)
+        {
+            vec3 lightDir = normalize(spotLight.position - fragmentPosition);
+            // the attenuation and cone falloff scale the light color
+            float spotFactor = CalcSpotFactor(spotLight, lightDir, fragmentPosition);
+            AccumulateLight(sum, lightDir, spotLight.ambient * spotFactor, spotLight.diffuse * spotFactor,
+                spotLight.specular * spotFactor, true, norm, viewDir, material.shininess);
+        }
+        // clustered point lights
+        if(bUseClusteredLights == true)
+        {
+            AccumulateClusteredLights(sum, fragmentPosition, norm, viewDir, material.shininess);
+        }
+    }
+    else
+    {
+        // the point light of this pass
+        PointLight light = pointLights[pointLightIndex];
+        vec3 toLight = light.position - fragmentPosition;
+        float falloff = light.intensity * CalcRangeFalloff(length(toLight), light.range);
+        float shadow = 1.0f;
+        if((bUseShadows == true) && ((pointShadowMask & (1 << pointLightIndex)) != 0))
+        {
+            shadow = CalcPointShadow(pointLightIndex, fragmentPosition);
+        }
+        AccumulateLight(sum, normalize(toLight), light.ambient * falloff,
+            light.diffuse * (falloff * shadow), light.specular * (falloff * shadow), false, norm, viewDir, material.shininess);
+    }
+
+    vec3 surfaceColor = vec3(albedo);
+    vec3 phongResult = (sum.ambient + sum.diffuse * material.diffuseColor + sum.specular * material.specularColor) * surfaceColor;
+    phongResult += sum.specularUntinted * material.specularColor;
+    fragmentColor = vec4(phongResult, 1.0f);
+}
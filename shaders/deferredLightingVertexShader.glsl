@@ -0,0 +1,8 @@
+#version 330 core
+// one triangle covering the whole window, built from the vertex
+// index so no vertex buffer is needed
+void main()
+{
+    vec2 position = vec2(float((gl_VertexID & 1) << 2) - 1.0f, float((gl_VertexID & 2) << 1) - 1.0f);
+    gl_Position = vec4(position, 0.0f, 1.0f);
+}
@@ -5,6 +5,15 @@ in vec3 fragmentPosition;
 in vec3 fragmentVertexNormal;
 in vec2 fragmentTextureCoordinate;
 
+// lights, shadows and the shared lighting functions, copied from
+// lighting.glsl so the ShaderManager can load this file without an
+// include step; ShaderVariants::ReadSource() reports a stale copy
+// #copy "lighting.glsl"
+// lighting shared by the forward and the deferred lighting shaders,
+// ShaderVariants::ReadSource() splices it in where a shader has
+// #include "lighting.glsl".  fragmentShader.glsl keeps a copy so the
+// ShaderManager can load it as is, update that copy with this file
+
 struct Material {
     vec3 diffuseColor;
     vec3 specularColor;
@@ -23,8 +32,12 @@ struct DirectionalLight {
 
 struct PointLight {
     vec3 position;
+    // distance where the light fades out completely
+    float range;
     
     vec3 ambient;
+    // scale of the inverse square falloff
+    float intensity;
     vec3 diffuse;
     vec3 specular;
 
@@ -48,178 +61,322 @@ struct SpotLight {
     bool bActive;
 };
 
+// must match LightBuffer::MAX_POINT_LIGHTS
 #define TOTAL_POINT_LIGHTS 5
+// must match ClusteredLights::GRID_X/Y/Z
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+// must match ShadowMaps::POINT_FACE_SIZE and the point light near
+// plane in ShadowMaps.cpp
+#define POINT_SHADOW_FACE_SIZE 256
+#define POINT_SHADOW_NEAR_PLANE 0.1
 
-uniform bool bUseTexture=false;
-uniform bool bUseLighting=false;
-uniform vec4 objectColor = vec4(1.0f);
 uniform vec3 viewPosition;
-uniform DirectionalLight directionalLight;
-uniform PointLight pointLights[TOTAL_POINT_LIGHTS];
-uniform SpotLight spotLight;
-uniform Material material;
-uniform sampler2D objectTexture;
-uniform vec2 UVscale = vec2(1.0f, 1.0f);
+// lights of the scene, LightBuffer::LIGHT_BLOCK mirrors the layout
+layout (std140) uniform LightBlock {
+    DirectionalLight directionalLight;
+    PointLight pointLights[TOTAL_POINT_LIGHTS];
+    SpotLight spotLight;
+};
+// clustered point lights, built by ClusteredLights
+uniform bool bUseClusteredLights = false;
+// two texels per light: position and range, color
+uniform samplerBuffer clusterLightData;
+// offset and length of the light list of each cluster
+uniform usamplerBuffer clusterLightGrid;
+// light indices of every cluster's list
+uniform usamplerBuffer clusterLightIndices;
+// window pixels covered by one cluster
+uniform vec2 clusterTileSize;
+// scale and bias turning log(view depth) into a depth slice
+uniform vec2 clusterDepthParams;
+uniform mat4 view;
+// shadow maps of the lights, built by ShadowMaps
+uniform bool bUseShadows = false;
+uniform sampler2DShadow directionalShadowMap;
+// world position to coordinates of the directional light's map
+uniform mat4 directionalShadowMatrix;
+// cube faces of the point lights, a row of six per light
+uniform sampler2DShadow pointShadowAtlas;
+// bit i is set when point light i has a shadow map
+uniform int pointShadowMask = 0;
 
-// function prototypes
-vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+// direction and up vector of each point light cube face, must match
+// ShadowMaps.cpp
+const vec3 SHADOW_FACE_FORWARD[6] = vec3[6](vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+const vec3 SHADOW_FACE_UP[6] = vec3[6](vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0));
 
-void main()
-{    
-    if(bUseLighting == true)
+// light terms summed over every active light, the surface color is
+// applied once after the last light
+struct LightSum {
+    vec3 ambient;
+    vec3 diffuse;
+    // specular tinted by the surface color
+    vec3 specular;
+    // point light specular, which is not tinted by the surface color
+    vec3 specularUntinted;
+};
+
+// adds the terms of one light to the sum, lightDir points from the
+// fragment towards the light
+void AccumulateLight(inout LightSum sum, vec3 lightDir, vec3 ambient, vec3 diffuse, vec3 specular, bool bTintSpecular, vec3 normal, vec3 viewDir, float shininess)
+{
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    // combine results
+    sum.ambient += ambient;
+    sum.diffuse += diffuse * diff;
+    if(bTintSpecular == true)
     {
-        vec3 phongResult = vec3(0.0f);
-        // properties
-        vec3 norm = normalize(fragmentVertexNormal);
-        vec3 viewDir = normalize(viewPosition - fragmentPosition);
-    
-        // == =====================================================
-        // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
-        // For each phase, a calculate function is defined that calculates the corresponding color
-        // per light source. In the main() function we take all the calculated colors and sum them 
-        // up for this fragment's final color.
-        // == =====================================================
-        // phase 1: directional lighting
-        if(directionalLight.bActive == true)
-        {
-            phongResult += CalcDirectionalLight(directionalLight, norm, viewDir);
-        }
-        // phase 2: point lights
-        for(int i = 0; i < TOTAL_POINT_LIGHTS; i++)
-        {
-	    if(pointLights[i].bActive == true)
-            {
-                phongResult += CalcPointLight(pointLights[i], norm, fragmentPosition, viewDir);   
-            }
-        } 
-        // phase 3: spot light
-        if(spotLight.bActive == true)
-        {
-            phongResult += CalcSpotLight(spotLight, norm, fragmentPosition, viewDir);    
-        }
-    
-        if(bUseTexture == true)
-        {
-            fragmentColor = vec4(phongResult, (texture(objectTexture, fragmentTextureCoordinate)).a);
-        }
-        else
-        {
-            fragmentColor = vec4(phongResult, objectColor.a);
-        }
+        sum.specular += specular * spec;
     }
     else
     {
-        if(bUseTexture == true)
-        {
-            fragmentColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
-        }
-        else
-        {
-            fragmentColor = objectColor;
-        }
+        sum.specularUntinted += specular * spec;
     }
 }
 
-// calculates the color when using a directional light.
-vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir)
+// calculates the attenuation and cone intensity of the spot light
+float CalcSpotFactor(SpotLight light, vec3 lightDir, vec3 fragPos)
 {
-    vec3 ambient = vec3(0.0f);
-    vec3 diffuse = vec3(0.0f);
-    vec3 specular = vec3(0.0f);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction)); 
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    return (attenuation * intensity);
+}
 
-    vec3 lightDirection = normalize(-light.direction);
-    // diffuse shading
-    float diff = max(dot(normal, lightDirection), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDirection, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // combine results
-    if(bUseTexture == true)
+// calculates how much of a light reaches a distance, inverse square
+// falloff windowed to reach zero at the range of the light
+float CalcRangeFalloff(float distance, float range)
+{
+    float ratio = distance / range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return (window * window) / max(distance * distance, 0.0001);
+}
+
+// adds the clustered point lights listed for the cluster holding the
+// fragment, found from the window position and the view depth
+void AccumulateClusteredLights(inout LightSum sum, vec3 fragPos, vec3 normal, vec3 viewDir, float shininess)
+{
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    int slice = clamp(int(log(max(viewDepth, 0.0001)) * clusterDepthParams.x + clusterDepthParams.y), 0, CLUSTER_GRID_Z - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterTileSize), ivec2(0), ivec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+    int cluster = tile.x + CLUSTER_GRID_X * (tile.y + CLUSTER_GRID_Y * slice);
+
+    uvec2 lightList = texelFetch(clusterLightGrid, cluster).xy;
+    for(uint i = 0u; i < lightList.y; i++)
     {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        specular = light.specular * spec * material.specularColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
+        int light = int(texelFetch(clusterLightIndices, int(lightList.x + i)).r);
+        vec4 positionRange = texelFetch(clusterLightData, light * 2);
+        vec3 color = texelFetch(clusterLightData, light * 2 + 1).rgb;
+        vec3 toLight = positionRange.xyz - fragPos;
+        float falloff = CalcRangeFalloff(length(toLight), positionRange.w);
+        AccumulateLight(sum, normalize(toLight), vec3(0.0f), color * falloff, color * falloff, false, normal, viewDir, shininess);
     }
-    else
+}
+
+// fraction of the directional light reaching the fragment past the
+// shadow casters, filtered over 2x2 texels by the depth comparison
+float CalcDirectionalShadow(vec3 fragPos)
+{
+    vec4 shadowCoord = directionalShadowMatrix * vec4(fragPos, 1.0);
+    // nothing past the far side of the map casts a shadow
+    if(shadowCoord.z > 1.0)
     {
-        ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * spec * material.specularColor * vec3(objectColor);
+        return 1.0;
     }
-    
-    return (ambient + diffuse + specular);
+    return texture(directionalShadowMap, shadowCoord.xyz);
 }
 
-// calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+// fraction of a point light reaching the fragment, looked up in the
+// cube face of the atlas the fragment is seen through
+float CalcPointShadow(int light, vec3 fragPos)
 {
-    vec3 ambient = vec3(0.0f);
-    vec3 diffuse = vec3(0.0f);
-    vec3 specular= vec3(0.0f);
-
-    vec3 lightDir = normalize(light.position - fragPos);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    // Calculate specular component
-    float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-   
-    // combine results
-    if(bUseTexture == true)
+    vec3 fromLight = fragPos - pointLights[light].position;
+    vec3 axis = abs(fromLight);
+    int face = 4 + int(fromLight.z < 0.0);
+    if((axis.x >= axis.y) && (axis.x >= axis.z))
     {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        specular = light.specular * specularComponent * material.specularColor;
+        face = int(fromLight.x < 0.0);
     }
-    else
+    else if(axis.y >= axis.z)
     {
-        ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * specularComponent * material.specularColor;
+        face = 2 + int(fromLight.y < 0.0);
     }
-    
-    return (ambient + diffuse + specular);
+    // the view of the face, as built by ShadowMaps::BuildPointViews()
+    vec3 forward = SHADOW_FACE_FORWARD[face];
+    vec3 right = normalize(cross(forward, SHADOW_FACE_UP[face]));
+    vec3 up = cross(right, forward);
+    float depth = dot(fromLight, forward);
+    float farPlane = max(pointLights[light].range, POINT_SHADOW_NEAR_PLANE * 2.0);
+    if(depth >= farPlane)
+    {
+        return 1.0;
+    }
+
+    // stay half a texel inside the face, so the filtering does not
+    // read the next face of the atlas
+    vec2 faceCoord = vec2(dot(fromLight, right), dot(fromLight, up)) / depth * 0.5 + 0.5;
+    float border = 0.5 / float(POINT_SHADOW_FACE_SIZE);
+    faceCoord = clamp(faceCoord, vec2(border), vec2(1.0 - border));
+    vec2 atlasCoord = (vec2(float(face), float(light)) + faceCoord) / vec2(6.0, float(TOTAL_POINT_LIGHTS));
+    // the depth the perspective projection of the face stored
+    float nearPlane = POINT_SHADOW_NEAR_PLANE;
+    float ndcDepth = (farPlane + nearPlane) / (farPlane - nearPlane) - 2.0 * farPlane * nearPlane / ((farPlane - nearPlane) * depth);
+    return texture(pointShadowAtlas, vec3(atlasCoord, ndcDepth * 0.5 + 0.5));
 }
+// #endcopy
 
-// calculates the color when using a spot light.
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 ambient = vec3(0.0f);
-    vec3 diffuse = vec3(0.0f);
-    vec3 specular = vec3(0.0f);
+// materials as stored in the material uniform buffer
+struct MaterialData {
+    vec4 diffuseShininess;
+    vec4 specularColor;
+};
 
-    vec3 lightDir = normalize(light.position - fragPos);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
-    // spotlight intensity
-    float theta = dot(lightDir, normalize(-light.direction)); 
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-    // combine results
-    if(bUseTexture == true)
+// must match MaterialBuffer::MATERIALS_PER_PAGE
+#define MATERIALS_PER_BLOCK 512
+
+uniform bool bUseTexture=false;
+uniform bool bUseLighting=false;
+uniform vec4 objectColor = vec4(1.0f);
+layout (std140) uniform MaterialBlock {
+    MaterialData materials[MATERIALS_PER_BLOCK];
+};
+uniform int materialIndex = 0;
+// bit i is set when point light i reaches the object being drawn
+uniform int pointLightMask = -1;
+uniform sampler2D objectTexture;
+uniform sampler2DArray objectTextureArray;
+uniform bool bUseTextureArray = false;
+uniform int objectTextureLayer = 0;
+uniform vec2 UVscale = vec2(1.0f, 1.0f);
+
+// shader variants are compiled with SHADER_VARIANT and VARIANT_*
+// defines describing the draw state, which turns the uniform
+// branches below into constants the compiler removes
+#ifdef SHADER_VARIANT
+#define USE_LIGHTING (VARIANT_LIT != 0)
+#define USE_TEXTURE (VARIANT_TEXTURED != 0)
+#define DIRECTIONAL_LIGHT_ACTIVE (VARIANT_DIRECTIONAL_LIGHT != 0)
+#define POINT_LIGHT_COUNT VARIANT_POINT_LIGHTS
+#define POINT_LIGHT_ACTIVE(i) ((pointLightMask & (1 << i)) != 0)
+#define SPOT_LIGHT_ACTIVE (VARIANT_SPOT_LIGHT != 0)
+#define CLUSTERED_LIGHTS_ACTIVE (VARIANT_CLUSTERED_LIGHTS != 0)
+#define SHADOWS_ACTIVE (VARIANT_SHADOWS != 0)
+#else
+#define USE_LIGHTING bUseLighting
+#define USE_TEXTURE bUseTexture
+#define DIRECTIONAL_LIGHT_ACTIVE directionalLight.bActive
+#define POINT_LIGHT_COUNT TOTAL_POINT_LIGHTS
+#define POINT_LIGHT_ACTIVE(i) (pointLights[i].bActive && ((pointLightMask & (1 << i)) != 0))
+#define SPOT_LIGHT_ACTIVE spotLight.bActive
+#define CLUSTERED_LIGHTS_ACTIVE bUseClusteredLights
+#define SHADOWS_ACTIVE bUseShadows
+#endif
+
+// material of the object, read from the material block in main()
+Material material;
+
+// function prototypes
+vec4 SampleObjectTexture(vec2 uv);
+
+void main()
+{    
+    MaterialData materialData = materials[materialIndex];
+    material.diffuseColor = materialData.diffuseShininess.xyz;
+    material.specularColor = materialData.specularColor.xyz;
+    material.shininess = materialData.diffuseShininess.w;
+
+    // the surface color is fetched once and shared by every light
+    vec4 albedo = objectColor;
+    if(USE_TEXTURE == true)
     {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        specular = light.specular * spec * material.specularColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
+        albedo = SampleObjectTexture(fragmentTextureCoordinate * UVscale);
     }
-    else
+
+    if(USE_LIGHTING == false)
     {
-        ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * spec * material.specularColor * vec3(objectColor);
+        fragmentColor = albedo;
+        return;
     }
-    
-    ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-    return (ambient + diffuse + specular);
+
+    // properties
+    vec3 norm = normalize(fragmentVertexNormal);
+    vec3 viewDir = normalize(viewPosition - fragmentPosition);
+
+    // == =====================================================
+    // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight,
+    // followed by the clustered point lights near the fragment
+    // Each light adds its ambient, diffuse and specular terms to one running sum, and the
+    // sum is multiplied by the material and the surface color after the last light.
+    // == =====================================================
+    LightSum sum = LightSum(vec3(0.0f), vec3(0.0f), vec3(0.0f), vec3(0.0f));
+    // phase 1: directional lighting
+    if(DIRECTIONAL_LIGHT_ACTIVE == true)
+    {
+        // the shadow only takes away the direct light
+        float shadow = 1.0f;
+        if(SHADOWS_ACTIVE == true)
+        {
+            shadow = CalcDirectionalShadow(fragmentPosition);
+        }
+        AccumulateLight(sum, normalize(-directionalLight.direction), directionalLight.ambient,
+            directionalLight.diffuse * shadow, directionalLight.specular * shadow, true, norm, viewDir, material.shininess);
+    }
+    // phase 2: point lights
+    for(int i = 0; i < POINT_LIGHT_COUNT; i++)
+    {
+        if(POINT_LIGHT_ACTIVE(i) == true)
+        {
+            vec3 toLight = pointLights[i].position - fragmentPosition;
+            float falloff = pointLights[i].intensity * CalcRangeFalloff(length(toLight), pointLights[i].range);
+            float shadow = 1.0f;
+            if((SHADOWS_ACTIVE == true) && ((pointShadowMask & (1 << i)) != 0))
+            {
+                shadow = CalcPointShadow(i, fragmentPosition);
+            }
+            AccumulateLight(sum, normalize(toLight), pointLights[i].ambient * falloff,
+                pointLights[i].diffuse * (falloff * shadow), pointLights[i].specular * (falloff * shadow), false, norm, viewDir, material.shininess);
+        }
+    }
+    // phase 3: spot light
+    if(SPOT_LIGHT_ACTIVE == true)
+    {
+        vec3 lightDir = normalize(spotLight.position - fragmentPosition);
+        // the attenuation and cone falloff scale the light color
+        float spotFactor = CalcSpotFactor(spotLight, lightDir, fragmentPosition);
+        AccumulateLight(sum, lightDir, spotLight.ambient * spotFactor, spotLight.diffuse * spotFactor,
+            spotLight.specular * spotFactor, true, norm, viewDir, material.shininess);
+    }
+    // phase 4: clustered point lights
+    if(CLUSTERED_LIGHTS_ACTIVE == true)
+    {
+        AccumulateClusteredLights(sum, fragmentPosition, norm, viewDir, material.shininess);
+    }
+
+    vec3 surfaceColor = vec3(albedo);
+    vec3 phongResult = (sum.ambient + sum.diffuse * material.diffuseColor + sum.specular * material.specularColor) * surfaceColor;
+    phongResult += sum.specularUntinted * material.specularColor;
+    fragmentColor = vec4(phongResult, albedo.a);
+}
+
+// samples the object texture, either a standalone texture or a layer
+// of the texture array
+vec4 SampleObjectTexture(vec2 uv)
+{
+    if(bUseTextureArray == true)
+    {
+        return texture(objectTextureArray, vec3(uv, float(objectTextureLayer)));
+    }
+    return texture(objectTexture, uv);
 }
@@ -0,0 +1,50 @@
+#version 330 core
+// G-buffer of the deferred shading path, DeferredRenderer::GBUFFER
+// lists the targets in the same order
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gNormal;
+layout (location = 2) out uint gMaterial;
+
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+
+uniform bool bUseTexture=false;
+uniform vec4 objectColor = vec4(1.0f);
+// index of the material in the whole material buffer, which the
+// lighting pass looks up
+uniform int materialIndex = 0;
+uniform sampler2D objectTexture;
+uniform sampler2DArray objectTextureArray;
+uniform bool bUseTextureArray = false;
+uniform int objectTextureLayer = 0;
+uniform vec2 UVscale = vec2(1.0f, 1.0f);
+
+// function prototypes
+vec4 SampleObjectTexture(vec2 uv);
+
+void main()
+{
+    // the surface color, as the forward shader fetches it
+    vec4 albedo = objectColor;
+    if(bUseTexture == true)
+    {
+        albedo = SampleObjectTexture(fragmentTextureCoordinate * UVscale);
+    }
+
+    // the lighting pass applies the material and every light
+    gAlbedo = albedo;
+    gNormal = vec4(normalize(fragmentVertexNormal), 0.0f);
+    gMaterial = uint(materialIndex);
+}
+
+// samples the object texture, either a standalone texture or a layer
+// of the texture array
+vec4 SampleObjectTexture(vec2 uv)
+{
+    if(bUseTextureArray == true)
+    {
+        return texture(objectTextureArray, vec3(uv, float(objectTextureLayer)));
+    }
+    return texture(objectTexture, uv);
+}
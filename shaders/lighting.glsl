@@ -0,0 +1,226 @@
+// lighting shared by the forward and the deferred lighting shaders,
+// ShaderVariants::ReadSource() splices it in where a shader has
+// #include "lighting.glsl".  fragmentShader.glsl keeps a copy so the
+// ShaderManager can load it as is, update that copy with this file
+
+struct Material {
+    vec3 diffuseColor;
+    vec3 specularColor;
+    float shininess;
+}; 
+
+struct DirectionalLight {
+    vec3 direction;
+	
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    bool bActive;
+};
+
+struct PointLight {
+    vec3 position;
+    // distance where the light fades out completely
+    float range;
+    
+    vec3 ambient;
+    // scale of the inverse square falloff
+    float intensity;
+    vec3 diffuse;
+    vec3 specular;
+
+    bool bActive;
+};
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+  
+    float constant;
+    float linear;
+    float quadratic;
+  
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;       
+
+    bool bActive;
+};
+
+// must match LightBuffer::MAX_POINT_LIGHTS
+#define TOTAL_POINT_LIGHTS 5
+// must match ClusteredLights::GRID_X/Y/Z
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+// must match ShadowMaps::POINT_FACE_SIZE and the point light near
+// plane in ShadowMaps.cpp
+#define POINT_SHADOW_FACE_SIZE 256
+#define POINT_SHADOW_NEAR_PLANE 0.1
+
+uniform vec3 viewPosition;
+// lights of the scene, LightBuffer::LIGHT_BLOCK mirrors the layout
+layout (std140) uniform LightBlock {
+    DirectionalLight directionalLight;
+    PointLight pointLights[TOTAL_POINT_LIGHTS];
+    SpotLight spotLight;
+};
+// clustered point lights, built by ClusteredLights
+uniform bool bUseClusteredLights = false;
+// two texels per light: position and range, color
+uniform samplerBuffer clusterLightData;
+// offset and length of the light list of each cluster
+uniform usamplerBuffer clusterLightGrid;
+// light indices of every cluster's list
+uniform usamplerBuffer clusterLightIndices;
+// window pixels covered by one cluster
+uniform vec2 clusterTileSize;
+// scale and bias turning log(view depth) into a depth slice
+uniform vec2 clusterDepthParams;
+uniform mat4 view;
+// shadow maps of the lights, built by ShadowMaps
+uniform bool bUseShadows = false;
+uniform sampler2DShadow directionalShadowMap;
+// world position to coordinates of the directional light's map
+uniform mat4 directionalShadowMatrix;
+// cube faces of the point lights, a row of six per light
+uniform sampler2DShadow pointShadowAtlas;
+// bit i is set when point light i has a shadow map
+uniform int pointShadowMask = 0;
+
+// direction and up vector of each point light cube face, must match
+// ShadowMaps.cpp
+const vec3 SHADOW_FACE_FORWARD[6] = vec3[6](vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+const vec3 SHADOW_FACE_UP[6] = vec3[6](vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0));
+
+// light terms summed over every active light, the surface color is
+// applied once after the last light
+struct LightSum {
+    vec3 ambient;
+    vec3 diffuse;
+    // specular tinted by the surface color
+    vec3 specular;
+    // point light specular, which is not tinted by the surface color
+    vec3 specularUntinted;
+};
+
+// adds the terms of one light to the sum, lightDir points from the
+// fragment towards the light
+void AccumulateLight(inout LightSum sum, vec3 lightDir, vec3 ambient, vec3 diffuse, vec3 specular, bool bTintSpecular, vec3 normal, vec3 viewDir, float shininess)
+{
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    // combine results
+    sum.ambient += ambient;
+    sum.diffuse += diffuse * diff;
+    if(bTintSpecular == true)
+    {
+        sum.specular += specular * spec;
+    }
+    else
+    {
+        sum.specularUntinted += specular * spec;
+    }
+}
+
+// calculates the attenuation and cone intensity of the spot light
+float CalcSpotFactor(SpotLight light, vec3 lightDir, vec3 fragPos)
+{
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction)); 
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    return (attenuation * intensity);
+}
+
+// calculates how much of a light reaches a distance, inverse square
+// falloff windowed to reach zero at the range of the light
+float CalcRangeFalloff(float distance, float range)
+{
+    float ratio = distance / range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return (window * window) / max(distance * distance, 0.0001);
+}
+
+// adds the clustered point lights listed for the cluster holding the
+// fragment, found from the window position and the view depth
+void AccumulateClusteredLights(inout LightSum sum, vec3 fragPos, vec3 normal, vec3 viewDir, float shininess)
+{
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    int slice = clamp(int(log(max(viewDepth, 0.0001)) * clusterDepthParams.x + clusterDepthParams.y), 0, CLUSTER_GRID_Z - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterTileSize), ivec2(0), ivec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+    int cluster = tile.x + CLUSTER_GRID_X * (tile.y + CLUSTER_GRID_Y * slice);
+
+    uvec2 lightList = texelFetch(clusterLightGrid, cluster).xy;
+    for(uint i = 0u; i < lightList.y; i++)
+    {
+        int light = int(texelFetch(clusterLightIndices, int(lightList.x + i)).r);
+        vec4 positionRange = texelFetch(clusterLightData, light * 2);
+        vec3 color = texelFetch(clusterLightData, light * 2 + 1).rgb;
+        vec3 toLight = positionRange.xyz - fragPos;
+        float falloff = CalcRangeFalloff(length(toLight), positionRange.w);
+        AccumulateLight(sum, normalize(toLight), vec3(0.0f), color * falloff, color * falloff, false, normal, viewDir, shininess);
+    }
+}
+
+// fraction of the directional light reaching the fragment past the
+// shadow casters, filtered over 2x2 texels by the depth comparison
+float CalcDirectionalShadow(vec3 fragPos)
+{
+    vec4 shadowCoord = directionalShadowMatrix * vec4(fragPos, 1.0);
+    // nothing past the far side of the map casts a shadow
+    if(shadowCoord.z > 1.0)
+    {
+        return 1.0;
+    }
+    return texture(directionalShadowMap, shadowCoord.xyz);
+}
+
+// fraction of a point light reaching the fragment, looked up in the
+// cube face of the atlas the fragment is seen through
+float CalcPointShadow(int light, vec3 fragPos)
+{
+    vec3 fromLight = fragPos - pointLights[light].position;
+    vec3 axis = abs(fromLight);
+    int face = 4 + int(fromLight.z < 0.0);
+    if((axis.x >= axis.y) && (axis.x >= axis.z))
+    {
+        face = int(fromLight.x < 0.0);
+    }
+    else if(axis.y >= axis.z)
+    {
+        face = 2 + int(fromLight.y < 0.0);
+    }
+    // the view of the face, as built by ShadowMaps::BuildPointViews()
+    vec3 forward = SHADOW_FACE_FORWARD[face];
+    vec3 right = normalize(cross(forward, SHADOW_FACE_UP[face]));
+    vec3 up = cross(right, forward);
+    float depth = dot(fromLight, forward);
+    float farPlane = max(pointLights[light].range, POINT_SHADOW_NEAR_PLANE * 2.0);
+    if(depth >= farPlane)
+    {
+        return 1.0;
+    }
+
+    // stay half a texel inside the face, so the filtering does not
+    // read the next face of the atlas
+    vec2 faceCoord = vec2(dot(fromLight, right), dot(fromLight, up)) / depth * 0.5 + 0.5;
+    float border = 0.5 / float(POINT_SHADOW_FACE_SIZE);
+    faceCoord = clamp(faceCoord, vec2(border), vec2(1.0 - border));
+    vec2 atlasCoord = (vec2(float(face), float(light)) + faceCoord) / vec2(6.0, float(TOTAL_POINT_LIGHTS));
+    // the depth the perspective projection of the face stored
+    float nearPlane = POINT_SHADOW_NEAR_PLANE;
+    float ndcDepth = (farPlane + nearPlane) / (farPlane - nearPlane) - 2.0 * farPlane * nearPlane / ((farPlane - nearPlane) * depth);
+    return texture(pointShadowAtlas, vec3(atlasCoord, ndcDepth * 0.5 + 0.5));
+}
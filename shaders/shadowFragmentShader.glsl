@@ -0,0 +1,6 @@
+#version 330 core
+// shadow maps only keep the depth of the closest caster, which is
+// written without any fragment output
+void main()
+{
+}
@@ -0,0 +1,12 @@
+#version 330 core
+// draws the shadow casters into a shadow map, from the view of a
+// light as set by ShadowMaps::BeginView()
+layout (location = 0) in vec3 inVertexPosition;
+
+uniform mat4 model;
+uniform mat4 lightViewProjection;
+
+void main()
+{
+   gl_Position = lightViewProjection * model * vec4(inVertexPosition, 1.0f);
+}